@@ -127,6 +127,7 @@ SRCS += \
   $(TOP)/watch-library/hardware/watch/watch_buzzer.c \
   $(TOP)/watch-library/hardware/watch/watch_adc.c \
   $(TOP)/watch-library/hardware/watch/watch_gpio.c \
+  $(TOP)/watch-library/hardware/watch/watch_dma.c \
   $(TOP)/watch-library/hardware/watch/watch_i2c.c \
   $(TOP)/watch-library/hardware/watch/watch_spi.c \
   $(TOP)/watch-library/hardware/watch/watch_uart.c \
@@ -201,6 +202,7 @@ SRCS += \
   $(TOP)/watch-library/simulator/watch/watch_buzzer.c \
   $(TOP)/watch-library/simulator/watch/watch_adc.c \
   $(TOP)/watch-library/simulator/watch/watch_gpio.c \
+  $(TOP)/watch-library/simulator/watch/watch_dma.c \
   $(TOP)/watch-library/simulator/watch/watch_i2c.c \
   $(TOP)/watch-library/simulator/watch/watch_spi.c \
   $(TOP)/watch-library/simulator/watch/watch_uart.c \
@@ -213,6 +215,11 @@ SRCS += \
   $(TOP)/watch-library/shared/watch/watch_private_display.c \
   $(TOP)/watch-library/shared/watch/watch_utility.c \
 
+# the /ext volume's RAM-backed flash emulator takes 2 MB, so only link it when /ext is enabled.
+ifeq ($(FILESYSTEM_EXT), 1)
+SRCS += $(TOP)/watch-library/simulator/driver/spiflash.c
+endif
+
 endif
 
 ifeq ($(LED), BLUE)
@@ -252,3 +259,19 @@ endif
 ifdef CLOCK_FACE_24H_ONLY
 CFLAGS += -DCLOCK_FACE_24H_ONLY
 endif
+
+ifdef FILESYSTEM_PROFILE
+CFLAGS += -DFILESYSTEM_PROFILE=FILESYSTEM_PROFILE_$(FILESYSTEM_PROFILE)
+endif
+
+ifdef FILESYSTEM_EXT
+CFLAGS += -DFILESYSTEM_ENABLE_EXT=$(FILESYSTEM_EXT)
+endif
+
+ifdef ACCELEROMETER_DATA_ACQUISITION_INTERNAL
+CFLAGS += -DACCELEROMETER_DATA_ACQUISITION_INTERNAL=$(ACCELEROMETER_DATA_ACQUISITION_INTERNAL)
+endif
+
+ifdef FILESYSTEM_ASSET_ROWS
+CFLAGS += -DFILESYSTEM_ASSET_ROWS=$(FILESYSTEM_ASSET_ROWS)
+endif
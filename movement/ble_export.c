@@ -0,0 +1,290 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_export.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "filesystem.h"
+#include "movement_log.h"
+#include "watch_uart.h"
+#include "watch_utility.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#define HEADER_LEN  8
+#define CRC_LEN     2
+
+#if HEADER_LEN + BLE_EXPORT_CHUNK + CRC_LEN > BLE_MESSAGE_MAX_LEN
+#error "BLE_EXPORT_CHUNK doesn't fit in a message"
+#endif
+
+/* Longest message an empty TX ring holds, with a TLV header and CRC on each fragment */
+#define RING_MESSAGE_LEN  (((WATCH_UART_TX_BUF_SZ - 1) / (BLE_TLV_MAX_LEN + 4)) * BLE_TLV_MAX_LEN)
+
+/* A chunk is only sent once it fits in the TX ring, so it must fit in an empty one */
+#if HEADER_LEN + BLE_EXPORT_CHUNK + CRC_LEN > RING_MESSAGE_LEN
+#define CHUNK_LEN         (RING_MESSAGE_LEN - HEADER_LEN - CRC_LEN)
+#else
+#define CHUNK_LEN         BLE_EXPORT_CHUNK
+#endif
+
+/* A full chunk on the wire: the message, plus a TLV header and CRC for each of its fragments */
+#define CHUNK_MESSAGE_LEN (HEADER_LEN + CHUNK_LEN + CRC_LEN)
+#define CHUNK_WIRE_BYTES  (CHUNK_MESSAGE_LEN + 4 * ((CHUNK_MESSAGE_LEN + BLE_TLV_MAX_LEN - 1) / BLE_TLV_MAX_LEN))
+
+typedef struct {
+    uint8_t  seq;
+    uint8_t  len;
+    bool     stale;        /* sent before a rewind; its answer is ignored */
+    uint32_t offset;
+} ble_export_chunk_t;
+
+static ble_export_status_t s_status;
+
+/* Chunks sent and not yet answered, oldest first */
+static ble_export_chunk_t  s_flight[BLE_EXPORT_MAX_WINDOW];
+static uint8_t             s_in_flight;
+
+static uint32_t            s_next;         /* offset of the next chunk to send        */
+static uint8_t             s_good;         /* in-order answers since the window grew  */
+static uint8_t             s_failures;     /* timeouts in a row                       */
+static uint32_t            s_started_at;   /* ble_request_now() at the start          */
+static bool                s_rewinding;    /* cancelling in-flight chunks on purpose  */
+static uint8_t             s_message[BLE_MESSAGE_MAX_LEN];
+static bool                s_enabled = BLE_EXPORT_ENABLED;
+
+static const char *const   s_allowed[] = { BLE_EXPORT_FILES };
+
+static void prv_put32(uint8_t *p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+
+static uint32_t prv_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Header, data and CRC into s_message; returns the message length */
+static uint8_t prv_frame(uint32_t offset, uint32_t size, uint8_t len) {
+    prv_put32(s_message, offset);
+    prv_put32(s_message + 4, size);
+    uint16_t crc = watch_utility_crc16(s_message, HEADER_LEN + len, 0xFFFF);
+    s_message[HEADER_LEN + len]     = crc & 0xFF;
+    s_message[HEADER_LEN + len + 1] = crc >> 8;
+    return HEADER_LEN + len + CRC_LEN;
+}
+
+static void prv_update_rate(void) {
+    uint32_t ticks = ble_request_now() - s_started_at;
+    s_status.elapsed_ms  = ticks * 1000 / 128;
+    s_status.bytes_per_s = ticks ? (uint32_t)((uint64_t)(s_status.acked - s_status.start) * 128 / ticks) : 0;
+}
+
+static void prv_cancel_in_flight(void) {
+    s_rewinding = true;
+    while (s_in_flight) ble_request_cancel(s_flight[--s_in_flight].seq);
+    s_rewinding = false;
+}
+
+static void prv_finish(ble_export_state_t state) {
+    prv_cancel_in_flight();
+    prv_update_rate();
+    s_status.state = state;
+    if (state == BLE_EXPORT_DONE) {
+        MOVEMENT_LOG_INFO("export: %s, %" PRIu32 " bytes in %" PRIu32 " ms", s_status.file,
+                          s_status.acked - s_status.start, s_status.elapsed_ms);
+    } else {
+        MOVEMENT_LOG_WARN("export: %s stopped at %" PRIu32 " of %" PRIu32, s_status.file, s_status.acked, s_status.size);
+    }
+}
+
+/* Time for the window ahead of a chunk to cross the wire, plus the nRF's time to pass it on */
+static uint16_t prv_timeout_ms(void) {
+    uint32_t wire_ms = (uint32_t)s_status.window * CHUNK_WIRE_BYTES * 10 * 1000 / ble_uart_get_baud();
+    uint32_t timeout = BLE_EXPORT_ACK_TIMEOUT_MS + wire_ms;
+    return timeout > 20000 ? 20000 : timeout;
+}
+
+static void prv_acked(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context);
+
+static void prv_fill(void) {
+    /* An empty chunk goes out if there's nothing to send, so the phone still hears the size */
+    while (s_status.state == BLE_EXPORT_RUNNING && s_in_flight < s_status.window &&
+           (s_next < s_status.size || s_status.chunks == 0)) {
+        uint32_t remaining = s_status.size - s_next;
+        uint8_t  len       = remaining < CHUNK_LEN ? remaining : CHUNK_LEN;
+        /* Sending waits for room in the TX ring, so leave the chunk for ble_export_task until there is */
+        if (ble_uart_tx_room() < HEADER_LEN + len + CRC_LEN) return;
+        if (len && filesystem_read_file_at(s_status.file, s_next, (char *)s_message + HEADER_LEN, len) != len) {
+            prv_finish(BLE_EXPORT_FAILED);
+            return;
+        }
+        uint8_t seq = ble_request_send(BLE_CMD_EXPORT, s_message, prv_frame(s_next, s_status.size, len),
+                                       prv_timeout_ms(), prv_acked, NULL);
+        /* If the request table is full, ble_export_task tries again */
+        if (seq == 0) return;
+
+        s_flight[s_in_flight].seq    = seq;
+        s_flight[s_in_flight].len    = len;
+        s_flight[s_in_flight].stale  = false;
+        s_flight[s_in_flight].offset = s_next;
+        s_in_flight++;
+        s_next += len;
+        s_status.chunks++;
+    }
+}
+
+/*
+ * Carry on from offset with a smaller window. The nRF answers every chunk
+ * it gets, and answers are paired with requests oldest first, so chunks
+ * already sent are left to be answered rather than cancelled; their
+ * answers are ignored, and new chunks go out as they come in.
+ */
+static void prv_rewind(uint32_t offset, uint8_t window) {
+    for (uint8_t i = 0; i < s_in_flight; i++) s_flight[i].stale = true;
+    s_next          = offset;
+    s_status.acked  = offset;
+    s_status.window = window ? window : 1;
+    s_good          = 0;
+    prv_fill();
+}
+
+static void prv_carry_on(void) {
+    if (s_status.acked >= s_status.size && s_in_flight == 0) {
+        prv_finish(BLE_EXPORT_DONE);
+        return;
+    }
+    prv_fill();
+}
+
+static void prv_acked(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) context;
+    if (s_rewinding || s_status.state != BLE_EXPORT_RUNNING) return;
+
+    uint8_t i = 0;
+    while (i < s_in_flight && s_flight[i].seq != seq) i++;
+    if (i == s_in_flight) return;
+    ble_export_chunk_t chunk = s_flight[i];
+    s_in_flight--;
+    memmove(&s_flight[i], &s_flight[i + 1], (s_in_flight - i) * sizeof(ble_export_chunk_t));
+
+    if (status != BLE_REQUEST_OK) {
+        s_status.timeouts++;
+        if (++s_failures > BLE_EXPORT_MAX_RETRIES) {
+            prv_finish(BLE_EXPORT_FAILED);
+            return;
+        }
+        /* Whatever was sent after it may never be answered either */
+        prv_cancel_in_flight();
+        prv_rewind(s_status.acked, 1);
+        return;
+    }
+    if (chunk.stale) {
+        prv_carry_on();
+        return;
+    }
+    s_failures = 0;
+
+    /* Answers come oldest first, so anything else is the phone asking to go back */
+    uint32_t end  = chunk.offset + chunk.len;
+    uint32_t next = (len >= 4) ? prv_get32(data) : end;
+    if (next == BLE_EXPORT_NO_FILE) {
+        prv_finish(BLE_EXPORT_STOPPED);
+        return;
+    }
+    if (next > s_status.size) {
+        prv_finish(BLE_EXPORT_FAILED);
+        return;
+    }
+    if (i != 0 || next != end) {
+        s_status.resends++;
+        prv_rewind(next, s_status.window / 2);
+        return;
+    }
+
+    s_status.acked = end;
+    if (++s_good >= s_status.window && s_status.window < BLE_EXPORT_MAX_WINDOW) {
+        s_status.window++;
+        s_good = 0;
+    }
+    prv_carry_on();
+}
+
+static void prv_start_requested(uint8_t type, const uint8_t *data, uint8_t len) {
+    (void) type;
+    if (len < 5 || len - 4 > BLE_EXPORT_NAME_MAX) return;
+
+    char     name[BLE_EXPORT_NAME_MAX + 1];
+    uint32_t offset = prv_get32(data);
+    memcpy(name, data + 4, len - 4);
+    name[len - 4] = '\0';
+
+    /* The phone starting again means it has given up on the transfer that's running */
+    if (s_enabled) ble_export_cancel();
+    if (!s_enabled || !ble_export_start(name, offset)) {
+        ble_uart_send_long(BLE_CMD_EXPORT, s_message, prv_frame(offset, BLE_EXPORT_NO_FILE, 0));
+    }
+}
+
+void ble_export_init(void) {
+    ble_request_set_handler(BLE_CMD_EXPORT_START, prv_start_requested);
+}
+
+static bool prv_allowed(const char *filename) {
+    for (size_t i = 0; i < sizeof(s_allowed) / sizeof(s_allowed[0]); i++) {
+        if (strcmp(filename, s_allowed[i]) == 0) return true;
+    }
+    return false;
+}
+
+bool ble_export_start(const char *filename, uint32_t offset) {
+    if (s_status.state == BLE_EXPORT_RUNNING) return false;
+    if (strlen(filename) > BLE_EXPORT_NAME_MAX || !prv_allowed(filename)) return false;
+    int32_t size = filesystem_get_file_size((char *)filename);
+    if (size < 0) return false;
+
+    memset(&s_status, 0, sizeof(s_status));
+    strcpy(s_status.file, filename);
+    s_status.state  = BLE_EXPORT_RUNNING;
+    s_status.size   = size;
+    s_status.start  = offset < (uint32_t)size ? offset : (uint32_t)size;
+    s_status.acked  = s_status.start;
+    s_status.window = 1;
+    s_next          = s_status.start;
+    s_in_flight     = 0;
+    s_good          = 0;
+    s_failures      = 0;
+    s_started_at    = ble_request_now();
+    prv_fill();
+    return true;
+}
+
+void ble_export_task(void) {
+    if (s_status.state == BLE_EXPORT_RUNNING) prv_fill();
+}
+
+bool ble_export_busy(void) {
+    return s_status.state == BLE_EXPORT_RUNNING;
+}
+
+void ble_export_cancel(void) {
+    if (s_status.state == BLE_EXPORT_RUNNING) prv_finish(BLE_EXPORT_STOPPED);
+}
+
+void ble_export_set_enabled(bool enabled) {
+    s_enabled = enabled;
+}
+
+bool ble_export_enabled(void) {
+    return s_enabled;
+}
+
+void ble_export_get_status(ble_export_status_t *status) {
+    if (s_status.state == BLE_EXPORT_RUNNING) prv_update_rate();
+    *status = s_status;
+}
@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_EXPORT_H_
+#define BLE_EXPORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Bulk export of a stored file (e.g. the accelerometer logger's
+ * /ext/accel.dat, or accel.dat without /ext) to the phone over BLE.
+ *
+ * The file goes out as BLE_CMD_EXPORT requests, each carrying up to
+ * BLE_EXPORT_CHUNK bytes, or fewer if a chunk wouldn't fit in the UART's
+ * WATCH_UART_TX_BUF_SZ TX ring:
+ *
+ *   [offset LE32][file size LE32][data][CRC-16/CCITT-FALSE LE16]
+ *
+ * the CRC covering everything before it. The nRF answers each with the
+ * offset it wants next (LE32): the end of the chunk if it was good, or
+ * an earlier offset to have data sent again, or 0xFFFFFFFF to stop.
+ * Transfers are resumable: the phone can start one at any offset, with
+ * BLE_CMD_EXPORT_START [offset LE32][file name], as can `ble export`. A
+ * missing file is answered with a lone chunk whose size is 0xFFFFFFFF.
+ *
+ * Sending is throttled to what the link carries: up to a window of
+ * chunks is in flight, starting at one; it grows by one each time a
+ * window's worth is acknowledged in order, halves when the nRF asks for
+ * data again and drops to one on a timeout, after which sending resumes
+ * from the last acknowledged byte. Timeouts allow for the window's wire
+ * time at the current baud rate, so raise it first (`ble baud`) for
+ * speed. A chunk is only handed to the UART once the TX ring has room
+ * for all of it, so the main loop never waits for the wire.
+ *
+ * Only the files named in BLE_EXPORT_FILES can be sent, so a phone can't
+ * read out settings or TOTP secrets. Requests from the phone are refused
+ * until exports are turned on with `ble export on`, or the firmware is
+ * built with -DBLE_EXPORT_ENABLED=1, as any bonded phone could make them.
+ */
+
+/* Data bytes per chunk; with the header and CRC this fills one BLE_MESSAGE_MAX_LEN message */
+#ifndef BLE_EXPORT_CHUNK
+#define BLE_EXPORT_CHUNK          240
+#endif
+
+/* Most chunks in flight; leave a request slot for everything else */
+#ifndef BLE_EXPORT_MAX_WINDOW
+#define BLE_EXPORT_MAX_WINDOW     3
+#endif
+
+/* How long the nRF may take to pass a chunk on, on top of the wire time */
+#ifndef BLE_EXPORT_ACK_TIMEOUT_MS
+#define BLE_EXPORT_ACK_TIMEOUT_MS 1000
+#endif
+
+/* Timeouts in a row before the transfer is abandoned */
+#ifndef BLE_EXPORT_MAX_RETRIES
+#define BLE_EXPORT_MAX_RETRIES    5
+#endif
+
+/* Whether the phone may start exports from power-on; see ble_export_set_enabled */
+#ifndef BLE_EXPORT_ENABLED
+#define BLE_EXPORT_ENABLED        0
+#endif
+
+/* The files that may be exported, by their exact names */
+#ifndef BLE_EXPORT_FILES
+#define BLE_EXPORT_FILES          "accel.dat", "/ext/accel.dat"
+#endif
+
+#define BLE_EXPORT_NAME_MAX       32
+#define BLE_EXPORT_NO_FILE        0xFFFFFFFF
+
+typedef enum {
+    BLE_EXPORT_IDLE = 0,
+    BLE_EXPORT_RUNNING,
+    BLE_EXPORT_DONE,
+    BLE_EXPORT_FAILED,       /* timed out, or the file couldn't be read  */
+    BLE_EXPORT_STOPPED,      /* cancelled here or by the phone            */
+} ble_export_state_t;
+
+typedef struct {
+    ble_export_state_t state;
+    char     file[BLE_EXPORT_NAME_MAX + 1];
+    uint32_t size;
+    uint32_t start;          /* offset the transfer started (or resumed) at */
+    uint32_t acked;          /* the phone has every byte before this        */
+    uint32_t chunks;         /* chunks sent, resends included               */
+    uint32_t resends;        /* times the phone asked for data again        */
+    uint32_t timeouts;
+    uint8_t  window;
+    uint32_t elapsed_ms;
+    uint32_t bytes_per_s;    /* measured over the transfer so far           */
+} ble_export_status_t;
+
+/** Start answering the phone's BLE_CMD_EXPORT_START. Call once. */
+void ble_export_init(void);
+
+/**
+ * Start sending a file.
+ * @param offset Where to start; a transfer that was cut short can carry on from its acked offset
+ * @return false if a transfer is already running, or the file isn't in BLE_EXPORT_FILES or can't be found
+ */
+bool ble_export_start(const char *filename, uint32_t offset);
+
+/** Let the phone start exports, or not. Stopping doesn't end a transfer that's running. */
+void ble_export_set_enabled(bool enabled);
+bool ble_export_enabled(void);
+
+/** Keep sending if the request table was full. Call from the main loop. */
+void ble_export_task(void);
+
+/** True while a transfer is running. */
+bool ble_export_busy(void);
+
+/** Stop the transfer; the phone keeps what it has been sent. */
+void ble_export_cancel(void);
+
+void ble_export_get_status(ble_export_status_t *status);
+
+#endif /* BLE_EXPORT_H_ */
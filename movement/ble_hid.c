@@ -0,0 +1,156 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_hid.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "movement_log.h"
+
+#include <string.h>
+
+#if (BLE_HID_QUEUE_SZ & (BLE_HID_QUEUE_SZ - 1)) != 0
+#error "BLE_HID_QUEUE_SZ must be a power of two"
+#endif
+
+/* Free-running indices; head - tail is the number of characters queued */
+static char             s_queue[BLE_HID_QUEUE_SZ];
+static uint16_t         s_head;
+static uint16_t         s_tail;
+
+/* The chunk the nRF is typing; it leaves the queue when acknowledged */
+static uint8_t          s_chunk_len;
+static uint8_t          s_seq;
+
+/* Whether the nRF has ever answered a chunk, and if it never does, when the next may go */
+static bool             s_peer_acks;
+static bool             s_unacked;
+static uint32_t         s_next_send;
+
+static ble_hid_stats_t  s_stats;
+static uint32_t         s_burst_start;   /* ble_request_now() when the queue last left empty */
+static uint32_t         s_burst_chars;
+
+static void prv_send_next(void);
+
+static void prv_burst_done(void) {
+    s_stats.last_chars = s_burst_chars;
+    s_stats.last_ms    = (ble_request_now() - s_burst_start) * 1000 / 128;
+    s_burst_chars      = 0;
+}
+
+static void prv_taken(uint8_t taken) {
+    s_tail         += taken;
+    s_stats.typed  += taken;
+    s_burst_chars  += taken;
+    s_chunk_len     = 0;
+}
+
+static void prv_acked(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) context;
+    s_seq = 0;
+    if (status == BLE_REQUEST_TIMEOUT && !s_peer_acks) {
+        /* Firmware that doesn't answer SEND_STRING; it had as long to type this chunk as one that does */
+        MOVEMENT_LOG_WARN("hid: nRF doesn't ack, typing without waiting");
+        s_unacked   = true;
+        s_next_send = ble_request_now();
+        prv_taken(s_chunk_len);
+        prv_send_next();
+        return;
+    }
+    if (status != BLE_REQUEST_OK) {
+        if (status == BLE_REQUEST_TIMEOUT) MOVEMENT_LOG_WARN("hid: no ack, dropped %d chars", (uint16_t)(s_head - s_tail));
+        s_stats.dropped += (uint16_t)(s_head - s_tail);
+        s_tail = s_head;
+        s_chunk_len = 0;
+        prv_burst_done();
+        return;
+    }
+
+    /* The nRF may take fewer characters than it was sent; the rest go again with the next chunk */
+    s_peer_acks = true;
+    prv_taken((len >= 1 && data[0] < s_chunk_len) ? data[0] : s_chunk_len);
+    prv_send_next();
+}
+
+static void prv_send_next(void) {
+    uint16_t queued = s_head - s_tail;
+    if (s_seq != 0) return;
+    if (queued == 0) {
+        if (s_burst_chars) prv_burst_done();
+        return;
+    }
+
+    uint8_t chunk[BLE_TLV_MAX_LEN];
+    s_chunk_len = queued < BLE_TLV_MAX_LEN ? queued : BLE_TLV_MAX_LEN;
+    for (uint8_t i = 0; i < s_chunk_len; i++) chunk[i] = s_queue[(uint16_t)(s_tail + i) & (BLE_HID_QUEUE_SZ - 1)];
+
+    if (s_unacked) {
+        /* Paced by ble_hid_task, which the fast tick runs while the queue isn't empty */
+        if ((int32_t)(ble_request_now() - s_next_send) < 0 || ble_uart_tx_room() < s_chunk_len) {
+            s_chunk_len = 0;
+            return;
+        }
+        ble_uart_send(BLE_CMD_SEND_STRING, chunk, s_chunk_len);
+        s_next_send = ble_request_now() + (s_chunk_len * BLE_HID_UNACKED_MS_PER_CHAR * 128 + 999) / 1000;
+        s_stats.chunks++;
+        prv_taken(s_chunk_len);
+        prv_send_next();
+        return;
+    }
+
+    s_seq = ble_request_send(BLE_CMD_SEND_STRING, chunk, s_chunk_len, BLE_HID_ACK_TIMEOUT_MS, prv_acked, NULL);
+    if (s_seq == 0) {
+        /* The request table is full; ble_hid_task tries again */
+        s_chunk_len = 0;
+        return;
+    }
+    s_stats.chunks++;
+}
+
+size_t ble_hid_type(const char *text) {
+    if (s_head == s_tail && s_seq == 0) {
+        s_burst_start = ble_request_now();
+        s_burst_chars = 0;
+    }
+
+    size_t count = 0;
+    while (text[count] && (uint16_t)(s_head - s_tail) < BLE_HID_QUEUE_SZ) {
+        s_queue[s_head & (BLE_HID_QUEUE_SZ - 1)] = text[count++];
+        s_head++;
+    }
+    s_stats.dropped += strlen(text + count);
+
+    uint16_t depth = s_head - s_tail;
+    if (depth > s_stats.max_depth) s_stats.max_depth = depth;
+    prv_send_next();
+    return count;
+}
+
+void ble_hid_task(void) {
+    prv_send_next();
+}
+
+bool ble_hid_busy(void) {
+    return s_head != s_tail;
+}
+
+void ble_hid_cancel(void) {
+    s_peer_acks = false;
+    s_unacked   = false;
+    if (s_seq != 0) {
+        /* The callback drops the queue */
+        ble_request_cancel(s_seq);
+        return;
+    }
+    s_stats.dropped += (uint16_t)(s_head - s_tail);
+    s_tail = s_head;
+}
+
+void ble_hid_get_stats(ble_hid_stats_t *stats) {
+    *stats         = s_stats;
+    stats->depth   = s_head - s_tail;
+    stats->unacked = s_unacked;
+}
@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_HID_H_
+#define BLE_HID_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Queue of text to type on the host as HID keystrokes.
+ *
+ * Faces and shell commands add text of any length with ble_hid_type and
+ * return at once. The queue is sent as BLE_CMD_SEND_STRING requests of up
+ * to BLE_TLV_MAX_LEN characters, one at a time: the nRF answers each with
+ * a frame of the same type once it has typed the characters, giving the
+ * number it took as its value (an empty value means all of them), and any
+ * it didn't take are sent again. Each answer sends the next chunk from
+ * the ble_request callback, so typing carries on from the main loop
+ * without blocking it.
+ *
+ * If a chunk goes unanswered the rest of the queue is dropped rather
+ * than risk typing part of a password twice. Firmware that never answers
+ * SEND_STRING at all is told apart by its first chunk timing out before
+ * any has been answered: that chunk is taken as typed, and from then on
+ * chunks are sent without waiting, each BLE_HID_UNACKED_MS_PER_CHAR per
+ * character after the one before, until ble_hid_cancel.
+ */
+
+/* Characters that can wait to be typed; a power of two */
+#ifndef BLE_HID_QUEUE_SZ
+#define BLE_HID_QUEUE_SZ        256
+#endif
+
+/* How long the nRF may take to type one chunk; each key is a press and a release report */
+#ifndef BLE_HID_ACK_TIMEOUT_MS
+#define BLE_HID_ACK_TIMEOUT_MS  2000
+#endif
+
+/* How long to let the nRF type each character when it doesn't answer */
+#ifndef BLE_HID_UNACKED_MS_PER_CHAR
+#define BLE_HID_UNACKED_MS_PER_CHAR 30
+#endif
+
+typedef struct {
+    uint16_t depth;        /* characters waiting, including the chunk being typed */
+    uint16_t max_depth;    /* most characters ever waiting at once                */
+    uint32_t typed;        /* characters the nRF has acknowledged, or been sent   */
+    uint32_t chunks;       /* requests sent                                       */
+    uint32_t dropped;      /* characters dropped: queue full or chunk unanswered  */
+    uint32_t last_chars;   /* characters in the last burst, from empty to empty   */
+    uint32_t last_ms;      /* how long that burst took                            */
+    bool     unacked;      /* the nRF doesn't answer; chunks are sent unanswered  */
+} ble_hid_stats_t;
+
+/**
+ * Queue text to be typed.
+ * @return The number of characters queued; less than strlen(text) if the queue filled up
+ */
+size_t ble_hid_type(const char *text);
+
+/** Restart sending if the request table was full. Call from the main loop. */
+void ble_hid_task(void);
+
+/** True while there is text waiting to be typed. */
+bool ble_hid_busy(void);
+
+/**
+ * Drop everything that hasn't been typed yet, and forget whether the nRF
+ * answers, so that the next chunk waits for an answer again.
+ */
+void ble_hid_cancel(void);
+
+void ble_hid_get_stats(ble_hid_stats_t *stats);
+
+#endif /* BLE_HID_H_ */
@@ -0,0 +1,116 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_link.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+
+#include <stddef.h>
+
+/* Rates to try, fastest first */
+static const uint32_t s_rates[] = { 115200, 57600, 38400, 19200, 9600 };
+#define NUM_RATES (sizeof(s_rates) / sizeof(s_rates[0]))
+
+static bool               s_busy;
+static uint32_t           s_max_baud;
+static uint32_t           s_old_baud;   /* rate the link ran at when this proposal was made */
+static uint8_t            s_rate_idx;   /* rate being proposed */
+static uint8_t            s_tries;
+static ble_link_baud_cb_t s_callback;
+static void              *s_context;
+
+static void prv_propose(void);
+
+static void prv_finish(void) {
+    s_busy = false;
+    if (s_callback) s_callback(ble_uart_get_baud(), s_context);
+}
+
+/* A rate is worth proposing if it's allowed and would move the link toward max_baud */
+static bool prv_candidate(uint32_t rate) {
+    uint32_t current = ble_uart_get_baud();
+    if (rate > s_max_baud || rate == current) return false;
+    return rate > current || current > s_max_baud;
+}
+
+static void prv_recovered(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) data;
+    (void) len;
+    (void) context;
+    if (status == BLE_REQUEST_OK) {
+        s_rate_idx++;
+        prv_propose();
+        return;
+    }
+    /* The nRF goes back to the old rate after a second of silence; keep asking until it has.
+     * Pings it never heard won't be answered, so don't wait for those answers. */
+    ble_request_forget_late();
+    if (++s_tries < BLE_LINK_RECOVER_TRIES &&
+        ble_request_send(BLE_CMD_PING, NULL, 0, BLE_LINK_REPLY_MS, prv_recovered, NULL)) return;
+    prv_finish();
+}
+
+static void prv_verified(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) data;
+    (void) len;
+    (void) context;
+    if (status == BLE_REQUEST_OK) {
+        prv_finish();
+        return;
+    }
+    ble_uart_set_baud(s_old_baud);
+    ble_request_forget_late();
+    s_tries = 0;
+    if (!ble_request_send(BLE_CMD_PING, NULL, 0, BLE_LINK_REPLY_MS, prv_recovered, NULL)) prv_finish();
+}
+
+static void prv_answered(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) context;
+    if (status != BLE_REQUEST_OK) {
+        /* No answer at all: the nRF firmware doesn't negotiate, so stay put */
+        prv_finish();
+        return;
+    }
+    if (len < 1 || data[0] == 0) {
+        s_rate_idx++;
+        prv_propose();
+        return;
+    }
+    /* The nRF has sent its answer at the old rate and switched; follow it, then check the link */
+    ble_uart_set_baud(s_rates[s_rate_idx]);
+    ble_request_forget_late();
+    if (!ble_request_send(BLE_CMD_PING, NULL, 0, BLE_LINK_REPLY_MS, prv_verified, NULL)) prv_finish();
+}
+
+static void prv_propose(void) {
+    while (s_rate_idx < NUM_RATES && !prv_candidate(s_rates[s_rate_idx])) s_rate_idx++;
+    if (s_rate_idx >= NUM_RATES) {
+        prv_finish();
+        return;
+    }
+
+    uint32_t rate = s_rates[s_rate_idx];
+    uint8_t value[4] = { rate & 0xFF, (rate >> 8) & 0xFF, (rate >> 16) & 0xFF, rate >> 24 };
+    s_old_baud = ble_uart_get_baud();
+    if (!ble_request_send(BLE_CMD_SET_BAUD, value, 4, BLE_LINK_REPLY_MS, prv_answered, NULL)) prv_finish();
+}
+
+bool ble_link_negotiate_baud(uint32_t max_baud, ble_link_baud_cb_t callback, void *context) {
+    if (s_busy) return false;
+    s_busy     = true;
+    s_max_baud = max_baud > BLE_LINK_MAX_BAUD ? BLE_LINK_MAX_BAUD : max_baud;
+    s_rate_idx = 0;
+    s_callback = callback;
+    s_context  = context;
+    prv_propose();
+    return true;
+}
+
+bool ble_link_busy(void) {
+    return s_busy;
+}
@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_LINK_H_
+#define BLE_LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Management of the UART link to the nRF.
+ *
+ * The link starts at BLE_UART_BAUD, the rate the nRF boots at. Baud
+ * negotiation proposes faster rates with BLE_CMD_SET_BAUD, fastest first;
+ * once the nRF accepts one, both ends switch and a ping confirms the link.
+ * If the ping goes unanswered the watch returns to the old rate, waits for
+ * the nRF to do the same, and proposes the next rate down.
+ *
+ * If the nRF resets it comes back at BLE_UART_BAUD; negotiating down to
+ * BLE_UART_BAUD or calling ble_uart_set_baud(BLE_UART_BAUD) recovers.
+ */
+
+/* Fastest rate to propose; 115200 keeps the SERCOM's error under 1% at 4 MHz */
+#ifndef BLE_LINK_MAX_BAUD
+#define BLE_LINK_MAX_BAUD      115200
+#endif
+
+/* How long to wait for each answer during negotiation */
+#ifndef BLE_LINK_REPLY_MS
+#define BLE_LINK_REPLY_MS      250
+#endif
+
+/* How many times to ping at the old rate, after a failed switch, before giving up */
+#ifndef BLE_LINK_RECOVER_TRIES
+#define BLE_LINK_RECOVER_TRIES 6
+#endif
+
+/**
+ * Called from the main loop when negotiation ends.
+ * @param baud    The rate the link is now running at
+ * @param context The pointer passed to ble_link_negotiate_baud
+ */
+typedef void (*ble_link_baud_cb_t)(uint32_t baud, void *context);
+
+/**
+ * Move the link to the fastest rate no higher than max_baud that both
+ * ends accept. If the link is already faster than max_baud, it is
+ * stepped down instead. Runs in the background through ble_request;
+ * the callback runs at once if there is nothing to try.
+ * @return false if a negotiation is already running
+ */
+bool ble_link_negotiate_baud(uint32_t max_baud, ble_link_baud_cb_t callback, void *context);
+
+/** True while a negotiation is running. */
+bool ble_link_busy(void);
+
+#endif /* BLE_LINK_H_ */
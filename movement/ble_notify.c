@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_notify.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "filesystem.h"
+#include "movement.h"
+#include "movement_log.h"
+
+#include <string.h>
+
+#if (BLE_NOTIFY_QUEUE_LEN & (BLE_NOTIFY_QUEUE_LEN - 1)) != 0
+#error "BLE_NOTIFY_QUEUE_LEN must be a power of two"
+#endif
+
+/* Fixed-size, so any one can be read from flash without scanning the file */
+typedef struct {
+    uint8_t app;
+    uint8_t len;
+    char    text[BLE_NOTIFY_TEXT_MAX];
+} ble_notify_record_t;
+
+/* Free-running indices; head - tail is the number held in RAM */
+static ble_notify_record_t s_queue[BLE_NOTIFY_QUEUE_LEN];
+static uint8_t             s_head;
+static uint8_t             s_tail;
+
+/* Records in each file, oldest first */
+static uint16_t            s_file_count;
+static uint16_t            s_old_count;
+
+static ble_notify_stats_t  s_stats;
+
+#if BLE_NOTIFY_CUE
+static int8_t s_cue[] = {
+    BUZZER_NOTE_A7, 3,
+    BUZZER_NOTE_REST, 3,
+    BUZZER_NOTE_E8, 5,
+    0
+};
+#endif
+
+static uint16_t prv_records_in(char *filename) {
+    int32_t size = filesystem_get_file_size(filename);
+    return size > 0 ? size / sizeof(ble_notify_record_t) : 0;
+}
+
+static void prv_spill(ble_notify_record_t *record) {
+    if (s_file_count >= BLE_NOTIFY_FILE_RECORDS && filesystem_rename(BLE_NOTIFY_FILE, BLE_NOTIFY_OLD_FILE)) {
+        s_old_count  = s_file_count;
+        s_file_count = 0;
+    }
+    if (s_file_count < BLE_NOTIFY_FILE_RECORDS &&
+        filesystem_append_file(BLE_NOTIFY_FILE, (char *)record, sizeof(*record))) {
+        s_file_count++;
+        s_stats.spilled++;
+        return;
+    }
+    s_stats.lost++;
+    MOVEMENT_LOG_WARN("notify: couldn't save to %s", BLE_NOTIFY_FILE);
+}
+
+static void prv_received(uint8_t type, const uint8_t *data, uint8_t len) {
+    (void) type;
+    if (len < 1) return;
+
+    if ((uint8_t)(s_head - s_tail) == BLE_NOTIFY_QUEUE_LEN) {
+        prv_spill(&s_queue[s_tail & (BLE_NOTIFY_QUEUE_LEN - 1)]);
+        s_tail++;
+    }
+
+    ble_notify_record_t *record = &s_queue[s_head & (BLE_NOTIFY_QUEUE_LEN - 1)];
+    record->app = data[0];
+    record->len = (len - 1 > BLE_NOTIFY_TEXT_MAX) ? BLE_NOTIFY_TEXT_MAX : len - 1;
+    /* The display and the shell only cope with printable ASCII */
+    for (uint8_t i = 0; i < record->len; i++) {
+        char c = data[1 + i];
+        record->text[i] = (c >= ' ' && c <= '~') ? c : '?';
+    }
+    s_head++;
+
+    s_stats.received++;
+    if (s_stats.unread < UINT16_MAX) s_stats.unread++;
+#if BLE_NOTIFY_CUE
+    movement_play_sequence(s_cue);
+#endif
+}
+
+void ble_notify_init(void) {
+    s_file_count = prv_records_in(BLE_NOTIFY_FILE);
+    s_old_count  = prv_records_in(BLE_NOTIFY_OLD_FILE);
+    ble_request_set_handler(BLE_CMD_NOTIFY, prv_received);
+}
+
+uint16_t ble_notify_count(void) {
+    return (uint8_t)(s_head - s_tail) + s_file_count + s_old_count;
+}
+
+bool ble_notify_get(uint16_t index, ble_notification_t *notification) {
+    ble_notify_record_t record;
+    uint8_t in_ram = s_head - s_tail;
+
+    if (index < in_ram) {
+        record = s_queue[(uint8_t)(s_head - 1 - index) & (BLE_NOTIFY_QUEUE_LEN - 1)];
+    } else {
+        char    *filename = BLE_NOTIFY_FILE;
+        uint16_t count    = s_file_count;
+        index -= in_ram;
+        if (index >= count) {
+            index   -= count;
+            filename = BLE_NOTIFY_OLD_FILE;
+            count    = s_old_count;
+            if (index >= count) return false;
+        }
+        int32_t offset = (int32_t)(count - 1 - index) * sizeof(record);
+        if (filesystem_read_file_at(filename, offset, (char *)&record, sizeof(record)) != sizeof(record)) return false;
+        if (record.len > BLE_NOTIFY_TEXT_MAX) return false;
+    }
+
+    notification->app = record.app;
+    notification->len = record.len;
+    memcpy(notification->text, record.text, record.len);
+    notification->text[record.len] = '\0';
+    return true;
+}
+
+void ble_notify_clear(void) {
+    s_tail = s_head;
+    if (s_file_count) filesystem_rm(BLE_NOTIFY_FILE);
+    if (s_old_count)  filesystem_rm(BLE_NOTIFY_OLD_FILE);
+    s_file_count = 0;
+    s_old_count  = 0;
+    s_stats.unread = 0;
+}
+
+void ble_notify_mark_read(void) {
+    s_stats.unread = 0;
+}
+
+void ble_notify_get_stats(ble_notify_stats_t *stats) {
+    *stats = s_stats;
+}
@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_NOTIFY_H_
+#define BLE_NOTIFY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "filesystem_config.h"
+
+/*
+ * Phone notifications mirrored by the nRF (BLE_CMD_NOTIFY).
+ *
+ * The newest BLE_NOTIFY_QUEUE_LEN are kept in RAM. When one more
+ * arrives, the oldest is appended to BLE_NOTIFY_FILE rather than lost;
+ * once that holds BLE_NOTIFY_FILE_RECORDS it becomes BLE_NOTIFY_OLD_FILE,
+ * replacing the one before, so flash holds between one and two files'
+ * worth. Notifications are numbered from the newest, across RAM and
+ * both files.
+ *
+ * Every append rewrites a block, so with only the internal filesystem
+ * each file is kept to a single 256-byte block: the history costs two
+ * of its 32 blocks. With FILESYSTEM_ENABLE_EXT it goes to the external
+ * flash instead, where it can be far longer.
+ *
+ * The nRF sends each notification as one burst of fragments behind a
+ * single wake byte, and everything done with it (queueing, spilling to
+ * flash and the buzzer cue, which plays from the buzzer's own interrupt)
+ * happens in the one pass of the main loop that the burst wakes. Faces
+ * pick new notifications up on their next regular tick, so a
+ * notification costs one wake and no more.
+ */
+
+/* Longest text kept; the nRF truncates longer notifications. Bytes
+ * outside printable ASCII are kept as '?'. */
+#define BLE_NOTIFY_TEXT_MAX       32
+
+/* Notifications kept in RAM; a power of two */
+#ifndef BLE_NOTIFY_QUEUE_LEN
+#define BLE_NOTIFY_QUEUE_LEN      8
+#endif
+
+/* Notifications per file before it is rotated; a record is 34 bytes */
+#ifndef BLE_NOTIFY_FILE_RECORDS
+#if FILESYSTEM_ENABLE_EXT
+#define BLE_NOTIFY_FILE_RECORDS   32
+#else
+#define BLE_NOTIFY_FILE_RECORDS   7
+#endif
+#endif
+
+#if FILESYSTEM_ENABLE_EXT
+#define BLE_NOTIFY_FILE           FILESYSTEM_EXT_PREFIX "/notify.dat"
+#define BLE_NOTIFY_OLD_FILE       FILESYSTEM_EXT_PREFIX "/notify.old"
+#else
+#define BLE_NOTIFY_FILE           "notify.dat"
+#define BLE_NOTIFY_OLD_FILE       "notify.old"
+#endif
+
+/* Play a short cue on the buzzer when a notification arrives */
+#ifndef BLE_NOTIFY_CUE
+#define BLE_NOTIFY_CUE            1
+#endif
+
+/* App IDs the nRF firmware sends; anything else is shown as its number */
+#define BLE_NOTIFY_APP_OTHER      0x00
+#define BLE_NOTIFY_APP_CALL       0x01
+#define BLE_NOTIFY_APP_SMS        0x02
+#define BLE_NOTIFY_APP_EMAIL      0x03
+#define BLE_NOTIFY_APP_CALENDAR   0x04
+#define BLE_NOTIFY_APP_SOCIAL     0x05
+
+typedef struct {
+    uint8_t app;
+    uint8_t len;
+    char    text[BLE_NOTIFY_TEXT_MAX + 1];  /* null-terminated */
+} ble_notification_t;
+
+typedef struct {
+    uint32_t received;     /* notifications received since power-on */
+    uint32_t spilled;      /* ...of which moved from RAM to flash    */
+    uint32_t lost;         /* ...of which lost, flash being unusable */
+    uint16_t unread;       /* received since ble_notify_mark_read    */
+} ble_notify_stats_t;
+
+/** Start receiving notifications. Call once, after the filesystem is up. */
+void ble_notify_init(void);
+
+/** Number of notifications kept, in RAM and in flash. */
+uint16_t ble_notify_count(void);
+
+/**
+ * Fetch one notification.
+ * @param index 0 for the newest, up to ble_notify_count() - 1
+ * @return false if there is no such notification or it couldn't be read
+ */
+bool ble_notify_get(uint16_t index, ble_notification_t *notification);
+
+/** Forget every notification, in RAM and in flash. */
+void ble_notify_clear(void);
+
+/** Zero the unread count, e.g. once the notifications have been shown. */
+void ble_notify_mark_read(void);
+
+void ble_notify_get_stats(ble_notify_stats_t *stats);
+
+#endif /* BLE_NOTIFY_H_ */
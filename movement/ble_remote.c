@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_remote.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "movement.h"
+
+#if (BLE_REMOTE_QUEUE_LEN & (BLE_REMOTE_QUEUE_LEN - 1)) != 0 || BLE_REMOTE_QUEUE_LEN > 128
+#error "BLE_REMOTE_QUEUE_LEN must be a power of two, no more than 128"
+#endif
+
+#define GAP_TICKS  ((BLE_REMOTE_GAP_MS * 128 + 999) / 1000)
+
+/* Free-running indices; head - tail is the number waiting */
+static uint8_t            s_queue[BLE_REMOTE_QUEUE_LEN];
+static uint8_t            s_head;
+static uint8_t            s_tail;
+
+static bool               s_enabled = BLE_REMOTE_ENABLED;
+static bool               s_delivered_any;
+static uint32_t           s_delivered_at;     /* ble_request_now() of the last event delivered */
+static ble_remote_stats_t s_stats;
+
+/* Movement's button events run LIGHT, MODE, ALARM, each DOWN, UP, LONG_PRESS, LONG_UP */
+static uint8_t prv_event_for(uint8_t code) {
+    uint8_t button = code >> 4;
+    uint8_t action = code & 0x0F;
+    if (button > 2 || action > BLE_REMOTE_LONG_UP) return EVENT_NONE;
+    return EVENT_LIGHT_BUTTON_DOWN + button * 4 + action;
+}
+
+static void prv_received(uint8_t type, const uint8_t *data, uint8_t len) {
+    uint8_t queued = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t event = prv_event_for(data[i]);
+        s_stats.received++;
+        if (!s_enabled || event == EVENT_NONE || (uint8_t)(s_head - s_tail) == BLE_REMOTE_QUEUE_LEN) {
+            s_stats.dropped++;
+            continue;
+        }
+        s_queue[s_head++ & (BLE_REMOTE_QUEUE_LEN - 1)] = event;
+        queued++;
+    }
+    uint8_t depth = s_head - s_tail;
+    if (depth > s_stats.max_depth) s_stats.max_depth = depth;
+    ble_uart_send(type, &queued, 1);
+}
+
+void ble_remote_init(void) {
+    ble_request_set_handler(BLE_CMD_BUTTON, prv_received);
+}
+
+uint8_t ble_remote_next(void) {
+    if (s_head == s_tail) return EVENT_NONE;
+    uint32_t now = ble_request_now();
+    if (s_delivered_any && now - s_delivered_at < GAP_TICKS) return EVENT_NONE;
+    s_delivered_any = true;
+    s_delivered_at  = now;
+    s_stats.delivered++;
+    return s_queue[s_tail++ & (BLE_REMOTE_QUEUE_LEN - 1)];
+}
+
+bool ble_remote_busy(void) {
+    return s_head != s_tail;
+}
+
+void ble_remote_set_enabled(bool enabled) {
+    s_enabled = enabled;
+    if (!enabled) ble_remote_clear();
+}
+
+bool ble_remote_enabled(void) {
+    return s_enabled;
+}
+
+void ble_remote_clear(void) {
+    s_tail = s_head;
+}
+
+void ble_remote_get_stats(ble_remote_stats_t *stats) {
+    *stats       = s_stats;
+    stats->depth = s_head - s_tail;
+}
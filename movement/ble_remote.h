@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_REMOTE_H_
+#define BLE_REMOTE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Button presses sent from the phone (BLE_CMD_BUTTON), for driving faces
+ * in UI tests, soak tests and demos without touching the watch.
+ *
+ * Each byte of the value is one button event: the button in the high
+ * nibble and what it did in the low one (BLE_REMOTE_*), so a short press
+ * of MODE is 0x10 0x11. The nRF is answered with the number it queued;
+ * fewer than it sent means the queue was full or an event was invalid,
+ * and it should back off and send the rest again.
+ *
+ * Events wait in a queue of their own, not in Movement's event slot,
+ * which a real button press would overwrite. app_loop takes one when the
+ * slot is empty, no sooner than BLE_REMOTE_GAP_MS after the last, and it
+ * reaches the face just as a real press would, so faces can't tell the
+ * difference. A press held for longer is sent as DOWN, LONG_PRESS and
+ * LONG_UP.
+ *
+ * The remote is off until enabled, and refuses every event until then.
+ */
+
+#define BLE_REMOTE_LIGHT          0x00
+#define BLE_REMOTE_MODE           0x10
+#define BLE_REMOTE_ALARM          0x20
+
+#define BLE_REMOTE_DOWN           0x00
+#define BLE_REMOTE_UP             0x01
+#define BLE_REMOTE_LONG_PRESS     0x02
+#define BLE_REMOTE_LONG_UP        0x03
+
+/* Events waiting to be delivered; a power of two */
+#ifndef BLE_REMOTE_QUEUE_LEN
+#define BLE_REMOTE_QUEUE_LEN      16
+#endif
+
+/* Least time between two events reaching the face */
+#ifndef BLE_REMOTE_GAP_MS
+#define BLE_REMOTE_GAP_MS         100
+#endif
+
+/* Whether the phone may press buttons from power-on. Off, since any bonded
+ * phone could then drive the watch; turn it on with `ble remote on`, or
+ * build with -DBLE_REMOTE_ENABLED=1. See ble_remote_set_enabled. */
+#ifndef BLE_REMOTE_ENABLED
+#define BLE_REMOTE_ENABLED        0
+#endif
+
+typedef struct {
+    uint32_t received;     /* events sent by the phone                             */
+    uint32_t delivered;    /* ...of which passed to the face                       */
+    uint32_t dropped;      /* ...of which refused: queue full, invalid or disabled */
+    uint8_t  depth;        /* events waiting                                       */
+    uint8_t  max_depth;    /* most events ever waiting at once                     */
+} ble_remote_stats_t;
+
+/** Start taking button events from the phone. Call once. */
+void ble_remote_init(void);
+
+/**
+ * Take the next event if one is due.
+ * @return A movement_event_type_t, or EVENT_NONE if the queue is empty or the last event was too recent
+ */
+uint8_t ble_remote_next(void);
+
+/** True while events are waiting; the fast tick times the gap between them. */
+bool ble_remote_busy(void);
+
+/** Stop or start taking events from the phone. Stopping drops any that are waiting. */
+void ble_remote_set_enabled(bool enabled);
+bool ble_remote_enabled(void);
+
+/** Drop the events that are waiting. */
+void ble_remote_clear(void);
+
+void ble_remote_get_stats(ble_remote_stats_t *stats);
+
+#endif /* BLE_REMOTE_H_ */
@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_request.h"
+#include "ble_uart.h"
+
+#include <stddef.h>
+
+typedef struct {
+    uint8_t          seq;       /* 0 = free slot */
+    uint8_t          type;
+    uint32_t         deadline;  /* in fast ticks */
+    ble_request_cb_t callback;
+    void            *context;
+} ble_request_t;
+
+typedef struct {
+    uint8_t             type;
+    ble_frame_handler_t handler;
+} ble_handler_t;
+
+/* Answers the nRF still owes for requests that timed out or were cancelled */
+typedef struct {
+    uint8_t          type;
+    uint8_t          count;     /* 0 = free slot */
+    uint32_t         until;     /* forgotten after this, in case they were lost */
+} ble_owed_t;
+
+static ble_request_t      s_requests[BLE_REQUEST_TABLE_LEN];
+static ble_owed_t         s_owed[BLE_REQUEST_TABLE_LEN];
+static ble_handler_t      s_handlers[BLE_REQUEST_MAX_HANDLERS];
+static uint8_t            s_next_seq = 1;
+static volatile uint32_t  s_now;   /* fast ticks, 128 per second */
+static uint32_t           s_rx_losses;
+
+/* Fragments of a long message collect here until the last one arrives */
+static uint8_t            s_message[BLE_MESSAGE_MAX_LEN];
+static uint8_t            s_message_len;
+static bool               s_message_open;
+static uint8_t            s_message_type;
+static uint32_t           s_message_wakes;  /* the UART's wake count when the message began */
+
+#define LATE_TICKS  ((BLE_REQUEST_LATE_MS * 128 + 999) / 1000)
+
+/* The frame went out, so an answer may still come; remember to throw it away */
+static void prv_owe(uint8_t type) {
+    ble_owed_t *slot = NULL;
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_owed[i].count && (int32_t)(s_now - s_owed[i].until) >= 0) s_owed[i].count = 0;
+        if (s_owed[i].count && s_owed[i].type == type) slot = &s_owed[i];
+    }
+    for (uint8_t i = 0; slot == NULL && i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_owed[i].count == 0) slot = &s_owed[i];
+    }
+    if (slot == NULL) return;
+    slot->type  = type;
+    slot->until = s_now + LATE_TICKS;
+    if (slot->count < UINT8_MAX) slot->count++;
+}
+
+/* True if the frame is a late answer to an abandoned request */
+static bool prv_was_owed(uint8_t type) {
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_owed[i].count == 0 || s_owed[i].type != type) continue;
+        if ((int32_t)(s_now - s_owed[i].until) >= 0) {
+            s_owed[i].count = 0;
+            return false;
+        }
+        s_owed[i].count--;
+        return true;
+    }
+    return false;
+}
+
+/* Frees the slot before calling back, so the callback may send another request */
+static void prv_complete(ble_request_t *request, ble_request_status_t status,
+                         const uint8_t *data, uint8_t len) {
+    ble_request_t done = *request;
+    request->seq = 0;
+    if (status != BLE_REQUEST_OK) prv_owe(done.type);
+    if (done.callback) done.callback(done.seq, status, data, len, done.context);
+}
+
+static void prv_dispatch(uint8_t type, const uint8_t *data, uint8_t len) {
+    /* The nRF answers in order, so answers to abandoned requests come first */
+    if (prv_was_owed(type)) return;
+
+    /* The oldest request of this type gets the answer: sequence IDs wrap, so
+     * compare how long ago each was issued rather than the IDs themselves. */
+    ble_request_t *oldest = NULL;
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        ble_request_t *request = &s_requests[i];
+        if (request->seq == 0 || request->type != type) continue;
+        if (oldest == NULL || (uint8_t)(s_next_seq - request->seq) > (uint8_t)(s_next_seq - oldest->seq)) {
+            oldest = request;
+        }
+    }
+    if (oldest) {
+        prv_complete(oldest, BLE_REQUEST_OK, data, len);
+        return;
+    }
+
+    for (uint8_t i = 0; i < BLE_REQUEST_MAX_HANDLERS; i++) {
+        if (s_handlers[i].handler && s_handlers[i].type == type) {
+            s_handlers[i].handler(type, data, len);
+            return;
+        }
+    }
+}
+
+static void prv_receive(uint8_t type, const uint8_t *data, uint8_t len) {
+    uint8_t base = type & ~BLE_TLV_MORE;
+    ble_uart_stats_t stats;
+    ble_uart_get_stats(&stats);
+
+    /* A frame of another type means the rest of the message was lost. So does the UART having
+     * parked since it began, as the nRF sends a message's fragments back to back. */
+    if (s_message_open && (s_message_type != base || s_message_wakes != stats.wakes)) s_message_open = false;
+
+    if (!s_message_open) {
+        if (!(type & BLE_TLV_MORE)) {
+            prv_dispatch(type, data, len);
+            return;
+        }
+        s_message_open  = true;
+        s_message_type  = base;
+        s_message_len   = 0;
+        s_message_wakes = stats.wakes;
+    }
+
+    if (len > BLE_MESSAGE_MAX_LEN - s_message_len) {
+        s_message_open = false;
+        return;
+    }
+    for (uint8_t i = 0; i < len; i++) s_message[s_message_len++] = data[i];
+    if (type & BLE_TLV_MORE) return;
+
+    s_message_open = false;
+    prv_dispatch(base, s_message, s_message_len);
+}
+
+uint8_t ble_request_send(uint8_t type, const uint8_t *data, uint8_t len,
+                         uint16_t timeout_ms, ble_request_cb_t callback, void *context) {
+    ble_request_t *request = NULL;
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_requests[i].seq == 0) {
+            request = &s_requests[i];
+            break;
+        }
+    }
+    if (request == NULL) return 0;
+
+    request->seq      = s_next_seq;
+    request->type     = type;
+    /* Round up, plus one tick, since the current tick is already partly over */
+    request->deadline = s_now + ((uint32_t)timeout_ms * 128 + 999) / 1000 + 1;
+    request->callback = callback;
+    request->context  = context;
+    if (++s_next_seq == 0) s_next_seq = 1;
+
+    ble_uart_send_long(type, data, len);
+    return request->seq;
+}
+
+void ble_request_cancel(uint8_t seq) {
+    if (seq == 0) return;
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_requests[i].seq == seq) {
+            prv_complete(&s_requests[i], BLE_REQUEST_CANCELLED, NULL, 0);
+            return;
+        }
+    }
+}
+
+bool ble_request_pending(void) {
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_requests[i].seq != 0) return true;
+    }
+    return false;
+}
+
+bool ble_request_set_handler(uint8_t type, ble_frame_handler_t handler) {
+    ble_handler_t *free_slot = NULL;
+    for (uint8_t i = 0; i < BLE_REQUEST_MAX_HANDLERS; i++) {
+        if (s_handlers[i].handler && s_handlers[i].type == type) {
+            s_handlers[i].handler = handler;
+            return true;
+        }
+        if (!s_handlers[i].handler && !free_slot) free_slot = &s_handlers[i];
+    }
+    if (handler == NULL) return true;
+    if (free_slot == NULL) return false;
+    free_slot->type    = type;
+    free_slot->handler = handler;
+    return true;
+}
+
+void ble_request_forget_late(void) {
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) s_owed[i].count = 0;
+}
+
+/* A frame dropped on the way in may have been an owed answer, which now never comes */
+static void prv_check_losses(void) {
+    ble_uart_stats_t stats;
+    ble_uart_get_stats(&stats);
+    uint32_t losses = stats.overruns + stats.crc_errors + stats.length_errors + stats.uart_dropped;
+    if (losses != s_rx_losses) ble_request_forget_late();
+    s_rx_losses = losses;
+}
+
+uint32_t ble_request_now(void) {
+    return s_now;
+}
+
+void ble_request_fast_tick(void) {
+    s_now++;
+}
+
+void ble_request_task(void) {
+    uint8_t type, data[BLE_TLV_MAX_LEN], len;
+    while (ble_uart_task(&type, data, &len)) prv_receive(type, data, len);
+    prv_check_losses();
+
+    uint32_t now = s_now;
+    for (uint8_t i = 0; i < BLE_REQUEST_TABLE_LEN; i++) {
+        if (s_requests[i].seq != 0 && (int32_t)(now - s_requests[i].deadline) >= 0) {
+            prv_complete(&s_requests[i], BLE_REQUEST_TIMEOUT, NULL, 0);
+        }
+    }
+}
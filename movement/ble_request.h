@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_REQUEST_H_
+#define BLE_REQUEST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Asynchronous request/response layer over ble_uart.
+ *
+ * A request sends one TLV frame and waits, without blocking, for the nRF
+ * to answer with a frame of the same type. Each request gets a sequence
+ * ID; answers to several requests of one type are matched oldest first,
+ * since the nRF handles them in order. The result is delivered to a
+ * completion callback from ble_request_task, which Movement calls from
+ * its main loop, so callbacks may update the display or settings.
+ *
+ * Timeouts count Movement's 128 Hz fast tick, which is kept running (and
+ * the watch kept out of standby) while any request is outstanding.
+ *
+ * A request that times out or is cancelled has still been sent, so the
+ * nRF's answer may yet arrive. The next answers of that type, up to one
+ * per such request, are thrown away rather than matched to newer
+ * requests, until BLE_REQUEST_LATE_MS passes without another. A frame
+ * lost on the way in may have been one of them, so any receive error
+ * ends the wait, as does ble_request_forget_late.
+ *
+ * Frames that don't answer a request go to the handler registered for
+ * their type, if any.
+ *
+ * Messages longer than one frame travel as BLE_TLV_MORE fragments in
+ * both directions; requests, answers and handlers see them whole. One
+ * cut short by the UART parking is dropped, not joined to the next.
+ */
+
+/* Requests that can be outstanding at once */
+#ifndef BLE_REQUEST_TABLE_LEN
+#define BLE_REQUEST_TABLE_LEN  4
+#endif
+
+/* How long an abandoned request's answer is expected, after it was given up on */
+#ifndef BLE_REQUEST_LATE_MS
+#define BLE_REQUEST_LATE_MS    2000
+#endif
+
+/* Frame types that can have a handler for unsolicited frames */
+#ifndef BLE_REQUEST_MAX_HANDLERS
+#define BLE_REQUEST_MAX_HANDLERS 4
+#endif
+
+typedef enum {
+    BLE_REQUEST_OK = 0,      /* the nRF answered; data/len hold its value */
+    BLE_REQUEST_TIMEOUT,     /* no answer in time; data is NULL          */
+    BLE_REQUEST_CANCELLED,   /* ble_request_cancel was called            */
+} ble_request_status_t;
+
+/**
+ * Called once per request, from the main loop, when it completes.
+ * @param seq     The ID ble_request_send returned
+ * @param status  How the request ended
+ * @param data    The answer's value bytes (only valid during the call)
+ * @param len     Number of value bytes
+ * @param context The pointer passed to ble_request_send
+ */
+typedef void (*ble_request_cb_t)(uint8_t seq, ble_request_status_t status,
+                                 const uint8_t *data, uint8_t len, void *context);
+
+/** Called from the main loop with a frame that didn't answer a request. */
+typedef void (*ble_frame_handler_t)(uint8_t type, const uint8_t *data, uint8_t len);
+
+/**
+ * Send a frame and wait in the background for the answer.
+ * @param type       Command type (BLE_CMD_*); the answer must have the same type
+ * @param data       Value bytes, or NULL if len == 0
+ * @param len        Value length (0–BLE_MESSAGE_MAX_LEN)
+ * @param timeout_ms How long to wait for the answer (at most 20 s)
+ * @param callback   Completion callback, or NULL to ignore the outcome
+ * @param context    Passed to the callback
+ * @return The request's sequence ID (never 0), or 0 if the table is full
+ */
+uint8_t ble_request_send(uint8_t type, const uint8_t *data, uint8_t len,
+                         uint16_t timeout_ms, ble_request_cb_t callback, void *context);
+
+/** Abandon a request; its callback runs with BLE_REQUEST_CANCELLED. */
+void ble_request_cancel(uint8_t seq);
+
+/** Stop waiting for answers to abandoned requests, e.g. after changing the baud rate. */
+void ble_request_forget_late(void);
+
+/** True while any request is waiting for its answer. */
+bool ble_request_pending(void);
+
+/**
+ * Route frames of one type that aren't answers to a request to a handler.
+ * @param handler The handler, or NULL to remove the one for this type
+ * @return false if every handler slot is taken
+ */
+bool ble_request_set_handler(uint8_t type, ble_frame_handler_t handler);
+
+/** The timeout clock, in 1/128 s ticks; it only runs while the fast tick does. */
+uint32_t ble_request_now(void);
+
+/** Advance the timeout clock by one 1/128 s tick. Safe to call from an interrupt. */
+void ble_request_fast_tick(void);
+
+/** Dispatch received frames and expire requests. Call from the main loop. */
+void ble_request_task(void);
+
+#endif /* BLE_REQUEST_H_ */
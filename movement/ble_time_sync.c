@@ -0,0 +1,219 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+
+#include "ble_time_sync.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "movement.h"
+#include "movement_log.h"
+#include "watch_utility.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/* Number of timezones in movement_timezone_offsets array */
+#define NUM_MOVEMENT_TIMEZONES 41
+
+/* One FREQCORR step changes the RTC's rate by 1 part in 2^20, ~0.954 ppm */
+#define FREQCORR_STEPS_PER_PPM  1.048576
+
+extern movement_state_t movement_state;
+
+typedef struct {
+    uint32_t time;      /* seconds since the first sample */
+    int32_t  error_ms;  /* phone minus the RTC, had it never been stepped */
+} sync_sample_t;
+
+static sync_sample_t      s_samples[BLE_TIME_SYNC_SAMPLES];
+static uint8_t            s_count;
+static uint32_t           s_origin;      /* RTC time of the first sample, as a "unix" time in local time */
+static int32_t            s_stepped_ms;  /* total stepped out of the RTC since the first sample */
+
+static ble_time_sync_status_t s_status;
+static bool               s_busy;
+static uint16_t           s_minutes;
+static ble_time_sync_cb_t s_callback;
+static void              *s_context;
+
+static void prv_write_freqcorr(int16_t value) {
+    if (value > 127) value = 127;
+    if (value < -127) value = -127;
+    if (value < 0) {
+        watch_rtc_freqcorr_write(-value, 1);
+    } else {
+        watch_rtc_freqcorr_write(value, 0);
+    }
+}
+
+static int32_t prv_round(double value) {
+    return (int32_t)(value >= 0 ? value + 0.5 : value - 0.5);
+}
+
+/* Fits a line through the samples and trims the drift out once they span long enough */
+static void prv_fit(void) {
+    if (s_count < 3) return;
+    uint32_t span = s_samples[s_count - 1].time - s_samples[0].time;
+    if (span < BLE_TIME_SYNC_MIN_SPAN_HOURS * 3600UL) return;
+
+    int64_t sum_t = 0, sum_e = 0;
+    for (uint8_t i = 0; i < s_count; i++) {
+        sum_t += s_samples[i].time;
+        sum_e += s_samples[i].error_ms;
+    }
+    /* Centred on the means, in units of 1/count so the sums stay integers */
+    int64_t num = 0, den = 0;
+    for (uint8_t i = 0; i < s_count; i++) {
+        int64_t dt = (int64_t)s_samples[i].time * s_count - sum_t;
+        int64_t de = (int64_t)s_samples[i].error_ms * s_count - sum_e;
+        num += dt * de;
+        den += dt * dt;
+    }
+    if (den == 0) return;
+
+    /* The slope is in ms per second, i.e. thousands of ppm */
+    double ppm = (double)num / den * 1000;
+    s_status.drift_ppb = prv_round(ppm * 1000);
+    int32_t steps = prv_round(ppm * FREQCORR_STEPS_PER_PPM);
+    if (steps == 0) return;
+
+    /* A clock falling behind needs less of the correction that slows it */
+    int16_t freqcorr = watch_rtc_freqcorr_read();
+    prv_write_freqcorr(freqcorr - steps);
+    MOVEMENT_LOG_INFO("time sync: drift %" PRId32 " ppb, freqcorr %d -> %d", s_status.drift_ppb,
+                      freqcorr, watch_rtc_freqcorr_read());
+
+    /* The old samples describe the old rate; start again from the newest */
+    s_origin             += s_samples[s_count - 1].time;
+    s_samples[0].time     = 0;
+    s_samples[0].error_ms = s_samples[s_count - 1].error_ms;
+    s_count               = 1;
+}
+
+static void prv_add_sample(uint32_t now, int32_t offset_ms) {
+    if (s_count == 0) {
+        s_origin     = now;
+        s_stepped_ms = 0;
+    }
+    if (s_count == BLE_TIME_SYNC_SAMPLES) {
+        for (uint8_t i = 1; i < s_count; i++) s_samples[i - 1] = s_samples[i];
+        s_count--;
+    }
+    s_samples[s_count].time     = now - s_origin;
+    s_samples[s_count].error_ms = offset_ms + s_stepped_ms;
+    s_count++;
+    prv_fit();
+}
+
+static void prv_apply_timezone(int16_t tz_minutes) {
+    // Find closest match in movement_timezone_offsets[]
+    uint8_t best_idx = 0;
+    int16_t best_diff = 32767;
+    for (uint8_t i = 0; i < NUM_MOVEMENT_TIMEZONES; i++) {
+        int16_t diff = movement_timezone_offsets[i] - tz_minutes;
+        if (diff < 0) diff = -diff;
+        if (diff < best_diff) {
+            best_diff = diff;
+            best_idx = i;
+        }
+    }
+    movement_state.settings.bit.time_zone = best_idx;
+}
+
+/* Brings the next background sync forward after a failure */
+static void prv_schedule_retry(void) {
+#if BLE_TIME_SYNC_RETRY_MINUTES < BLE_TIME_SYNC_INTERVAL_MINUTES
+    s_minutes = BLE_TIME_SYNC_INTERVAL_MINUTES - BLE_TIME_SYNC_RETRY_MINUTES;
+#else
+    s_minutes = 0;
+#endif
+}
+
+static void prv_done(bool ok, int32_t offset_ms) {
+    s_busy = false;
+    if (!ok) {
+        s_status.failures++;
+        prv_schedule_retry();
+    }
+    if (s_callback) s_callback(ok, offset_ms, s_context);
+}
+
+static void prv_time_received(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) context;
+    if (status != BLE_REQUEST_OK || len < 6) {
+        prv_done(false, 0);
+        return;
+    }
+
+    watch_date_time phone;
+    phone.reg = (uint32_t)data[0]
+              | ((uint32_t)data[1] << 8)
+              | ((uint32_t)data[2] << 16)
+              | ((uint32_t)data[3] << 24);
+    int16_t tz_minutes = (int16_t)((uint16_t)data[4] | ((uint16_t)data[5] << 8));
+    int32_t phone_ms = (len >= 7) ? (int32_t)data[6] * 1000 / 256 : 0;
+
+    /* The RTC's fraction of a second can't be read. Background syncs start on the minute, so it is
+     * about the round trip each time, a constant that doesn't disturb the drift rate. */
+    uint32_t phone_s = watch_utility_date_time_to_unix_time(phone, 0);
+    uint32_t now     = watch_utility_date_time_to_unix_time(watch_rtc_get_date_time(), 0);
+    int32_t delta_s  = (int32_t)(phone_s - now);
+
+    s_status.syncs++;
+    prv_apply_timezone(tz_minutes);
+
+    if (delta_s > BLE_TIME_SYNC_MAX_DRIFT_S || delta_s < -BLE_TIME_SYNC_MAX_DRIFT_S) {
+        /* Too far off to be drift: the time was set by hand, or never. Take the phone's and start over. */
+        watch_rtc_set_date_time(phone);
+        s_count = 0;
+        s_status.last_offset_ms = delta_s * 1000;
+        MOVEMENT_LOG_INFO("time sync: set, was %" PRId32 " s off", delta_s);
+        prv_done(true, delta_s * 1000);
+        return;
+    }
+
+    int32_t offset_ms = delta_s * 1000 + phone_ms;
+    s_status.last_offset_ms = offset_ms;
+    prv_add_sample(now, offset_ms);
+
+    int32_t step_s = prv_round(offset_ms / 1000.0);
+    if (step_s != 0) {
+        watch_rtc_set_date_time(watch_utility_date_time_from_unix_time(now + step_s, 0));
+        s_stepped_ms += step_s * 1000;
+    }
+    MOVEMENT_LOG_DEBUG("time sync: offset %" PRId32 " ms, stepped %" PRId32 " s", offset_ms, step_s);
+    prv_done(true, offset_ms);
+}
+
+bool ble_time_sync_now(ble_time_sync_cb_t callback, void *context) {
+    if (s_busy) return false;
+    if (ble_request_send(BLE_CMD_GET_TIME, NULL, 0, BLE_TIME_SYNC_TIMEOUT_MS, prv_time_received, NULL) == 0) return false;
+    s_busy     = true;
+    s_minutes  = 0;
+    s_callback = callback;
+    s_context  = context;
+    return true;
+}
+
+void ble_time_sync_background_task(bool can_sync) {
+#if BLE_TIME_SYNC_INTERVAL_MINUTES
+    if (s_minutes < BLE_TIME_SYNC_INTERVAL_MINUTES) s_minutes++;
+    if (s_minutes < BLE_TIME_SYNC_INTERVAL_MINUTES || !can_sync || s_busy) return;
+    if (!ble_time_sync_now(NULL, NULL)) prv_schedule_retry();
+#else
+    (void) can_sync;
+#endif
+}
+
+void ble_time_sync_reset(void) {
+    s_count = 0;
+}
+
+void ble_time_sync_get_status(ble_time_sync_status_t *status) {
+    *status          = s_status;
+    status->freqcorr = watch_rtc_freqcorr_read();
+    status->samples  = s_count;
+    status->span_s   = s_count ? s_samples[s_count - 1].time - s_samples[0].time : 0;
+}
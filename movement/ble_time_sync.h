@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ */
+#ifndef BLE_TIME_SYNC_H_
+#define BLE_TIME_SYNC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Background time sync over BLE, with drift correction.
+ *
+ * Every BLE_TIME_SYNC_INTERVAL_MINUTES the watch asks the nRF for the
+ * phone's time (CTS). Each answer gives the offset between the phone and
+ * the RTC. Offsets of a second or more are stepped out of the RTC a whole
+ * number of seconds at a time, which leaves its sub-second phase alone,
+ * so adding the steps back gives the error of the free-running clock.
+ * A least-squares line through those errors, over at least
+ * BLE_TIME_SYNC_MIN_SPAN_HOURS, is the drift rate, which is trimmed out
+ * with the RTC's frequency correction (steps of 1/2^20, ~0.95 ppm).
+ *
+ * The nRF's answer is the local time as a watch_date_time (LE32), the
+ * UTC offset in minutes (LE16) and, optionally, CTS Fractions256.
+ *
+ * This continuously does the job of the finetune and nanosec faces;
+ * don't use them at the same time, as each overwrites the other's
+ * frequency correction.
+ */
+
+/* Minutes between background syncs; 0 turns them off */
+#ifndef BLE_TIME_SYNC_INTERVAL_MINUTES
+#define BLE_TIME_SYNC_INTERVAL_MINUTES 360
+#endif
+
+/* Minutes to wait before trying again after a sync fails */
+#ifndef BLE_TIME_SYNC_RETRY_MINUTES
+#define BLE_TIME_SYNC_RETRY_MINUTES    30
+#endif
+
+/* Shortest span of syncs to estimate drift from */
+#ifndef BLE_TIME_SYNC_MIN_SPAN_HOURS
+#define BLE_TIME_SYNC_MIN_SPAN_HOURS   48
+#endif
+
+/* Syncs kept for the drift fit */
+#ifndef BLE_TIME_SYNC_SAMPLES
+#define BLE_TIME_SYNC_SAMPLES          12
+#endif
+
+/* Offsets larger than this are treated as the time being set, not drift */
+#ifndef BLE_TIME_SYNC_MAX_DRIFT_S
+#define BLE_TIME_SYNC_MAX_DRIFT_S      60
+#endif
+
+/* CTS discovery and read can take a few seconds */
+#ifndef BLE_TIME_SYNC_TIMEOUT_MS
+#define BLE_TIME_SYNC_TIMEOUT_MS       3000
+#endif
+
+typedef struct {
+    uint32_t syncs;          /* answers received */
+    uint32_t failures;       /* requests that timed out or got a short answer */
+    int32_t  last_offset_ms; /* phone minus watch at the last sync */
+    int32_t  drift_ppb;      /* last fitted drift; positive means the watch ran slow */
+    int16_t  freqcorr;       /* the RTC's frequency correction; positive slows it */
+    uint8_t  samples;        /* syncs in the current fit */
+    uint32_t span_s;         /* time they cover */
+} ble_time_sync_status_t;
+
+/**
+ * Called from the main loop when a sync ends.
+ * @param ok        Whether the phone's time was received and applied
+ * @param offset_ms Phone minus watch, before the RTC was corrected
+ * @param context   The pointer passed to ble_time_sync_now
+ */
+typedef void (*ble_time_sync_cb_t)(bool ok, int32_t offset_ms, void *context);
+
+/**
+ * Sync now, in the background.
+ * @return false if a sync is already running or the request table is full
+ */
+bool ble_time_sync_now(ble_time_sync_cb_t callback, void *context);
+
+/**
+ * Counts minutes to the next background sync. Call once a minute from the main loop.
+ * @param can_sync Whether a sync that is due may start now; if not, it waits for a later call
+ */
+void ble_time_sync_background_task(bool can_sync);
+
+/** Forget the syncs collected so far; the frequency correction stays. */
+void ble_time_sync_reset(void);
+
+void ble_time_sync_get_status(ble_time_sync_status_t *status);
+
+#endif /* BLE_TIME_SYNC_H_ */
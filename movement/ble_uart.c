@@ -4,8 +4,9 @@
  */
 
 #include "ble_uart.h"
-#include "watch_uart.h"   /* watch_enable_uart(); pulls in watch.h → driver_init.h → SERCOM defs */
-#include "hal_io.h"       /* io_write() / io_descriptor */
+#include "watch_uart.h"   /* interrupt-driven RX/TX rings */
+#include "watch_extint.h"
+#include "watch_utility.h"
 
 /* ---- Pin / baud configuration ---- */
 #ifndef BLE_UART_TX_PIN
@@ -14,128 +15,285 @@
 #ifndef BLE_UART_RX_PIN
 #define BLE_UART_RX_PIN  A1   /* BLE→watch: PB01 ↔ nRF P0.18 (nRF TX) */
 #endif
-#define BLE_UART_BAUD    9600
 
-/* TX uses the same ASF4 io path as watch_uart_puts(), but binary-safe (no strlen). */
-extern struct io_descriptor *uart_io;
+#if (BLE_UART_RX_QUEUE_LEN & (BLE_UART_RX_QUEUE_LEN - 1)) != 0
+#error "BLE_UART_RX_QUEUE_LEN must be a power of two"
+#endif
+
+
+/* ---- TLV receive state machine (runs in the SERCOM3 interrupt) ---- */
+
+typedef enum { TLV_TYPE, TLV_LENGTH, TLV_VALUE, TLV_CRC_LO, TLV_CRC_HI } tlv_state_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    uint8_t data[BLE_TLV_MAX_LEN];
+} ble_frame_t;
+
+static tlv_state_t  s_state;
+static ble_frame_t  s_rx;         /* frame being parsed */
+static uint8_t      s_idx;
+static uint16_t     s_crc;
+
+/* Complete frames. The ISR only advances s_queue_head and the task only
+ * advances s_queue_tail; both count up and wrap, so head - tail is the
+ * number of frames waiting. */
+static ble_frame_t       s_queue[BLE_UART_RX_QUEUE_LEN];
+static volatile uint8_t  s_queue_head;
+static volatile uint8_t  s_queue_tail;
 
-/* Non-blocking: true when a received byte is waiting in the shift register. */
-static bool rx_ready(void) {
-    return !!(SERCOM3->USART.INTFLAG.reg & SERCOM_USART_INTFLAG_RXC);
+static volatile ble_uart_stats_t s_stats;
+
+static bool         s_crc_enabled = BLE_UART_TLV_CRC;
+static uint32_t     s_baud        = BLE_UART_BAUD;
+
+typedef enum { BLE_UART_OFF, BLE_UART_PARKED, BLE_UART_AWAKE } ble_uart_power_t;
+
+/* Also changed by the RX edge interrupt, from PARKED to AWAKE; see prv_rx_edge */
+static volatile ble_uart_power_t s_power;
+static volatile uint8_t  s_idle_ticks;      /* fast ticks since the last byte in or out */
+
+static void prv_frame_complete(void) {
+    s_state = TLV_TYPE;
+    if ((uint8_t)(s_queue_head - s_queue_tail) >= BLE_UART_RX_QUEUE_LEN) {
+        s_stats.overruns++;
+        return;
+    }
+    ble_frame_t *slot = &s_queue[s_queue_head & (BLE_UART_RX_QUEUE_LEN - 1)];
+    slot->type = s_rx.type;
+    slot->len  = s_rx.len;
+    for (uint8_t i = 0; i < s_rx.len; i++) slot->data[i] = s_rx.data[i];
+    s_queue_head++;
+    s_stats.frames++;
 }
 
-/* Read one byte — only call when rx_ready() is true. */
-static uint8_t rx_byte(void) {
-    return (uint8_t)SERCOM3->USART.DATA.reg;
+static void prv_rx_byte(uint8_t byte) {
+    s_idle_ticks = 0;
+    switch (s_state) {
+    case TLV_TYPE:
+        if (byte == BLE_UART_WAKE_BYTE) return;
+        s_rx.type = byte;
+        s_state   = TLV_LENGTH;
+        return;
+
+    case TLV_LENGTH:
+        if (byte > BLE_TLV_MAX_LEN) {
+            s_stats.length_errors++;
+            s_state = TLV_TYPE;  /* invalid length — reset */
+            return;
+        }
+        s_rx.len = byte;
+        s_idx    = 0;
+        s_state  = TLV_VALUE;
+        break;  /* a zero-length value is already complete */
+
+    case TLV_VALUE:
+        s_rx.data[s_idx++] = byte;
+        break;
+
+    case TLV_CRC_LO:
+        s_crc  ^= byte;
+        s_state = TLV_CRC_HI;
+        return;
+
+    case TLV_CRC_HI:
+        s_crc ^= (uint16_t)byte << 8;
+        if (s_crc != 0) {
+            s_stats.crc_errors++;
+            s_state = TLV_TYPE;
+            return;
+        }
+        prv_frame_complete();
+        return;
+    }
+
+    if (s_idx < s_rx.len) return;
+
+    /* all value bytes received */
+    if (!s_crc_enabled) {
+        prv_frame_complete();
+        return;
+    }
+    uint8_t header[2] = { s_rx.type, s_rx.len };
+    s_crc   = watch_utility_crc16(header, 2, 0xFFFF);
+    s_crc   = watch_utility_crc16(s_rx.data, s_rx.len, s_crc);
+    s_state = TLV_CRC_LO;
 }
 
-/* ---- TLV receive state machine ---- */
+/* ---- Power ---- */
 
-typedef enum { TLV_TYPE, TLV_LENGTH, TLV_VALUE } tlv_state_t;
+static void prv_wake(bool by_rx);
 
-static tlv_state_t  s_state;
-static uint8_t      s_type;
-static volatile uint8_t      s_length;
-static volatile uint8_t      s_value[BLE_TLV_MAX_LEN];
-static volatile uint8_t      s_idx;
+/* The nRF sends its frame BLE_UART_WAKE_GUARD_US after the wake byte's edge, which is sooner than
+ * the main loop may get round to it, so the UART is brought up here. Taking the pin for SERCOM3
+ * ends the edge interrupts; frames are then left to the main loop. */
+static void prv_rx_edge(void) {
+    if (s_power == BLE_UART_PARKED) prv_wake(true);
+}
 
-/* Double-buffer: ISR fills s_*, task reads s_pending_* */
-static bool         s_frame_ready;
-static uint8_t      s_pending_type;
-static volatile uint8_t      s_pending_data[BLE_TLV_MAX_LEN];
-static volatile uint8_t      s_pending_len;
+static void prv_arm_wake(bool armed) {
+    /* The pin goes back to the EIC here, and to SERCOM3 when the UART is enabled */
+    watch_register_interrupt_callback(BLE_UART_RX_PIN, armed ? prv_rx_edge : NULL,
+                                      armed ? INTERRUPT_TRIGGER_FALLING : INTERRUPT_TRIGGER_NONE);
+}
 
-static bool         s_uart_enabled;
+static void prv_enable_uart(void) {
+    watch_enable_uart(BLE_UART_TX_PIN, BLE_UART_RX_PIN, s_baud);
+    /* Parse in the interrupt, so frames complete even while the main loop is busy */
+    s_state      = TLV_TYPE;
+    s_idle_ticks = 0;
+    watch_uart_set_rx_callback(prv_rx_byte);
+}
+
+static void prv_disable_uart(void) {
+    /* Drains the TX ring, gates off SERCOM3 and returns the pins to high-impedance inputs */
+    s_stats.uart_dropped += watch_uart_rx_dropped();
+    watch_disable_uart();
+    /* Frames already queued stay there; a half-received one is abandoned */
+    s_state = TLV_TYPE;
+}
+
+static void prv_wake(bool by_rx) {
+    uint32_t start = watch_get_cycle_count();
+    prv_arm_wake(false);
+    prv_enable_uart();
+    s_power = BLE_UART_AWAKE;
+    s_stats.wakes++;
+    if (by_rx) s_stats.rx_wakes++;
+    s_stats.wake_cycles = (watch_get_cycle_count() - start) & 0xFFFFFF;
+}
 
 /* ---- Public API ---- */
 
+/*
+ * While parked, the edge interrupt may wake the UART at any moment. So
+ * s_power is PARKED before the edge is armed, and the edge is disarmed
+ * before the main loop looks at s_power to wake or turn off the UART.
+ */
+
 void ble_uart_init(void) {
-    if (s_uart_enabled) return;
-    watch_enable_uart(BLE_UART_TX_PIN, BLE_UART_RX_PIN, BLE_UART_BAUD);
-    s_state        = TLV_TYPE;
-    s_frame_ready  = false;
-    s_uart_enabled = true;
+    if (s_power == BLE_UART_AWAKE) return;
+    /* (Re-)arm even if already parked, since re-initialising the EIC forgets the callback */
+    s_power = BLE_UART_PARKED;
+    prv_arm_wake(true);
 }
 
 void ble_uart_deinit(void) {
-    if (!s_uart_enabled) return;
+    prv_arm_wake(false);
+    if (s_power == BLE_UART_AWAKE) prv_disable_uart();
+    s_power = BLE_UART_OFF;
+}
 
-    /* Wait for any in-progress transmission to complete */
-    while (!(SERCOM3->USART.INTFLAG.reg & SERCOM_USART_INTFLAG_TXC));
+void ble_uart_wake(void) {
+    if (s_power != BLE_UART_PARKED) return;
+    prv_arm_wake(false);
+    /* ...unless the edge got there first */
+    if (s_power == BLE_UART_PARKED) prv_wake(false);
+}
 
-    /* Disable the SERCOM3 peripheral and wait for sync */
-    SERCOM3->USART.CTRLA.reg &= ~SERCOM_USART_CTRLA_ENABLE;
-    while (SERCOM3->USART.SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_ENABLE);
+void ble_uart_park(void) {
+    if (s_power != BLE_UART_AWAKE) return;
+    uint32_t start = watch_get_cycle_count();
+    prv_disable_uart();
+    s_power = BLE_UART_PARKED;
+    prv_arm_wake(true);
+    s_stats.park_cycles = (watch_get_cycle_count() - start) & 0xFFFFFF;
+}
 
-    /* Gate off the SERCOM3 bus clock */
-    MCLK->APBCMASK.reg &= ~MCLK_APBCMASK_SERCOM3;
+bool ble_uart_park_if_idle(void) {
+    if (s_power == BLE_UART_AWAKE && s_idle_ticks >= BLE_UART_IDLE_TICKS) ble_uart_park();
+    return s_power != BLE_UART_AWAKE;
+}
 
-    /* Return pins to high-impedance inputs to prevent current leakage */
-    gpio_set_pin_function(BLE_UART_TX_PIN, GPIO_PIN_FUNCTION_OFF);
-    gpio_set_pin_function(BLE_UART_RX_PIN, GPIO_PIN_FUNCTION_OFF);
+bool ble_uart_is_awake(void) {
+    return s_power == BLE_UART_AWAKE;
+}
 
-    s_uart_enabled = false;
-    s_state        = TLV_TYPE;
-    s_frame_ready  = false;
+void ble_uart_fast_tick(void) {
+    if (s_idle_ticks < 255) s_idle_ticks++;
 }
 
 void ble_uart_send(uint8_t type, const uint8_t *data, uint8_t len) {
-    if (!s_uart_enabled) return;
-    uint8_t frame[2 + BLE_TLV_MAX_LEN];
+    ble_uart_wake();
+    if (s_power != BLE_UART_AWAKE) return;
+    uint8_t frame[2 + BLE_TLV_MAX_LEN + 2];
+    uint8_t frame_len = 2 + len;
     frame[0] = type;
     frame[1] = len;
     for (uint8_t i = 0; i < len; i++) frame[2 + i] = data[i];
-    io_write(uart_io, frame, 2 + len);
+    if (s_crc_enabled) {
+        uint16_t crc = watch_utility_crc16(frame, frame_len, 0xFFFF);
+        frame[frame_len++] = crc & 0xFF;
+        frame[frame_len++] = crc >> 8;
+    }
+    /* A frame always fits in an empty TX ring; only wait if earlier frames are still going out */
+    uint8_t sent = 0;
+    while (sent < frame_len) sent += watch_uart_write(frame + sent, frame_len - sent);
+    s_idle_ticks = 0;
 }
 
-bool ble_uart_task(uint8_t *type_out, uint8_t *data_out, uint8_t *len_out) {
-    if (!s_uart_enabled) return false;
-    /* Drain all available bytes through the TLV state machine */
-    while (rx_ready()) {
-        uint8_t byte = rx_byte();
-
-        switch (s_state) {
-        case TLV_TYPE:
-            s_type  = byte;
-            s_state = TLV_LENGTH;
-            continue;
-
-        case TLV_LENGTH:
-            if (byte > BLE_TLV_MAX_LEN) {
-                s_state = TLV_TYPE;  /* invalid length — reset */
-                continue;
-            }
-            s_length = byte;
-            s_idx    = 0;
-            if (byte > 0) {
-                s_state = TLV_VALUE;
-                continue;
-            }
-            /* zero-length frame — fall through to dispatch */
-            break;
-
-        case TLV_VALUE:
-            s_value[s_idx++] = byte;
-            if (s_idx < s_length) continue;
-            /* all value bytes received — fall through to dispatch */
-            break;
-        }
-
-        /* Frame complete: copy to pending slot */
-        s_pending_type = s_type;
-        s_pending_len  = s_length;
-        for (uint8_t i = 0; i < s_length; i++) s_pending_data[i] = s_value[i];
-        s_frame_ready  = true;
-        s_state        = TLV_TYPE;
+void ble_uart_send_long(uint8_t type, const uint8_t *data, uint16_t len) {
+    if (len > BLE_MESSAGE_MAX_LEN) len = BLE_MESSAGE_MAX_LEN;
+    while (len > BLE_TLV_MAX_LEN) {
+        ble_uart_send(type | BLE_TLV_MORE, data, BLE_TLV_MAX_LEN);
+        data += BLE_TLV_MAX_LEN;
+        len  -= BLE_TLV_MAX_LEN;
     }
+    ble_uart_send(type, data, len);
+}
+
+uint8_t ble_uart_tx_room(void) {
+    size_t  free     = watch_uart_tx_free();
+    uint8_t overhead = s_crc_enabled ? 4 : 2;
+    size_t  frames   = free / (BLE_TLV_MAX_LEN + overhead);
+    size_t  rest     = free - frames * (BLE_TLV_MAX_LEN + overhead);
+    size_t  room     = frames * BLE_TLV_MAX_LEN + (rest > overhead ? rest - overhead : 0);
+    return room > BLE_MESSAGE_MAX_LEN ? BLE_MESSAGE_MAX_LEN : room;
+}
+
+void ble_uart_set_baud(uint32_t baud) {
+    s_baud = baud;
+    if (s_power != BLE_UART_AWAKE) return;
+    /* Re-enabling the SERCOM is the only way to change its rate; disabling waits for the TX ring to drain */
+    prv_disable_uart();
+    prv_enable_uart();
+}
+
+uint32_t ble_uart_get_baud(void) {
+    return s_baud;
+}
 
-    if (!s_frame_ready) return false;
+bool ble_uart_task(uint8_t *type_out, uint8_t *data_out, uint8_t *len_out) {
+    if (s_queue_head == s_queue_tail) return false;
 
-    s_frame_ready = false;
-    if (type_out) *type_out = s_pending_type;
-    if (len_out)  *len_out  = s_pending_len;
+    const ble_frame_t *frame = &s_queue[s_queue_tail & (BLE_UART_RX_QUEUE_LEN - 1)];
+    if (type_out) *type_out = frame->type;
+    if (len_out)  *len_out  = frame->len;
     if (data_out) {
-        for (uint8_t i = 0; i < s_pending_len; i++) data_out[i] = s_pending_data[i];
+        for (uint8_t i = 0; i < frame->len; i++) data_out[i] = frame->data[i];
     }
+    /* Hand the slot back to the ISR only after it has been copied out */
+    s_queue_tail++;
     return true;
 }
+
+uint8_t ble_uart_frames_pending(void) {
+    return s_queue_head - s_queue_tail;
+}
+
+void ble_uart_set_crc(bool enabled) {
+    s_crc_enabled = enabled;
+}
+
+void ble_uart_get_stats(ble_uart_stats_t *stats) {
+    stats->frames        = s_stats.frames;
+    stats->overruns      = s_stats.overruns;
+    stats->crc_errors    = s_stats.crc_errors;
+    stats->length_errors = s_stats.length_errors;
+    stats->uart_dropped  = s_stats.uart_dropped + (s_power == BLE_UART_AWAKE ? watch_uart_rx_dropped() : 0);
+    stats->wakes         = s_stats.wakes;
+    stats->rx_wakes      = s_stats.rx_wakes;
+    stats->wake_cycles   = s_stats.wake_cycles;
+    stats->park_cycles   = s_stats.park_cycles;
+}
@@ -10,21 +10,118 @@
 
 /* TLV command types — must match nRF52805 BLE firmware */
 #define BLE_CMD_SEND_KEY    0x01  /* value: [keycode, modifier]  */
-#define BLE_CMD_SEND_STRING 0x02  /* value: ASCII bytes          */
+#define BLE_CMD_SEND_STRING 0x02  /* value: ASCII bytes — the nRF must answer
+                                   * once they're typed, with [number taken]
+                                   * or an empty value for all; see ble_hid.h */
 #define BLE_CMD_CLEAR_BONDS 0x03  /* value: (none)               */
 #define BLE_CMD_BLE_CTRL    0x04  /* value: [0x00=off, 0x01=on]  */
 #define BLE_CMD_PING        0x05  /* value: (none) — echoes ACK  */
 #define BLE_CMD_GET_TIME    0x06  /* value: (none) — reads CTS   */
 #define BLE_CMD_ECHO        0x07  /* value: 4 bytes — echoed back for link testing */
+#define BLE_CMD_SET_BAUD    0x08  /* value: baud (LE32) — answered [0x01] at the old
+                                   * rate, then both ends switch; [0x00] if refused.
+                                   * The nRF goes back to the old rate if it gets no
+                                   * valid frame at the new one within 1 s. */
+#define BLE_CMD_NOTIFY      0x09  /* from the nRF: [app id, text (≤32 chars)] —
+                                   * a phone notification; not answered */
+#define BLE_CMD_EXPORT      0x0A  /* value: a chunk of a file being exported —
+                                   * answered with the next offset wanted; see ble_export.h */
+#define BLE_CMD_EXPORT_START 0x0B /* from the nRF: [offset LE32, file name] —
+                                   * start or resume an export */
+#define BLE_CMD_BUTTON      0x0C  /* from the nRF: button events, one per byte —
+                                   * answered [number queued]; see ble_remote.h */
+
+/* Sent by the nRF ahead of a frame when the link has been quiet: its long
+ * low level wakes the watch through the RX pin's edge interrupt, and the
+ * nRF then waits BLE_UART_WAKE_GUARD_US before the frame. The parser
+ * skips it between frames, so it's harmless if the UART was already up.
+ * The nRF must count the link as quiet after at most 100 ms without
+ * traffic either way, which is less than BLE_UART_IDLE_TICKS (125 ms), so that
+ * it never skips the wake byte once the watch may have parked. */
+#define BLE_UART_WAKE_BYTE      0x00
+#define BLE_UART_WAKE_GUARD_US  1000
+
+/* Set in the type of every fragment of a long message except the last.
+ * The fragments are sent back to back, and the receiver joins their
+ * values into one message of the type without this bit. */
+#define BLE_TLV_MORE        0x80
 
 #define BLE_TLV_MAX_LEN     16
+/* Largest message that can be sent or received as fragments */
+#define BLE_MESSAGE_MAX_LEN 255
+
+/* Rate the link starts at and returns to; ble_link_negotiate_baud raises it */
+#ifndef BLE_UART_BAUD
+#define BLE_UART_BAUD       9600
+#endif
+
+/* Complete frames held for ble_uart_task; a frame that arrives when all are full is dropped */
+#ifndef BLE_UART_RX_QUEUE_LEN
+#define BLE_UART_RX_QUEUE_LEN 4
+#endif
+
+/* Follow each frame with a CRC-16/CCITT-FALSE of its type, length and value, low byte first.
+ * Off by default to match the current nRF firmware; see ble_uart_set_crc. */
+#ifndef BLE_UART_TLV_CRC
+#define BLE_UART_TLV_CRC    0
+#endif
+
+/* Fast ticks (1/128 s) without traffic before the UART is parked again */
+#ifndef BLE_UART_IDLE_TICKS
+#define BLE_UART_IDLE_TICKS 16
+#endif
+
+/* Counters, from power-on; they carry on across ble_uart_deinit/ble_uart_init */
+typedef struct {
+    uint32_t frames;        /* complete frames received                            */
+    uint32_t overruns;      /* frames dropped because the queue was full           */
+    uint32_t crc_errors;    /* frames dropped because their CRC didn't match       */
+    uint32_t length_errors; /* frames abandoned because of an impossible length    */
+    uint32_t uart_dropped;  /* bytes the UART lost before the parser saw them      */
+    uint32_t wakes;         /* times the UART was brought up                       */
+    uint32_t rx_wakes;      /* ...of which by the nRF signalling on the RX pin     */
+    uint32_t wake_cycles;   /* CPU cycles the last bring-up took                   */
+    uint32_t park_cycles;   /* CPU cycles the last park took                       */
+} ble_uart_stats_t;
+
+/*
+ * Power: the UART is parked (SERCOM3 off, RX pin watched by the EIC for a
+ * falling edge) until there is traffic. ble_uart_send brings it up; so
+ * does the edge interrupt itself, as the nRF pulls the RX line low. It is
+ * parked again by ble_uart_park_if_idle, once it's been quiet for
+ * BLE_UART_IDLE_TICKS. SERCOM3 is clocked from the main clock, which
+ * stops in standby, so the watch must stay out of standby while the UART
+ * is up.
+ */
 
-/** Initialise the BLE UART (115200 8N1, A2=TX, A1=RX by default). */
+/**
+ * Park the UART (A2=TX, A1=RX by default, at BLE_UART_BAUD) and arm the
+ * RX edge wake. Call after external interrupts are enabled, and again
+ * whenever they have been re-initialised. Does nothing if the UART is up.
+ */
 void ble_uart_init(void);
 
-/** Disable the BLE UART to save power before entering standby. */
+/** Turn the UART and its wake off, e.g. before sleep mode. */
 void ble_uart_deinit(void);
 
+/** Bring the UART up now, if it is parked. */
+void ble_uart_wake(void);
+
+/**
+ * Park the UART if it has been quiet for BLE_UART_IDLE_TICKS.
+ * @return true if the UART is now parked or off, so standby is allowed
+ */
+bool ble_uart_park_if_idle(void);
+
+/** Park the UART now, if it is up. */
+void ble_uart_park(void);
+
+/** True while the UART is up. */
+bool ble_uart_is_awake(void);
+
+/** Advance the idle clock by one 1/128 s tick. Safe to call from an interrupt. */
+void ble_uart_fast_tick(void);
+
 /**
  * Send a TLV frame to the BLE module.
  * @param type  Command type (BLE_CMD_*)
@@ -33,11 +130,43 @@ void ble_uart_deinit(void);
  */
 void ble_uart_send(uint8_t type, const uint8_t *data, uint8_t len);
 
+/**
+ * Send a message of any length up to BLE_MESSAGE_MAX_LEN, split into
+ * BLE_TLV_MORE fragments if it doesn't fit in one frame.
+ */
+void ble_uart_send_long(uint8_t type, const uint8_t *data, uint16_t len);
+
+/**
+ * The longest message ble_uart_send_long can queue right now without
+ * waiting for the TX ring to drain.
+ */
+uint8_t ble_uart_tx_room(void);
+
+/**
+ * Change the UART's baud rate once queued output has gone out. The rate
+ * is kept while the UART is parked or off.
+ */
+void ble_uart_set_baud(uint32_t baud);
+
+/** The UART's current baud rate. */
+uint32_t ble_uart_get_baud(void);
+
 /**
  * Non-blocking RX poll — call from main loop or shell command.
- * Returns true and fills *type_out / *data_out / *len_out when a
- * complete frame has been received; returns false otherwise.
+ * Frames are parsed in the UART interrupt as their bytes arrive; this
+ * only takes the oldest complete frame off the queue. Returns true and
+ * fills *type_out / *data_out / *len_out when there was one; returns
+ * false otherwise.
  */
 bool ble_uart_task(uint8_t *type_out, uint8_t *data_out, uint8_t *len_out);
 
+/** Number of complete frames waiting for ble_uart_task. */
+uint8_t ble_uart_frames_pending(void);
+
+/** Turn the per-frame CRC on or off in both directions; both ends must agree. */
+void ble_uart_set_crc(bool enabled);
+
+/** Copy the counters into *stats. */
+void ble_uart_get_stats(ble_uart_stats_t *stats);
+
 #endif /* BLE_UART_H_ */
@@ -1,9 +1,16 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <peripheral_clk_config.h>
 #include "filesystem.h"
+#include "filesystem_config.h"
+#if FILESYSTEM_ENABLE_EXT
+#include "filesystem_ext.h"
+#endif
 #include "watch.h"
+#include "watch_utility.h"
+#include "shell.h"
 #include "lfs.h"
 #include "hpl_flash.h"
 
@@ -12,24 +19,98 @@ int lfs_storage_prog(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t
 int lfs_storage_erase(const struct lfs_config *cfg, lfs_block_t block);
 int lfs_storage_sync(const struct lfs_config *cfg);
 
+#define FILESYSTEM_BLOCK_COUNT (NVMCTRL_RWWEE_PAGES / 4 - FILESYSTEM_ASSET_ROWS)
+
+#if FILESYSTEM_ASSET_ROWS > 0
+// The asset region follows the littlefs blocks. Its first row is the index; asset data is page aligned after it.
+#define FILESYSTEM_ASSET_FIRST_ROW FILESYSTEM_BLOCK_COUNT
+#define FILESYSTEM_ASSET_MAGIC 0x54455341 // "ASET"
+#define FILESYSTEM_ASSET_MAX_COUNT ((NVMCTRL_ROW_SIZE - sizeof(filesystem_asset_header_t)) / sizeof(filesystem_asset_entry_t))
+
+typedef struct {
+    uint32_t magic;
+    uint16_t count;
+    uint16_t reserved;
+} filesystem_asset_header_t;
+
+typedef struct {
+    char name[FILESYSTEM_ASSET_NAME_LENGTH];
+    uint16_t offset;    // from the start of the asset region
+    uint16_t length;
+} filesystem_asset_entry_t;
+#endif
+
+// Per-block erase counts are persisted to this file every FILESYSTEM_STATS_FLUSH_INTERVAL erases.
+#define FILESYSTEM_STATS_FILE ".fsstat"
+#define FILESYSTEM_STATS_FLUSH_INTERVAL 16
+
+typedef struct {
+    uint32_t reads;
+    uint32_t progs;
+    uint32_t erases;
+    uint32_t syncs;
+    uint32_t bytes_read;
+    uint32_t bytes_programmed;
+    uint64_t busy_us;
+    uint32_t max_busy_us;
+    uint16_t unsaved_erases;
+    uint32_t erase_counts[FILESYSTEM_BLOCK_COUNT];
+} filesystem_stats_t;
+
+static filesystem_stats_t stats;
+
+// Number of blocks in use as of the last lfs_fs_traverse, or -1 if anything has been programmed or erased since.
+static int32_t cached_used_blocks = -1;
+
+static void _filesystem_stats_record_busy(uint32_t start) {
+    uint32_t cycles = (watch_get_cycle_count() - start) & 0xFFFFFF;
+    uint32_t us = cycles / (watch_get_cpu_frequency() / 1000000);
+    stats.busy_us += us;
+    if (us > stats.max_busy_us) stats.max_busy_us = us;
+}
+
 int lfs_storage_read(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
     (void) cfg;
-    return !watch_storage_read(block, off, (void *)buffer, size);
+    uint32_t start = watch_get_cycle_count();
+    int retval = !watch_storage_read(block, off, (void *)buffer, size);
+    _filesystem_stats_record_busy(start);
+    stats.reads++;
+    stats.bytes_read += size;
+    return retval;
 }
 
 int lfs_storage_prog(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
     (void) cfg;
-    return !watch_storage_write(block, off, (void *)buffer, size);
+    uint32_t start = watch_get_cycle_count();
+    int retval = !watch_storage_write(block, off, (void *)buffer, size);
+    _filesystem_stats_record_busy(start);
+    cached_used_blocks = -1;
+    stats.progs++;
+    stats.bytes_programmed += size;
+    return retval;
 }
 
 int lfs_storage_erase(const struct lfs_config *cfg, lfs_block_t block) {
     (void) cfg;
-    return !watch_storage_erase(block);
+    uint32_t start = watch_get_cycle_count();
+    int retval = !watch_storage_erase(block);
+    _filesystem_stats_record_busy(start);
+    cached_used_blocks = -1;
+    stats.erases++;
+    if (block < FILESYSTEM_BLOCK_COUNT) {
+        stats.erase_counts[block]++;
+        stats.unsaved_erases++;
+    }
+    return retval;
 }
 
 int lfs_storage_sync(const struct lfs_config *cfg) {
     (void) cfg;
-    return !watch_storage_sync();
+    uint32_t start = watch_get_cycle_count();
+    int retval = !watch_storage_sync();
+    _filesystem_stats_record_busy(start);
+    stats.syncs++;
+    return retval;
 }
 
 const struct lfs_config cfg = {
@@ -40,19 +121,77 @@ const struct lfs_config cfg = {
     .sync  = lfs_storage_sync,
 
     // block device configuration
-    .read_size = 16,
+    .read_size = FILESYSTEM_READ_SIZE,
     .prog_size = NVMCTRL_PAGE_SIZE,
     .block_size = NVMCTRL_ROW_SIZE,
-    .block_count = NVMCTRL_RWWEE_PAGES / 4,
-    .cache_size = NVMCTRL_PAGE_SIZE,
-    .lookahead_size = 16,
-    .block_cycles = 100,
+    .block_count = FILESYSTEM_BLOCK_COUNT,
+    .cache_size = FILESYSTEM_CACHE_SIZE,
+    .lookahead_size = FILESYSTEM_LOOKAHEAD_SIZE,
+    .block_cycles = FILESYSTEM_BLOCK_CYCLES,
 };
 
 static lfs_t lfs;
 static lfs_file_t file;
 static struct lfs_info info;
 
+#if FILESYSTEM_ENABLE_EXT
+static lfs_t ext_lfs;
+static bool ext_mounted = false;
+
+static bool _filesystem_ext_mount(void) {
+    if (ext_mounted) return true;
+    if (!filesystem_ext_probe()) return false;
+    int err = lfs_mount(&ext_lfs, &filesystem_ext_cfg);
+    if (err < 0) {
+        printf("Formatting " FILESYSTEM_EXT_PREFIX "...\r\n");
+        err = lfs_format(&ext_lfs, &filesystem_ext_cfg);
+        if (err < 0) return false;
+        err = lfs_mount(&ext_lfs, &filesystem_ext_cfg);
+    }
+    ext_mounted = err == LFS_ERR_OK;
+    return ext_mounted;
+}
+#endif
+
+// Returns the volume a path lives on, and strips the volume prefix from the path.
+// Returns NULL if the path is on a volume that isn't available.
+static lfs_t *_filesystem_volume(char **path) {
+#if FILESYSTEM_ENABLE_EXT
+    size_t prefix_length = strlen(FILESYSTEM_EXT_PREFIX);
+    if (strncmp(*path, FILESYSTEM_EXT_PREFIX, prefix_length) == 0 && ((*path)[prefix_length] == '/' || (*path)[prefix_length] == '\0')) {
+        if (!_filesystem_ext_mount()) return NULL;
+        *path += prefix_length;
+        if (**path == '\0') *path = (char *)"/";
+        return &ext_lfs;
+    }
+#endif
+    return &lfs;
+}
+
+static void _filesystem_stats_load(void) {
+    uint32_t saved_counts[FILESYSTEM_BLOCK_COUNT];
+    if (lfs_stat(&lfs, FILESYSTEM_STATS_FILE, &info) < 0 || info.size != sizeof(saved_counts)) return;
+    if (lfs_file_open(&lfs, &file, FILESYSTEM_STATS_FILE, LFS_O_RDONLY) < 0) return;
+    if (lfs_file_read(&lfs, &file, saved_counts, sizeof(saved_counts)) == sizeof(saved_counts)) {
+        // anything erased since boot (i.e. while mounting) is added on top of the persisted counts.
+        for (uint8_t i = 0; i < FILESYSTEM_BLOCK_COUNT; i++) stats.erase_counts[i] += saved_counts[i];
+    }
+    lfs_file_close(&lfs, &file);
+}
+
+static void _filesystem_stats_save(void) {
+    // the write below erases blocks of its own; those are picked up by the next flush.
+    stats.unsaved_erases = 0;
+    int err = lfs_file_open(&lfs, &file, FILESYSTEM_STATS_FILE, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    if (err < 0) return;
+    lfs_file_write(&lfs, &file, stats.erase_counts, sizeof(stats.erase_counts));
+    lfs_file_close(&lfs, &file);
+}
+
+static void _filesystem_stats_flush_if_needed(void) {
+    if (stats.unsaved_erases >= FILESYSTEM_STATS_FLUSH_INTERVAL) _filesystem_stats_save();
+}
+
 static int _traverse_df_cb(void *p, lfs_block_t block) {
     (void) block;
 	uint32_t *nb = p;
@@ -63,17 +202,45 @@ static int _traverse_df_cb(void *p, lfs_block_t block) {
 int32_t filesystem_get_free_space(void) {
 	int err;
 
-	uint32_t free_blocks = 0;
-	err = lfs_fs_traverse(&lfs, _traverse_df_cb, &free_blocks);
-	if(err < 0){
-		return err;
+	if (cached_used_blocks < 0) {
+		uint32_t used_blocks = 0;
+		err = lfs_fs_traverse(&lfs, _traverse_df_cb, &used_blocks);
+		if(err < 0){
+			return err;
+		}
+		cached_used_blocks = used_blocks;
 	}
 
-	uint32_t available = cfg.block_count * cfg.block_size - free_blocks * cfg.block_size;
+	uint32_t available = cfg.block_count * cfg.block_size - cached_used_blocks * cfg.block_size;
 
 	return (int32_t)available;
 }
 
+int32_t filesystem_get_volume_free_space(char *path) {
+    lfs_t *volume = _filesystem_volume(&path);
+    if (volume == NULL) return LFS_ERR_IO;
+    if (volume == &lfs) return filesystem_get_free_space();
+
+#if FILESYSTEM_ENABLE_EXT
+    // the external volume is large and rarely queried, so it isn't worth caching.
+    uint32_t used_blocks = 0;
+    int err = lfs_fs_traverse(volume, _traverse_df_cb, &used_blocks);
+    if (err < 0) return err;
+    return (int32_t)((filesystem_ext_cfg.block_count - used_blocks) * filesystem_ext_cfg.block_size);
+#else
+    return LFS_ERR_IO;
+#endif
+}
+
+int32_t filesystem_get_volume_size(char *path) {
+    lfs_t *volume = _filesystem_volume(&path);
+    if (volume == NULL) return LFS_ERR_IO;
+#if FILESYSTEM_ENABLE_EXT
+    if (volume == &ext_lfs) return (int32_t)(filesystem_ext_cfg.block_count * filesystem_ext_cfg.block_size);
+#endif
+    return (int32_t)(cfg.block_count * cfg.block_size);
+}
+
 static int filesystem_ls(lfs_t *lfs, const char *path) {
     lfs_dir_t dir;
     int err = lfs_dir_open(lfs, &dir, path);
@@ -124,11 +291,14 @@ bool filesystem_init(void) {
         printf("Filesystem mounted with %ld bytes free.\r\n", filesystem_get_free_space());
     }
 
+    if (err == LFS_ERR_OK) _filesystem_stats_load();
+
     return err == LFS_ERR_OK;
 }
 
 int _filesystem_format(void);
 int _filesystem_format(void) {
+    cached_used_blocks = -1;
     int err = lfs_unmount(&lfs);
     if (err < 0) {
         printf("Couldn't unmount - continuing to format, but you should reboot afterwards!\r\n");
@@ -139,27 +309,39 @@ int _filesystem_format(void) {
 
     err = lfs_mount(&lfs, &cfg);
     if (err < 0) return err;
+    // formatting wiped the erase counts on disk, but we still have them in RAM.
+    _filesystem_stats_save();
     printf("Filesystem re-mounted with %ld bytes free.\r\n", filesystem_get_free_space());
     return 0;
 }
 
 bool filesystem_file_exists(char *filename) {
+    lfs_t *volume = _filesystem_volume(&filename);
     info.type = 0;
-    lfs_stat(&lfs, filename, &info);
+    if (volume != NULL) lfs_stat(volume, filename, &info);
     return info.type == LFS_TYPE_REG;
 }
 
 bool filesystem_rm(char *filename) {
-    info.type = 0;
-    lfs_stat(&lfs, filename, &info);
     if (filesystem_file_exists(filename)) {
-        return lfs_remove(&lfs, filename) == LFS_ERR_OK;
+        lfs_t *volume = _filesystem_volume(&filename);
+        bool success = lfs_remove(volume, filename) == LFS_ERR_OK;
+        _filesystem_stats_flush_if_needed();
+        return success;
     } else {
         printf("rm: %s: No such file\r\n", filename);
         return false;
     }
 }
 
+bool filesystem_rename(char *old_name, char *new_name) {
+    lfs_t *volume = _filesystem_volume(&old_name);
+    if (volume == NULL || volume != _filesystem_volume(&new_name)) return false;
+    bool success = lfs_rename(volume, old_name, new_name) == LFS_ERR_OK;
+    _filesystem_stats_flush_if_needed();
+    return success;
+}
+
 int32_t filesystem_get_file_size(char *filename) {
     if (filesystem_file_exists(filename)) {
         return info.size; // info struct was just populated by filesystem_file_exists
@@ -172,11 +354,12 @@ bool filesystem_read_file(char *filename, char *buf, int32_t length) {
     memset(buf, 0, length);
     int32_t file_size = filesystem_get_file_size(filename);
     if (file_size > 0) {
-        int err = lfs_file_open(&lfs, &file, filename, LFS_O_RDONLY);
+        lfs_t *volume = _filesystem_volume(&filename);
+        int err = lfs_file_open(volume, &file, filename, LFS_O_RDONLY);
         if (err < 0) return false;
-        err = lfs_file_read(&lfs, &file, buf, min(length, file_size));
+        err = lfs_file_read(volume, &file, buf, min(length, file_size));
         if (err < 0) return false;
-        return lfs_file_close(&lfs, &file) == LFS_ERR_OK;
+        return lfs_file_close(volume, &file) == LFS_ERR_OK;
     }
 
     return false;
@@ -186,11 +369,12 @@ bool filesystem_read_line(char *filename, char *buf, int32_t *offset, int32_t le
     memset(buf, 0, length + 1);
     int32_t file_size = filesystem_get_file_size(filename);
     if (file_size > 0) {
-        int err = lfs_file_open(&lfs, &file, filename, LFS_O_RDONLY);
+        lfs_t *volume = _filesystem_volume(&filename);
+        int err = lfs_file_open(volume, &file, filename, LFS_O_RDONLY);
         if (err < 0) return false;
-        err = lfs_file_seek(&lfs, &file, *offset, LFS_SEEK_SET);
+        err = lfs_file_seek(volume, &file, *offset, LFS_SEEK_SET);
         if (err < 0) return false;
-        err = lfs_file_read(&lfs, &file, buf, min(length - 1, file_size - *offset));
+        err = lfs_file_read(volume, &file, buf, min(length - 1, file_size - *offset));
         if (err < 0) return false;
         for(int i = 0; i < length; i++) {
             (*offset)++;
@@ -199,15 +383,25 @@ bool filesystem_read_line(char *filename, char *buf, int32_t *offset, int32_t le
                 break;
             }
         }
-        return lfs_file_close(&lfs, &file) == LFS_ERR_OK;
+        return lfs_file_close(volume, &file) == LFS_ERR_OK;
     }
 
     return false;
 }
 
+int32_t filesystem_read_file_at(char *filename, int32_t offset, char *buf, int32_t length) {
+    lfs_t *volume = _filesystem_volume(&filename);
+    if (volume == NULL) return -1;
+    int err = lfs_file_open(volume, &file, filename, LFS_O_RDONLY);
+    if (err < 0) return -1;
+    int32_t result = lfs_file_seek(volume, &file, offset, LFS_SEEK_SET);
+    if (result >= 0) result = lfs_file_read(volume, &file, buf, length);
+    err = lfs_file_close(volume, &file);
+    if (result < 0 || err < 0) return -1;
+    return result;
+}
+
 static void filesystem_cat(char *filename) {
-    info.type = 0;
-    lfs_stat(&lfs, filename, &info);
     if (filesystem_file_exists(filename)) {
         if (info.size > 0) {
             char *buf = malloc(info.size + 1);
@@ -224,27 +418,41 @@ static void filesystem_cat(char *filename) {
 }
 
 bool filesystem_write_file(char *filename, char *text, int32_t length) {
-    int err = lfs_file_open(&lfs, &file, filename, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    lfs_t *volume = _filesystem_volume(&filename);
+    if (volume == NULL) return false;
+    int err = lfs_file_open(volume, &file, filename, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
     if (err < 0) return false;
-    err = lfs_file_write(&lfs, &file, text, length);
+    err = lfs_file_write(volume, &file, text, length);
     if (err < 0) return false;
-    return lfs_file_close(&lfs, &file) == LFS_ERR_OK;
+    bool success = lfs_file_close(volume, &file) == LFS_ERR_OK;
+    _filesystem_stats_flush_if_needed();
+    return success;
 }
 
 bool filesystem_append_file(char *filename, char *text, int32_t length) {
-    int err = lfs_file_open(&lfs, &file, filename, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+    lfs_t *volume = _filesystem_volume(&filename);
+    if (volume == NULL) return false;
+    int err = lfs_file_open(volume, &file, filename, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
     if (err < 0) return false;
-    err = lfs_file_write(&lfs, &file, text, length);
+    err = lfs_file_write(volume, &file, text, length);
     if (err < 0) return false;
-    return lfs_file_close(&lfs, &file) == LFS_ERR_OK;
+    bool success = lfs_file_close(volume, &file) == LFS_ERR_OK;
+    _filesystem_stats_flush_if_needed();
+    return success;
 }
 
 int filesystem_cmd_ls(int argc, char *argv[]) {
-    if (argc >= 2) {
-        filesystem_ls(&lfs, argv[1]);
-    } else {
-        filesystem_ls(&lfs, "/");
+    char *path = argc >= 2 ? argv[1] : "/";
+    lfs_t *volume = _filesystem_volume(&path);
+    if (volume == NULL) {
+        printf("ls: %s: Volume not available\r\n", argv[1]);
+        return 1;
     }
+    filesystem_ls(volume, path);
+#if FILESYSTEM_ENABLE_EXT
+    // the external volume is mounted at the root of the internal one.
+    if (volume == &lfs && strcmp(path, "/") == 0) printf("dir  %4d bytes %s\r\n", 0, FILESYSTEM_EXT_PREFIX + 1);
+#endif
     return 0;
 }
 
@@ -255,9 +463,13 @@ int filesystem_cmd_cat(int argc, char *argv[]) {
 }
 
 int filesystem_cmd_df(int argc, char *argv[]) {
-    (void) argc;
-    (void) argv;
-    printf("free space: %ld bytes\r\n", filesystem_get_free_space());
+    char *path = argc >= 2 ? argv[1] : "/";
+    int32_t free_space = filesystem_get_volume_free_space(path);
+    if (free_space < 0) {
+        printf("df: %s: Volume not available\r\n", path);
+        return 1;
+    }
+    printf("free space: %" PRId32 " bytes\r\n", free_space);
     return 0;
 }
 
@@ -267,12 +479,33 @@ int filesystem_cmd_rm(int argc, char *argv[]) {
     return 0;
 }
 
+#if FILESYSTEM_ENABLE_EXT
+static int _filesystem_ext_format(void) {
+    if (ext_mounted) lfs_unmount(&ext_lfs);
+    ext_mounted = false;
+    if (!filesystem_ext_probe()) return LFS_ERR_IO;
+
+    int err = lfs_format(&ext_lfs, &filesystem_ext_cfg);
+    if (err < 0) return err;
+
+    err = lfs_mount(&ext_lfs, &filesystem_ext_cfg);
+    if (err < 0) return err;
+    ext_mounted = true;
+    printf("%s re-mounted with %" PRId32 " bytes free.\r\n", FILESYSTEM_EXT_PREFIX, filesystem_get_volume_free_space(FILESYSTEM_EXT_PREFIX));
+    return 0;
+}
+#endif
+
 int filesystem_cmd_format(int argc, char *argv[]) {
-    (void) argc;
-    if(strcmp(argv[1], "YES") == 0) {
+    if (argc == 2 && strcmp(argv[1], "YES") == 0) {
         return _filesystem_format();
     }
-    printf("usage: format YES\r\n");
+#if FILESYSTEM_ENABLE_EXT
+    if (argc == 3 && strcmp(argv[1], FILESYSTEM_EXT_PREFIX) == 0 && strcmp(argv[2], "YES") == 0) {
+        return _filesystem_ext_format();
+    }
+#endif
+    printf("usage: format [/ext] YES\r\n");
     return 1;
 }
 
@@ -288,7 +521,19 @@ int filesystem_cmd_echo(int argc, char *argv[]) {
         line[line_len] = '\0';
     }
 
-    if (strchr(argv[3], '/')) {
+    char *path = argv[3];
+    lfs_t *volume = _filesystem_volume(&path);
+    if (volume == NULL) {
+        printf("echo: %s: Volume not available\r\n", argv[3]);
+        return 1;
+    }
+    // skip the separator between an external volume's prefix and the file name.
+    if (volume != &lfs) path++;
+    if (*path == '\0') {
+        printf("echo: %s: Is a volume, not a file\r\n", argv[3]);
+        return 1;
+    }
+    if (strchr(path, '/')) {
         printf("subdirectories are not supported\r\n");
         return -2;
     }
@@ -305,3 +550,352 @@ int filesystem_cmd_echo(int argc, char *argv[]) {
 
     return 0;
 }
+
+// put writes into this file and renames it over the destination once the checksum matches,
+// so an interrupted or corrupted upload never replaces a good file.
+#define FILESYSTEM_PUT_TEMP_FILE ".put"
+#define FILESYSTEM_TRANSFER_MAX_PATH 64
+// get sends this many bytes per line, which base64 encodes as 64 characters.
+#define FILESYSTEM_GET_LINE_BYTES 48
+
+static struct {
+    lfs_t *volume;
+    lfs_file_t file;
+    char path[FILESYSTEM_TRANSFER_MAX_PATH]; // relative to the volume
+    int32_t size;
+    int32_t received;
+    uint16_t crc;
+    uint16_t expected_crc;
+} put_transfer;
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int8_t _filesystem_base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decodes base64 in place, which is safe because the output is always shorter than the input.
+// Returns the number of bytes decoded, or -1 if the text isn't valid base64.
+static int32_t _filesystem_base64_decode(char *text) {
+    size_t length = strlen(text);
+    if (length % 4 != 0) return -1;
+    uint8_t *out = (uint8_t *)text;
+    int32_t decoded = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        uint32_t bits = 0;
+        uint8_t padding = 0;
+        for (size_t j = 0; j < 4; j++) {
+            int8_t value = 0;
+            // padding is only allowed in the last two places of the last group.
+            if (text[i + j] == '=' && i + 4 == length && j >= 2 && (j == 3 || text[i + 3] == '=')) {
+                padding++;
+            } else if ((value = _filesystem_base64_value(text[i + j])) < 0 || padding) {
+                return -1;
+            }
+            bits = (bits << 6) | value;
+        }
+        out[decoded++] = bits >> 16;
+        if (padding < 2) out[decoded++] = bits >> 8;
+        if (padding < 1) out[decoded++] = bits;
+    }
+    return decoded;
+}
+
+static void _filesystem_base64_encode(const uint8_t *data, size_t length, char *out) {
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t bits = (uint32_t)data[i] << 16;
+        if (i + 1 < length) bits |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length) bits |= data[i + 2];
+        *out++ = base64_alphabet[(bits >> 18) & 0x3F];
+        *out++ = base64_alphabet[(bits >> 12) & 0x3F];
+        *out++ = i + 1 < length ? base64_alphabet[(bits >> 6) & 0x3F] : '=';
+        *out++ = i + 2 < length ? base64_alphabet[bits & 0x3F] : '=';
+    }
+    *out = '\0';
+}
+
+static void _filesystem_put_abort(const char *reason) {
+    lfs_file_close(put_transfer.volume, &put_transfer.file);
+    lfs_remove(put_transfer.volume, FILESYSTEM_PUT_TEMP_FILE);
+    printf("put: %s\r\n", reason);
+}
+
+static bool _filesystem_put_finish(void) {
+    if (lfs_file_close(put_transfer.volume, &put_transfer.file) < 0) {
+        lfs_remove(put_transfer.volume, FILESYSTEM_PUT_TEMP_FILE);
+        printf("put: write failed\r\n");
+    } else if (put_transfer.crc != put_transfer.expected_crc) {
+        lfs_remove(put_transfer.volume, FILESYSTEM_PUT_TEMP_FILE);
+        printf("put: checksum mismatch (got %04x)\r\n", put_transfer.crc);
+    } else if (lfs_rename(put_transfer.volume, FILESYSTEM_PUT_TEMP_FILE, put_transfer.path) < 0) {
+        lfs_remove(put_transfer.volume, FILESYSTEM_PUT_TEMP_FILE);
+        printf("put: rename failed\r\n");
+    } else {
+        printf("ok %" PRId32 " %04x\r\n", put_transfer.size, put_transfer.crc);
+    }
+    _filesystem_stats_flush_if_needed();
+    return false;
+}
+
+// Receives the base64 lines that follow a put command, writing each one straight to the file.
+static bool _filesystem_put_line(char *line) {
+    if (strcmp(line, ".") == 0) {
+        _filesystem_put_abort("aborted");
+        return false;
+    }
+    int32_t length = _filesystem_base64_decode(line);
+    if (length < 0 || put_transfer.received + length > put_transfer.size) {
+        _filesystem_put_abort("bad data");
+        return false;
+    }
+    if (lfs_file_write(put_transfer.volume, &put_transfer.file, line, length) != length) {
+        _filesystem_put_abort("write failed");
+        return false;
+    }
+    put_transfer.crc = watch_utility_crc16((uint8_t *)line, length, put_transfer.crc);
+    put_transfer.received += length;
+    if (put_transfer.received < put_transfer.size) return true;
+    return _filesystem_put_finish();
+}
+
+int filesystem_cmd_put(int argc, char *argv[]) {
+    (void) argc;
+    char *path = argv[1];
+    lfs_t *volume = _filesystem_volume(&path);
+    if (volume == NULL) {
+        printf("put: %s: Volume not available\r\n", argv[1]);
+        return 1;
+    }
+    char *end;
+    long size = strtol(argv[2], &end, 10);
+    if (*end != '\0' || size < 0) return -2;
+    unsigned long crc = strtoul(argv[3], &end, 16);
+    if (*end != '\0' || crc > 0xFFFF) return -2;
+    if (strlen(path) >= sizeof(put_transfer.path)) {
+        printf("put: %s: Name too long\r\n", argv[1]);
+        return 1;
+    }
+
+    put_transfer.volume = volume;
+    strcpy(put_transfer.path, path);
+    put_transfer.size = size;
+    put_transfer.received = 0;
+    put_transfer.crc = 0xFFFF;
+    put_transfer.expected_crc = crc;
+    if (lfs_file_open(volume, &put_transfer.file, FILESYSTEM_PUT_TEMP_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0) {
+        printf("put: can't create %s\r\n", argv[1]);
+        return 1;
+    }
+
+    if (size == 0) {
+        _filesystem_put_finish();
+        return 0;
+    }
+    printf("ready\r\n");
+    shell_set_line_handler(_filesystem_put_line);
+    return 0;
+}
+
+int filesystem_cmd_get(int argc, char *argv[]) {
+    (void) argc;
+    char *path = argv[1];
+    lfs_t *volume = _filesystem_volume(&path);
+    if (volume == NULL || lfs_file_open(volume, &file, path, LFS_O_RDONLY) < 0) {
+        printf("get: %s: No such file\r\n", argv[1]);
+        return 1;
+    }
+
+    uint8_t buf[FILESYSTEM_GET_LINE_BYTES];
+    char line[FILESYSTEM_GET_LINE_BYTES / 3 * 4 + 1];
+    int32_t size = 0;
+    uint16_t crc = 0xFFFF;
+    int32_t length;
+    while ((length = lfs_file_read(volume, &file, buf, sizeof(buf))) > 0) {
+        _filesystem_base64_encode(buf, length, line);
+        printf("%s\r\n", line);
+        crc = watch_utility_crc16(buf, length, crc);
+        size += length;
+    }
+    lfs_file_close(volume, &file);
+    if (length < 0) {
+        printf("get: read failed\r\n");
+        return 1;
+    }
+    printf("end %" PRId32 " %04x\r\n", size, crc);
+    return 0;
+}
+
+int filesystem_cmd_fsstat(int argc, char *argv[]) {
+    if (argc >= 2) {
+        if (strcmp(argv[1], "reset") == 0) {
+            // only the session counters are reset; erase counts track the lifetime of the flash.
+            uint32_t erase_counts[FILESYSTEM_BLOCK_COUNT];
+            memcpy(erase_counts, stats.erase_counts, sizeof(erase_counts));
+            uint16_t unsaved_erases = stats.unsaved_erases;
+            memset(&stats, 0, sizeof(stats));
+            memcpy(stats.erase_counts, erase_counts, sizeof(erase_counts));
+            stats.unsaved_erases = unsaved_erases;
+            return 0;
+        } else if (strcmp(argv[1], "save") == 0) {
+            _filesystem_stats_save();
+            return 0;
+        }
+        return -2;
+    }
+
+    printf("reads:  %" PRIu32 " (%" PRIu32 " bytes)\r\n", stats.reads, stats.bytes_read);
+    printf("progs:  %" PRIu32 " (%" PRIu32 " bytes)\r\n", stats.progs, stats.bytes_programmed);
+    printf("erases: %" PRIu32 "\r\n", stats.erases);
+    printf("syncs:  %" PRIu32 "\r\n", stats.syncs);
+    printf("busy:   %" PRIu32 " ms total, %" PRIu32 " us max\r\n", (uint32_t)(stats.busy_us / 1000), stats.max_busy_us);
+    printf("erase counts by block:\r\n");
+    for (uint8_t i = 0; i < FILESYSTEM_BLOCK_COUNT; i++) {
+        printf("%6" PRIu32 "%s", stats.erase_counts[i], (i % 8 == 7) ? "\r\n" : " ");
+    }
+
+    return 0;
+}
+
+#if FILESYSTEM_ASSET_ROWS > 0
+static const filesystem_asset_header_t *_filesystem_asset_index(void) {
+    const filesystem_asset_header_t *header = (const filesystem_asset_header_t *)watch_storage_get_pointer(FILESYSTEM_ASSET_FIRST_ROW, 0);
+    if (header->magic != FILESYSTEM_ASSET_MAGIC || header->count > FILESYSTEM_ASSET_MAX_COUNT) return NULL;
+    return header;
+}
+
+static const filesystem_asset_entry_t *_filesystem_asset_find(const filesystem_asset_header_t *header, const char *name) {
+    const filesystem_asset_entry_t *entries = (const filesystem_asset_entry_t *)(header + 1);
+    for (uint16_t i = 0; i < header->count; i++) {
+        if (strncmp(entries[i].name, name, FILESYSTEM_ASSET_NAME_LENGTH) == 0) return &entries[i];
+    }
+    return NULL;
+}
+#endif
+
+const void *filesystem_get_asset(const char *name, int32_t *length) {
+#if FILESYSTEM_ASSET_ROWS > 0
+    const filesystem_asset_header_t *header = _filesystem_asset_index();
+    if (header == NULL) return NULL;
+    const filesystem_asset_entry_t *entry = _filesystem_asset_find(header, name);
+    if (entry == NULL) return NULL;
+    if (length != NULL) *length = entry->length;
+    return watch_storage_get_pointer(FILESYSTEM_ASSET_FIRST_ROW, entry->offset);
+#else
+    (void) name;
+    (void) length;
+    return NULL;
+#endif
+}
+
+#if FILESYSTEM_ASSET_ROWS > 0
+static int _filesystem_asset_add(char *name, char *filename) {
+    if (strlen(name) > FILESYSTEM_ASSET_NAME_LENGTH) {
+        printf("asset: names are limited to %d characters\r\n", FILESYSTEM_ASSET_NAME_LENGTH);
+        return 1;
+    }
+    int32_t size = filesystem_get_file_size(filename);
+    if (size <= 0) {
+        printf("asset: %s: No such file\r\n", filename);
+        return 1;
+    }
+
+    // the index is rewritten as a whole, so work on a copy of the entire row. Words, so that the
+    // header and entries can be read in place: the M0+ faults on unaligned word access.
+    uint32_t index[NVMCTRL_ROW_SIZE / sizeof(uint32_t)];
+    filesystem_asset_header_t *header = (filesystem_asset_header_t *)index;
+    filesystem_asset_entry_t *entries = (filesystem_asset_entry_t *)(header + 1);
+    if (_filesystem_asset_index() != NULL) {
+        watch_storage_read(FILESYSTEM_ASSET_FIRST_ROW, 0, (uint8_t *)index, sizeof(index));
+        if (_filesystem_asset_find(header, name) != NULL) {
+            printf("asset: %s already exists; use asset clear to start over\r\n", name);
+            return 1;
+        }
+    } else {
+        memset(index, 0xFF, sizeof(index));
+        header->magic = FILESYSTEM_ASSET_MAGIC;
+        header->count = 0;
+    }
+    if (header->count >= FILESYSTEM_ASSET_MAX_COUNT) {
+        printf("asset: the index is full\r\n");
+        return 1;
+    }
+
+    // new data goes in the first free page after the existing assets.
+    uint32_t offset = NVMCTRL_ROW_SIZE;
+    for (uint16_t i = 0; i < header->count; i++) {
+        uint32_t end = entries[i].offset + entries[i].length;
+        end = (end + NVMCTRL_PAGE_SIZE - 1) / NVMCTRL_PAGE_SIZE * NVMCTRL_PAGE_SIZE;
+        if (end > offset) offset = end;
+    }
+    if (offset + size > FILESYSTEM_ASSET_ROWS * NVMCTRL_ROW_SIZE) {
+        printf("asset: not enough space for %" PRId32 " bytes\r\n", size);
+        return 1;
+    }
+
+    lfs_t *volume = _filesystem_volume(&filename);
+    int err = lfs_file_open(volume, &file, filename, LFS_O_RDONLY);
+    if (err < 0) return err;
+    uint8_t page[NVMCTRL_PAGE_SIZE];
+    for (int32_t copied = 0; copied < size; copied += NVMCTRL_PAGE_SIZE) {
+        uint32_t address = offset + copied;
+        // rows past the end of the existing data are erased as we reach them.
+        if (address % NVMCTRL_ROW_SIZE == 0) watch_storage_erase(FILESYSTEM_ASSET_FIRST_ROW + address / NVMCTRL_ROW_SIZE);
+        memset(page, 0xFF, sizeof(page));
+        if (lfs_file_read(volume, &file, page, min(size - copied, NVMCTRL_PAGE_SIZE)) < 0) {
+            lfs_file_close(volume, &file);
+            return LFS_ERR_IO;
+        }
+        watch_storage_write(FILESYSTEM_ASSET_FIRST_ROW + address / NVMCTRL_ROW_SIZE, address % NVMCTRL_ROW_SIZE, page, sizeof(page));
+    }
+    lfs_file_close(volume, &file);
+
+    filesystem_asset_entry_t *entry = &entries[header->count++];
+    memset(entry->name, 0, sizeof(entry->name));
+    strncpy(entry->name, name, sizeof(entry->name));
+    entry->offset = offset;
+    entry->length = size;
+    watch_storage_erase(FILESYSTEM_ASSET_FIRST_ROW);
+    for (uint32_t i = 0; i < NVMCTRL_ROW_SIZE; i += NVMCTRL_PAGE_SIZE) {
+        watch_storage_write(FILESYSTEM_ASSET_FIRST_ROW, i, (uint8_t *)index + i, NVMCTRL_PAGE_SIZE);
+    }
+    watch_storage_sync();
+
+    return 0;
+}
+#endif
+
+int filesystem_cmd_asset(int argc, char *argv[]) {
+#if FILESYSTEM_ASSET_ROWS > 0
+    if (argc == 4 && strcmp(argv[1], "add") == 0) {
+        return _filesystem_asset_add(argv[2], argv[3]);
+    } else if (argc == 2 && strcmp(argv[1], "clear") == 0) {
+        // erasing the index is enough; data rows are erased again as they are reused.
+        watch_storage_erase(FILESYSTEM_ASSET_FIRST_ROW);
+        watch_storage_sync();
+        return 0;
+    } else if (argc != 1) {
+        return -2;
+    }
+
+    const filesystem_asset_header_t *header = _filesystem_asset_index();
+    uint32_t used = NVMCTRL_ROW_SIZE;
+    if (header != NULL) {
+        const filesystem_asset_entry_t *entries = (const filesystem_asset_entry_t *)(header + 1);
+        for (uint16_t i = 0; i < header->count; i++) {
+            printf("%4d bytes %.*s\r\n", entries[i].length, FILESYSTEM_ASSET_NAME_LENGTH, entries[i].name);
+            used = entries[i].offset + entries[i].length;
+        }
+    }
+    printf("%" PRIu32 " of %d bytes used\r\n", used, FILESYSTEM_ASSET_ROWS * NVMCTRL_ROW_SIZE);
+#else
+    (void) argc;
+    (void) argv;
+    printf("asset: no asset region; build with FILESYSTEM_ASSET_ROWS set\r\n");
+#endif
+    return 0;
+}
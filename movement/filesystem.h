@@ -29,15 +29,31 @@
 #include "watch.h"
 
 /** @brief Initializes and mounts the tiny 8kb filesystem, formatting it if need be.
+  * @details When built with FILESYSTEM_EXT=1, paths under /ext refer to a second volume on the sensor
+  *          board's SPI flash instead; it is mounted the first time one of those paths is used.
   * @return true if the filesystem was mounted successfully.
   */
 bool filesystem_init(void);
 
 /** @brief Gets the space available on the filesystem.
+  * @details The block count is cached and only recomputed after the filesystem has been written to,
+  *          so repeated calls between writes are cheap.
   * @return the free space in bytes
   */
 int32_t filesystem_get_free_space(void);
 
+/** @brief Gets the space available on the volume holding a path.
+  * @param path a path on the volume, i.e. "/" for the internal flash or "/ext" for the external SPI flash
+  * @return the free space in bytes, or a negative error code if the volume is not available.
+  */
+int32_t filesystem_get_volume_free_space(char *path);
+
+/** @brief Gets the total size of the volume holding a path.
+  * @param path a path on the volume, i.e. "/" for the internal flash or "/ext" for the external SPI flash
+  * @return the size in bytes, or a negative error code if the volume is not available.
+  */
+int32_t filesystem_get_volume_size(char *path);
+
 /** @brief Checks for the existence of a file on the filesystem.
   * @param filename the file you wish to check
   * @return true if the file exists; false otherwise
@@ -50,6 +66,13 @@ bool filesystem_file_exists(char *filename);
   */
 bool filesystem_rm(char *filename);
 
+/** @brief Renames a file, replacing any file that already has the new name.
+  * @param old_name the file you wish to rename
+  * @param new_name its new name, on the same volume
+  * @return true if the file was renamed successfully; false otherwise
+  */
+bool filesystem_rename(char *old_name, char *new_name);
+
 /** @brief Gets the size of a file on the filesystem.
   * @param filename the file whose size you wish to determine
   * @return the file's size in bytes, or -1 if the file does not exist.
@@ -80,6 +103,15 @@ bool filesystem_read_file(char *filename, char *buf, int32_t length);
   */
 bool filesystem_read_line(char *filename, char *buf, int32_t *offset, int32_t length);
 
+/** @brief Reads part of a file into a buffer
+  * @param filename the file you wish to read
+  * @param offset The position in the file to start reading from
+  * @param buf A buffer of at least length bytes
+  * @param length The maximum number of bytes to read
+  * @return The number of bytes read, which is less than length at the end of the file; or -1 on error
+  */
+int32_t filesystem_read_file_at(char *filename, int32_t offset, char *buf, int32_t length);
+
 /** @brief Writes file to the filesystem
   * @param filename the file you wish to write
   * @param text The contents of the file
@@ -96,11 +128,24 @@ bool filesystem_write_file(char *filename, char *text, int32_t length);
   */
 bool filesystem_append_file(char *filename, char *text, int32_t length);
 
+/** @brief Looks up a read-only asset, which can be read in place without copying it into RAM.
+  * @param name the asset's name, as given to the `asset add` shell command
+  * @param length if not NULL, receives the asset's length in bytes
+  * @return a pointer to the asset's data, or NULL if there is no such asset.
+  * @note Assets live in a region of flash reserved with FILESYSTEM_ASSET_ROWS (see filesystem_config.h).
+  *       The data is 4-byte aligned, and the pointer stays valid until the assets are changed from the shell.
+  */
+const void *filesystem_get_asset(const char *name, int32_t *length);
+
 int filesystem_cmd_ls(int argc, char *argv[]);
 int filesystem_cmd_cat(int argc, char *argv[]);
 int filesystem_cmd_df(int argc, char *argv[]);
 int filesystem_cmd_rm(int argc, char *argv[]);
 int filesystem_cmd_format(int argc, char *argv[]);
 int filesystem_cmd_echo(int argc, char *argv[]);
+int filesystem_cmd_put(int argc, char *argv[]);
+int filesystem_cmd_get(int argc, char *argv[]);
+int filesystem_cmd_fsstat(int argc, char *argv[]);
+int filesystem_cmd_asset(int argc, char *argv[]);
 
 #endif // FILESYSTEM_H_
@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FILESYSTEM_CONFIG_H_
+#define FILESYSTEM_CONFIG_H_
+
+/*
+ * littlefs geometry profiles for the 8 KB RWWEE filesystem.
+ *
+ * None of these values are stored on disk, so switching profiles does not require a format.
+ * Select one at build time with `make FILESYSTEM_PROFILE=THROUGHPUT` (or BALANCED).
+ * Each profile costs roughly 3 * FILESYSTEM_CACHE_SIZE + FILESYSTEM_LOOKAHEAD_SIZE bytes of heap:
+ * littlefs keeps a read cache, a program cache and one cache per open file.
+ * See utils/filesystem_bench for a host benchmark that compares them on typical face workloads;
+ * it counts block device traffic, but its times are estimates, not measurements.
+ */
+
+#define FILESYSTEM_PROFILE_BALANCED 0
+#define FILESYSTEM_PROFILE_THROUGHPUT 1
+
+/** @brief Geometry profile (default: balanced, i.e. the historical settings) */
+#ifndef FILESYSTEM_PROFILE
+#define FILESYSTEM_PROFILE FILESYSTEM_PROFILE_BALANCED
+#endif
+
+// The lookahead is a bitmap, one bit per block: 4 bytes cover all 32 blocks, and 8 is the least
+// littlefs accepts, so it is the same in every profile and more would buy nothing.
+#define FILESYSTEM_LOOKAHEAD_SIZE 8
+
+// Caches can't be smaller than the 64-byte program page, so BALANCED is also the least RAM there is.
+#if FILESYSTEM_PROFILE == FILESYSTEM_PROFILE_BALANCED
+#define FILESYSTEM_READ_SIZE 16
+#define FILESYSTEM_CACHE_SIZE 64
+#define FILESYSTEM_BLOCK_CYCLES 100
+#elif FILESYSTEM_PROFILE == FILESYSTEM_PROFILE_THROUGHPUT
+// Cache a whole row (576 more bytes of heap), read in page-sized chunks and relocate metadata less
+// often, at the cost of less even wear.
+#define FILESYSTEM_READ_SIZE 64
+#define FILESYSTEM_CACHE_SIZE 256
+#define FILESYSTEM_BLOCK_CYCLES 500
+#else
+#error "Unknown FILESYSTEM_PROFILE"
+#endif
+
+/*
+ * Read-only asset region. When non-zero, this many rows at the top of the 8 KB RWWEE area are taken
+ * away from littlefs and hold a packed, indexed set of assets that faces can read in place through
+ * filesystem_get_asset(), without copying them into RAM. The first row holds the index.
+ * Changing this value changes the size of the littlefs volume, which is reformatted on the next boot.
+ * Set at build time with `make FILESYSTEM_ASSET_ROWS=8`, then install assets with the `asset` command.
+ */
+
+/** @brief Rows reserved for read-only assets (default: none) */
+#ifndef FILESYSTEM_ASSET_ROWS
+#define FILESYSTEM_ASSET_ROWS 0
+#endif
+
+#if FILESYSTEM_ASSET_ROWS == 1 || FILESYSTEM_ASSET_ROWS > 16
+#error "FILESYSTEM_ASSET_ROWS must be 0, or between 2 and 16 to leave room for littlefs"
+#endif
+
+/** @brief Longest asset name; names of exactly this length are not null-terminated in the index */
+#define FILESYSTEM_ASSET_NAME_LENGTH 12
+
+/*
+ * Optional second volume on the sensor board's SPI NOR flash, reachable under /ext (i.e. /ext/data.bin).
+ * Enable with `make FILESYSTEM_EXT=1`. The volume is only mounted (and formatted if blank) the first
+ * time an /ext path is used. The SPI flash shares SERCOM3 with the BLE UART, so don't use both at once.
+ */
+
+/** @brief Set to 1 to enable the /ext volume on external SPI flash (default: disabled) */
+#ifndef FILESYSTEM_ENABLE_EXT
+#define FILESYSTEM_ENABLE_EXT 0
+#endif
+
+/** @brief Prefix routed to the external volume */
+#define FILESYSTEM_EXT_PREFIX "/ext"
+
+// Geometry of the 2 MB NOR flash on the motion sensor board: 256-byte pages, 4 KB erase sectors.
+#define FILESYSTEM_EXT_PAGE_SIZE 256
+#define FILESYSTEM_EXT_BLOCK_SIZE 4096
+#ifndef FILESYSTEM_EXT_BLOCK_COUNT
+#define FILESYSTEM_EXT_BLOCK_COUNT 512
+#endif
+#define FILESYSTEM_EXT_CACHE_SIZE 256
+#define FILESYSTEM_EXT_LOOKAHEAD_SIZE 64
+#define FILESYSTEM_EXT_BLOCK_CYCLES 500
+
+#endif
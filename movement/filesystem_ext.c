@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include "filesystem_ext.h"
+#include "filesystem_config.h"
+#include "spiflash.h"
+
+static int lfs_spiflash_read(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
+    return spi_flash_read_data(block * cfg->block_size + off, buffer, size) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int lfs_spiflash_prog(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
+    return spi_flash_program(block * cfg->block_size + off, (uint8_t *)buffer, size) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int lfs_spiflash_erase(const struct lfs_config *cfg, lfs_block_t block) {
+    return spi_flash_erase_sector(block * cfg->block_size) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int lfs_spiflash_sync(const struct lfs_config *cfg) {
+    (void) cfg;
+    // program and erase already wait for the chip, so there is nothing left in flight.
+    return LFS_ERR_OK;
+}
+
+const struct lfs_config filesystem_ext_cfg = {
+    // block device operations
+    .read  = lfs_spiflash_read,
+    .prog  = lfs_spiflash_prog,
+    .erase = lfs_spiflash_erase,
+    .sync  = lfs_spiflash_sync,
+
+    // block device configuration
+    .read_size = 1,
+    .prog_size = FILESYSTEM_EXT_PAGE_SIZE,
+    .block_size = FILESYSTEM_EXT_BLOCK_SIZE,
+    .block_count = FILESYSTEM_EXT_BLOCK_COUNT,
+    .cache_size = FILESYSTEM_EXT_CACHE_SIZE,
+    .lookahead_size = FILESYSTEM_EXT_LOOKAHEAD_SIZE,
+    .block_cycles = FILESYSTEM_EXT_BLOCK_CYCLES,
+};
+
+bool filesystem_ext_probe(void) {
+    uint8_t jedec_id[3] = {0};
+    spi_flash_init();
+    spi_flash_read_command(CMD_READ_JEDEC_ID, jedec_id, 3);
+    // with no chip on the bus, MISO floats high or is pulled low.
+    return !(jedec_id[0] == 0x00 || jedec_id[0] == 0xFF);
+}
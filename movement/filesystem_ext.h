@@ -0,0 +1,41 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FILESYSTEM_EXT_H_
+#define FILESYSTEM_EXT_H_
+
+#include "lfs.h"
+
+/** @brief littlefs configuration for the external SPI flash volume.
+  * @details Block operations map littlefs blocks onto 4 KB erase sectors of the flash chip;
+  *          see FILESYSTEM_EXT_* in filesystem_config.h for the geometry.
+  */
+extern const struct lfs_config filesystem_ext_cfg;
+
+/** @brief Prepares the SPI bus and checks that a flash chip responds.
+  * @return true if a flash chip was detected; false otherwise.
+  */
+bool filesystem_ext_probe(void);
+
+#endif // FILESYSTEM_EXT_H_
@@ -35,6 +35,13 @@
 #include "movement.h"
 #include "shell.h"
 #include "ble_uart.h"
+#include "ble_request.h"
+#include "ble_time_sync.h"
+#include "ble_hid.h"
+#include "ble_notify.h"
+#include "ble_export.h"
+#include "ble_remote.h"
+#include "movement_log.h"
 
 #ifndef MOVEMENT_FIRMWARE
 #include "movement_config.h"
@@ -178,7 +185,8 @@ static inline void _movement_enable_fast_tick_if_needed(void) {
 static inline void _movement_disable_fast_tick_if_possible(void) {
     if ((movement_state.light_ticks == -1) &&
         (movement_state.alarm_ticks == -1) &&
-        ((movement_state.light_down_timestamp + movement_state.mode_down_timestamp + movement_state.alarm_down_timestamp) == 0)) {
+        ((movement_state.light_down_timestamp + movement_state.mode_down_timestamp + movement_state.alarm_down_timestamp) == 0) &&
+        !ble_request_pending() && !ble_uart_is_awake()) {
         movement_state.fast_tick_enabled = false;
         watch_rtc_disable_periodic_callback(128);
     }
@@ -193,6 +201,8 @@ static void _movement_handle_background_tasks(void) {
             watch_faces[i].loop(background_event, &movement_state.settings, watch_face_contexts[i]);
         }
     }
+    // BLE requests are only serviced by the full app loop, so a sync that falls due in low energy mode waits.
+    ble_time_sync_background_task(movement_state.le_mode_ticks != -1);
     movement_state.needs_background_tasks_handled = false;
 }
 
@@ -353,6 +363,10 @@ static void set_initial_clock_mode(void) {
 }
 
 void movement_play_signal(void) {
+    movement_play_sequence(signal_tune);
+}
+
+void movement_play_sequence(int8_t *note_sequence) {
     void *maybe_disable_buzzer = end_buzzing_and_disable_buzzer;
     if (watch_is_buzzer_or_led_enabled()) {
         maybe_disable_buzzer = end_buzzing;
@@ -360,7 +374,7 @@ void movement_play_signal(void) {
         watch_enable_buzzer();
     }
     movement_state.is_buzzing = true;
-    watch_buzzer_play_sequence(signal_tune, maybe_disable_buzzer);
+    watch_buzzer_play_sequence(note_sequence, maybe_disable_buzzer);
     if (movement_state.le_mode_ticks == -1) {
         // the watch is asleep. wake it up for "1" round through the main loop.
         // the sleep_mode_app_loop will notice the is_buzzing and note that it
@@ -413,7 +427,12 @@ void app_init(void) {
     movement_state.next_available_backup_register = 4;
     _movement_reset_inactivity_countdown();
 
+    movement_log_init();
+
     filesystem_init();
+    ble_notify_init();
+    ble_export_init();
+    ble_remote_init();
 
 #if __EMSCRIPTEN__
     int32_t time_zone_offset = EM_ASM_INT({
@@ -445,9 +464,6 @@ void app_setup(void) {
         // Initialize the shell system
         shell_init();
 
-        // Initialize the BLE UART TLV driver
-        ble_uart_init();
-
         for(uint8_t i = 0; i < MOVEMENT_NUM_FACES; i++) {
             watch_face_contexts[i] = NULL;
             scheduled_tasks[i].reg = 0;
@@ -468,6 +484,9 @@ void app_setup(void) {
         watch_register_interrupt_callback(BTN_LIGHT, cb_light_btn_interrupt, INTERRUPT_TRIGGER_BOTH);
         watch_register_interrupt_callback(BTN_ALARM, cb_alarm_btn_interrupt, INTERRUPT_TRIGGER_BOTH);
 
+        // Park the BLE UART with its RX wake armed; this needs the EIC, which was just (re)initialized.
+        ble_uart_init();
+
         watch_enable_buzzer();
         watch_enable_leds();
         watch_enable_display();
@@ -485,11 +504,12 @@ void app_setup(void) {
 }
 
 void app_prepare_for_standby(void) {
-    ble_uart_deinit();
+    // app_loop only allows standby once the BLE UART has parked itself, so this is just a safeguard.
+    ble_uart_park();
 }
 
 void app_wake_from_standby(void) {
-    ble_uart_init();
+    // if the nRF woke us, its RX edge interrupt has already brought the BLE UART up.
 }
 
 static void _sleep_mode_app_loop(void) {
@@ -551,6 +571,8 @@ bool app_loop(void) {
         watch_register_extwake_callback(BTN_ALARM, cb_alarm_btn_extwake, true);
         event.event_type = EVENT_NONE;
         event.subsecond = 0;
+        // sleep mode turns off the EIC, so the BLE UART can't be woken; app_setup parks it again afterwards.
+        ble_uart_deinit();
 
         // _sleep_mode_app_loop takes over at this point and loops until le_mode_ticks is reset by the extwake handler,
         // or wake is requested using the movement_request_wake function.
@@ -566,6 +588,17 @@ bool app_loop(void) {
         app_setup();
     }
 
+    // button events from the phone take the event slot only when it's free, so they can't overwrite a real
+    // press, and otherwise act as one would.
+    if (event.event_type == EVENT_NONE) {
+        movement_event_type_t remote_event = ble_remote_next();
+        if (remote_event != EVENT_NONE) {
+            if (movement_state.alarm_ticks) movement_state.alarm_ticks = 0;
+            _movement_reset_inactivity_countdown();
+            event.event_type = remote_event;
+        }
+    }
+
     // default to being allowed to sleep by the face.
     bool can_sleep = true;
 
@@ -635,6 +668,21 @@ bool app_loop(void) {
     // The shell will automatically use the appropriate backend (USB CDC or UART)
     shell_task();
 
+    // Deliver answers to BLE requests and time out the ones that didn't get any. The fast tick is their
+    // clock and the BLE UART's idle clock. The UART stops in standby, so the watch stays awake until
+    // the last request is done and the UART has been quiet long enough to park. It isn't parked while
+    // an answer is awaited, so the answer can't arrive while the UART is coming back up.
+    ble_request_task();
+    ble_hid_task();
+    ble_export_task();
+    bool ble_busy = ble_request_pending() || ble_hid_busy() || ble_export_busy() || ble_remote_busy();
+    if (ble_busy || !ble_uart_park_if_idle()) {
+        _movement_enable_fast_tick_if_needed();
+        can_sleep = false;
+    } else if (movement_state.fast_tick_enabled) {
+        _movement_disable_fast_tick_if_possible();
+    }
+
     event.subsecond = 0;
 
     // if the watch face changed, we can't sleep because we need to update the display.
@@ -703,6 +751,8 @@ void cb_alarm_fired(void) {
 
 void cb_fast_tick(void) {
     movement_state.fast_ticks++;
+    ble_request_fast_tick();
+    ble_uart_fast_tick();
     if (movement_state.light_ticks > 0) movement_state.light_ticks--;
     if (movement_state.alarm_ticks > 0) movement_state.alarm_ticks--;
     // check timestamps and auto-fire the long-press events
@@ -308,6 +308,8 @@ void movement_cancel_background_task_for_face(uint8_t watch_face_index);
 void movement_request_wake(void);
 
 void movement_play_signal(void);
+// plays a sequence as for watch_buzzer_play_sequence, taking care of the buzzer and of sleep mode as movement_play_signal does.
+void movement_play_sequence(int8_t *note_sequence);
 void movement_play_alarm(void);
 void movement_play_alarm_beeps(uint8_t rounds, BuzzerNote alarm_note);
 
@@ -0,0 +1,211 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "movement_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "watch.h"
+#include "movement.h"
+#include "shell_backend.h"
+
+#if (MOVEMENT_LOG_BUF_SZ & (MOVEMENT_LOG_BUF_SZ - 1)) != 0
+#error "MOVEMENT_LOG_BUF_SZ must be a power of two"
+#endif
+
+#if MOVEMENT_LOG_LINE_MAX > 255
+#error "MOVEMENT_LOG_LINE_MAX must fit in a byte"
+#endif
+
+// Each record is its message length (1), level (1) and watch_date_time (4), then the message.
+#define LOG_RECORD_HEADER_SZ (6)
+#define LOG_MASK (MOVEMENT_LOG_BUF_SZ - 1)
+
+#if MOVEMENT_LOG_BUF_SZ < LOG_RECORD_HEADER_SZ + MOVEMENT_LOG_LINE_MAX
+#error "MOVEMENT_LOG_BUF_SZ must hold at least one full record"
+#endif
+
+// s_head and s_tail only ever count up; they're masked when the buffer is indexed, so
+// s_head - s_tail is always the number of bytes in use.
+static uint8_t s_log[MOVEMENT_LOG_BUF_SZ];
+static size_t s_head = 0;
+static size_t s_tail = 0;
+static uint32_t s_dropped = 0;
+
+static const char s_level_letters[] = "-EWID";
+
+#if MOVEMENT_LOG_PERSIST
+// The saved record takes three backup registers: the time, then a marker byte holding the level
+// and the first seven characters of the message.
+#define LOG_BACKUP_MARKER (0xA0)
+#define LOG_BACKUP_CHARS (7)
+static uint8_t s_backup_reg = 0;
+#endif
+
+static void prv_push_record(uint8_t level, uint32_t timestamp, const char *text, size_t length) {
+    while (MOVEMENT_LOG_BUF_SZ - (s_head - s_tail) < LOG_RECORD_HEADER_SZ + length) {
+        s_tail += LOG_RECORD_HEADER_SZ + s_log[s_tail & LOG_MASK];
+        s_dropped++;
+    }
+
+    uint8_t header[LOG_RECORD_HEADER_SZ] = {length, level, timestamp, timestamp >> 8, timestamp >> 16, timestamp >> 24};
+    for (size_t i = 0; i < LOG_RECORD_HEADER_SZ; i++) {
+        s_log[s_head++ & LOG_MASK] = header[i];
+    }
+    for (size_t i = 0; i < length; i++) {
+        s_log[s_head++ & LOG_MASK] = text[i];
+    }
+}
+
+#if MOVEMENT_LOG_PERSIST
+static void prv_save_record(uint8_t level, uint32_t timestamp, const char *text, size_t length) {
+    uint8_t saved[8] = {LOG_BACKUP_MARKER | level};
+    memcpy(&saved[1], text, min(length, LOG_BACKUP_CHARS));
+    watch_store_backup_data(timestamp, s_backup_reg);
+    for (uint8_t i = 0; i < 2; i++) {
+        uint8_t *p = &saved[i * 4];
+        watch_store_backup_data(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24), s_backup_reg + 1 + i);
+    }
+}
+
+static void prv_restore_record(void) {
+    uint8_t saved[8];
+    for (uint8_t i = 0; i < 2; i++) {
+        uint32_t value = watch_get_backup_data(s_backup_reg + 1 + i);
+        saved[i * 4] = value;
+        saved[i * 4 + 1] = value >> 8;
+        saved[i * 4 + 2] = value >> 16;
+        saved[i * 4 + 3] = value >> 24;
+    }
+    if ((saved[0] & 0xF0) != LOG_BACKUP_MARKER) {
+        return;
+    }
+
+    char text[LOG_BACKUP_CHARS + 16];
+    int length = sprintf(text, "before reset: %.*s", LOG_BACKUP_CHARS, (char *)&saved[1]);
+    prv_push_record(saved[0] & 0x0F, watch_get_backup_data(s_backup_reg), text, length);
+    // only report it once.
+    watch_store_backup_data(0, s_backup_reg + 1);
+}
+#endif
+
+void movement_log_init(void) {
+#if MOVEMENT_LOG_PERSIST
+    uint8_t first = movement_claim_backup_register();
+    // registers are handed out in order, so if the last one was available, so were the others.
+    if (first != 0 && movement_claim_backup_register() != 0 && movement_claim_backup_register() != 0) {
+        s_backup_reg = first;
+        prv_restore_record();
+    }
+#endif
+}
+
+void movement_log(uint8_t level, const char *format, ...) {
+    char text[MOVEMENT_LOG_LINE_MAX + 1];
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (result < 0) {
+        return;
+    }
+
+    size_t length = min((size_t)result, MOVEMENT_LOG_LINE_MAX);
+    // the reader adds its own line endings.
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r')) {
+        length--;
+    }
+
+    uint32_t timestamp = watch_rtc_get_date_time().reg;
+    prv_push_record(level, timestamp, text, length);
+
+#if MOVEMENT_LOG_PERSIST
+    if (s_backup_reg != 0 && level <= MOVEMENT_LOG_LEVEL_WARN) {
+        prv_save_record(level, timestamp, text, length);
+    }
+#endif
+}
+
+size_t movement_log_read(char *buf, size_t length) {
+    size_t written = 0;
+    while (s_tail != s_head) {
+        uint8_t header[LOG_RECORD_HEADER_SZ];
+        for (size_t i = 0; i < LOG_RECORD_HEADER_SZ; i++) {
+            header[i] = s_log[(s_tail + i) & LOG_MASK];
+        }
+        size_t text_length = header[0];
+        uint8_t level = header[1] < sizeof(s_level_letters) - 1 ? header[1] : 0;
+        watch_date_time date_time;
+        date_time.reg = header[2] | (header[3] << 8) | (header[4] << 16) | ((uint32_t)header[5] << 24);
+
+        // "hh:mm:ss L " before the message and "\r\n" after it.
+        if (written + 11 + text_length + 2 > length) {
+            break;
+        }
+        char prefix[12];
+        sprintf(prefix, "%02d:%02d:%02d %c ", date_time.unit.hour, date_time.unit.minute, date_time.unit.second, s_level_letters[level]);
+        memcpy(&buf[written], prefix, 11);
+        written += 11;
+
+        s_tail += LOG_RECORD_HEADER_SZ;
+        for (size_t i = 0; i < text_length; i++) {
+            buf[written++] = s_log[s_tail++ & LOG_MASK];
+        }
+        buf[written++] = '\r';
+        buf[written++] = '\n';
+    }
+    return written;
+}
+
+void movement_log_clear(void) {
+    s_tail = s_head;
+    s_dropped = 0;
+}
+
+uint32_t movement_log_dropped(void) {
+    return s_dropped;
+}
+
+int movement_log_cmd(int argc, char *argv[]) {
+    if (argc == 2) {
+        if (strcmp(argv[1], "clear") != 0) {
+            return -2;
+        }
+        movement_log_clear();
+        return 0;
+    }
+
+    if (s_dropped > 0) {
+        printf("(%lu older records dropped)\r\n", s_dropped);
+        s_dropped = 0;
+    }
+    char buf[128];
+    size_t length;
+    while ((length = movement_log_read(buf, sizeof(buf))) > 0) {
+        shell_backend_write(buf, length);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MOVEMENT_LOG_H_
+#define MOVEMENT_LOG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A leveled log that writes into a RAM ring buffer instead of the serial port. Logging costs a
+ * vsnprintf and a copy, whether or not anything is connected, and the records stay in RAM through
+ * standby until the `log` shell command (or the RPC LOG_READ command) drains them. When the ring
+ * is full, the oldest records are dropped to make room.
+ *
+ * Use the MOVEMENT_LOG_* macros rather than calling movement_log directly: calls more verbose
+ * than MOVEMENT_LOG_LEVEL (i.e. DEBUG when the level is INFO) are compiled out, arguments and all.
+ * Don't log from an interrupt handler.
+ */
+
+#define MOVEMENT_LOG_LEVEL_NONE 0
+#define MOVEMENT_LOG_LEVEL_ERROR 1
+#define MOVEMENT_LOG_LEVEL_WARN 2
+#define MOVEMENT_LOG_LEVEL_INFO 3
+#define MOVEMENT_LOG_LEVEL_DEBUG 4
+
+/** @brief Most verbose level compiled in (default: MOVEMENT_LOG_LEVEL_INFO) */
+#ifndef MOVEMENT_LOG_LEVEL
+#define MOVEMENT_LOG_LEVEL MOVEMENT_LOG_LEVEL_INFO
+#endif
+
+/** @brief Size of the log ring buffer in bytes; must be a power of two (default: 1024) */
+#ifndef MOVEMENT_LOG_BUF_SZ
+#define MOVEMENT_LOG_BUF_SZ 1024
+#endif
+
+/** @brief Longest message kept, in characters; longer ones are truncated (default: 80) */
+#ifndef MOVEMENT_LOG_LINE_MAX
+#define MOVEMENT_LOG_LINE_MAX 80
+#endif
+
+/** @brief Keep the start of the last error or warning in three RTC backup registers, so it can be
+ *         read back after a reset or BACKUP mode (default: disabled)
+ */
+#ifndef MOVEMENT_LOG_PERSIST
+#define MOVEMENT_LOG_PERSIST 0
+#endif
+
+#if MOVEMENT_LOG_LEVEL >= MOVEMENT_LOG_LEVEL_ERROR
+#define MOVEMENT_LOG_ERROR(...) movement_log(MOVEMENT_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define MOVEMENT_LOG_ERROR(...) do {} while (0)
+#endif
+
+#if MOVEMENT_LOG_LEVEL >= MOVEMENT_LOG_LEVEL_WARN
+#define MOVEMENT_LOG_WARN(...) movement_log(MOVEMENT_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define MOVEMENT_LOG_WARN(...) do {} while (0)
+#endif
+
+#if MOVEMENT_LOG_LEVEL >= MOVEMENT_LOG_LEVEL_INFO
+#define MOVEMENT_LOG_INFO(...) movement_log(MOVEMENT_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define MOVEMENT_LOG_INFO(...) do {} while (0)
+#endif
+
+#if MOVEMENT_LOG_LEVEL >= MOVEMENT_LOG_LEVEL_DEBUG
+#define MOVEMENT_LOG_DEBUG(...) movement_log(MOVEMENT_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define MOVEMENT_LOG_DEBUG(...) do {} while (0)
+#endif
+
+/** @brief Sets up the log. With MOVEMENT_LOG_PERSIST, this claims the backup registers and moves
+ *         any record saved in them before a reset into the ring. Call once from app_init.
+ */
+void movement_log_init(void);
+
+/** @brief Adds a record to the log.
+  * @param level One of the MOVEMENT_LOG_LEVEL_* values
+  * @param format A printf-style format string. No line ending is needed.
+  */
+void movement_log(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/** @brief Removes the oldest records from the log and formats them as text, one line each.
+  * @param buf The buffer to fill. Only whole lines are written, and the text is not null-terminated.
+  * @param length The size of buf. Records that don't fit stay in the log for the next call.
+  * @return The number of bytes written to buf, or 0 if the log is empty.
+  */
+size_t movement_log_read(char *buf, size_t length);
+
+/** @brief Discards every record in the log. */
+void movement_log_clear(void);
+
+/** @brief Returns the number of records dropped because the log was full, since the log was last
+  *        cleared or printed by the `log` command.
+  */
+uint32_t movement_log_dropped(void);
+
+/** @brief Shell command to print and drain the log; `log clear` discards it instead.
+  */
+int movement_log_cmd(int argc, char *argv[]);
+
+#endif
@@ -40,6 +40,8 @@
 #include "shell_cmd_list.h"
 #include "shell_backend.h"
 #include "shell_config.h"
+#include "shell_rpc.h"
+#include "filesystem.h"
 
 extern shell_command_t g_shell_commands[];
 extern const size_t g_num_shell_commands;
@@ -58,11 +60,26 @@ static bool s_shell_initialized = false;
 
 static char s_buf[SHELL_BUF_SZ] = {0};
 static size_t s_buf_len = 0;
-// Pointer to the first invalid byte after the end of input.
-static char *const s_buf_end = s_buf + SHELL_BUF_SZ;
+static bool s_last_char_was_cr = false;
+static shell_line_handler_t s_line_handler = NULL;
+
+// Ring of recent command lines. s_history_next is the slot the next line goes in, and
+// s_history_pos is how far back the up arrow has gone; 0 means the line being typed.
+static char s_history[SHELL_HISTORY_DEPTH][SHELL_HISTORY_LINE_SZ];
+static size_t s_history_count = 0;
+static size_t s_history_next = 0;
+static size_t s_history_pos = 0;
+
+// Progress through an ANSI escape sequence: 1 after ESC, 2 after ESC [.
+static uint8_t s_escape_state = 0;
+
+static bool s_script_running = false;
+#if SHELL_AUTOEXEC_ON_CONNECT
+static bool s_was_connected = false;
+#endif
 
-static char *prv_skip_whitespace(char *c) {
-    while (c >= s_buf && c < s_buf_end) {
+static char *prv_skip_whitespace(char *c, const char *end) {
+    while (c < end) {
         if (*c == 0) {
             return NULL;
         }
@@ -74,10 +91,10 @@ static char *prv_skip_whitespace(char *c) {
     return NULL;
 }
 
-static char *prv_skip_non_whitespace(char *c) {
+static char *prv_skip_non_whitespace(char *c, const char *end) {
     bool in_quote = false;
     char quote_char;
-    while (c >= s_buf && c < s_buf_end) {
+    while (c < end) {
         if (*c == 0) {
             return NULL;
         }
@@ -100,16 +117,85 @@ static char *prv_skip_non_whitespace(char *c) {
     return NULL;
 }
 
-static int prv_handle_command() {
+static void prv_puts(const char *s) {
+    shell_backend_write(s, strlen(s));
+}
+
+static void prv_print_help(const shell_command_t *command) {
+    if (command->help == NULL) {
+        return;
+    }
+    prv_puts(NEWLINE);
+    prv_puts(command->help);
+    prv_puts(NEWLINE);
+}
+
+static int prv_compare_commands(const void *a, const void *b) {
+    return strcasecmp(((const shell_command_t *)a)->name, ((const shell_command_t *)b)->name);
+}
+
+// The command table is kept in case-insensitive order in shell_cmd_list.c. If an entry was added out
+// of place, sort it once here rather than break the binary search.
+static void prv_sort_commands(void) {
+    for (size_t i = 1; i < g_num_shell_commands; i++) {
+        if (prv_compare_commands(&g_shell_commands[i - 1], &g_shell_commands[i]) > 0) {
+            qsort(g_shell_commands, g_num_shell_commands, sizeof(shell_command_t), prv_compare_commands);
+            return;
+        }
+    }
+}
+
+static const shell_command_t *prv_find_command(const char *name) {
+    size_t lo = 0;
+    size_t hi = g_num_shell_commands;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcasecmp(g_shell_commands[mid].name, name);
+        if (cmp == 0) {
+            return &g_shell_commands[mid];
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+// Finds the run of commands whose names start with prefix. Returns how many there are, and the
+// index of the first one in *first.
+static size_t prv_find_prefix(const char *prefix, size_t len, size_t *first) {
+    size_t lo = 0;
+    size_t hi = g_num_shell_commands;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncasecmp(g_shell_commands[mid].name, prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *first = lo;
+    size_t count = 0;
+    while (lo + count < g_num_shell_commands && !strncasecmp(g_shell_commands[lo + count].name, prefix, len)) {
+        count++;
+    }
+    return count;
+}
+
+// Splits a line into arguments in place and runs it. end points to the first byte after the
+// line's buffer.
+static int prv_handle_command(char *line, char *end) {
     char *argv[SHELL_MAX_ARGS] = {0};
     int argc = 0;
 
-    char *c = &s_buf[0];
-    s_buf[SHELL_BUF_SZ - 1] = '\0';
+    char *c = line;
+    end[-1] = '\0';
 
     while (argc < SHELL_MAX_ARGS) {
         // Skip contiguous whitespace
-        c = prv_skip_whitespace(c);
+        c = prv_skip_whitespace(c, end);
         if (c == NULL) {
             // Reached end of buffer
             break;
@@ -119,7 +205,7 @@ static int prv_handle_command() {
         argv[argc++] = c;
 
         // Skip contiguous non-whitespace
-        c = prv_skip_non_whitespace(c);
+        c = prv_skip_non_whitespace(c, end);
         if (c == NULL) {
             // Reached end of buffer
             break;
@@ -133,43 +219,186 @@ static int prv_handle_command() {
         return -1;
     }
 
-    // Match against the command list
-    for (size_t i = 0; i < g_num_shell_commands; i++) {
-        if (!strcasecmp(g_shell_commands[i].name, argv[0])) {
-            // If argc isn't valid for this command, display its help instead.
-            if (((argc - 1) < g_shell_commands[i].min_args) ||
-                ((argc - 1) > g_shell_commands[i].max_args)) {
-                if (g_shell_commands[i].help != NULL) {
-                    shell_backend_putchar('\r');
-                    shell_backend_putchar('\n');
-                    for (const char *p = g_shell_commands[i].help; *p; p++) {
-                        shell_backend_putchar(*p);
-                    }
-                    shell_backend_putchar('\r');
-                    shell_backend_putchar('\n');
-                }
-                return -2;
-            }
-            // Call the command's callback
-            if (g_shell_commands[i].cb != NULL) {
-                shell_backend_putchar('\r');
-                shell_backend_putchar('\n');
-                int ret = g_shell_commands[i].cb(argc, argv);
-                if (ret == -2) {
-                    shell_backend_putchar('\r');
-                    shell_backend_putchar('\n');
-                    for (const char *p = g_shell_commands[i].help; *p; p++) {
-                        shell_backend_putchar(*p);
-                    }
-                    shell_backend_putchar('\r');
-                    shell_backend_putchar('\n');
-                }
-                return ret;
-            }
+    return shell_run_command(argc, argv);
+}
+
+int shell_run_command(int argc, char *argv[]) {
+    const shell_command_t *command = prv_find_command(argv[0]);
+    if (command == NULL) {
+        return -1;
+    }
+
+    // If argc isn't valid for this command, display its help instead.
+    if (((argc - 1) < command->min_args) || ((argc - 1) > command->max_args)) {
+        prv_print_help(command);
+        return -2;
+    }
+
+    // Call the command's callback
+    if (command->cb == NULL) {
+        return -1;
+    }
+    prv_puts(NEWLINE);
+    int ret = command->cb(argc, argv);
+    if (ret == -2) {
+        prv_print_help(command);
+    }
+    return ret;
+}
+
+// Completes the command name being typed. A unique match is filled in along with a trailing space;
+// otherwise the input grows to the longest prefix the matches share, and if it can't grow, the
+// matches are listed.
+static void prv_complete_command(void) {
+    for (size_t i = 0; i < s_buf_len; i++) {
+        if (isspace((int) s_buf[i])) {
+            // Only the command name is completed, not its arguments.
+            return;
+        }
+    }
+
+    size_t first;
+    size_t count = prv_find_prefix(s_buf, s_buf_len, &first);
+    if (count == 0) {
+        return;
+    }
+
+    const char *name = g_shell_commands[first].name;
+    size_t common = strlen(name);
+    for (size_t i = first + 1; i < first + count; i++) {
+        size_t n = 0;
+        while (n < common && tolower((int) name[n]) == tolower((int) g_shell_commands[i].name[n])) {
+            n++;
         }
+        common = n;
+    }
+
+    if (count > 1 && common <= s_buf_len) {
+        prv_puts(NEWLINE);
+        for (size_t i = first; i < first + count; i++) {
+            prv_puts(g_shell_commands[i].name);
+            prv_puts("  ");
+        }
+        prv_puts(NEWLINE SHELL_PROMPT);
+        shell_backend_write(s_buf, s_buf_len);
+        return;
     }
 
-    return -1;
+    size_t typed = s_buf_len;
+    while (s_buf_len < common && s_buf_len < (SHELL_BUF_SZ - 2)) {
+        s_buf[s_buf_len] = name[s_buf_len];
+        s_buf_len++;
+    }
+    if (count == 1 && s_buf_len < (SHELL_BUF_SZ - 2)) {
+        s_buf[s_buf_len++] = ' ';
+    }
+    shell_backend_write(&s_buf[typed], s_buf_len - typed);
+}
+
+static const char *prv_history_entry(size_t back) {
+    return s_history[(s_history_next + SHELL_HISTORY_DEPTH - back) % SHELL_HISTORY_DEPTH];
+}
+
+// Remembers a line, unless it's empty, too long to keep, or the same as the one before it.
+static void prv_history_add(const char *line, size_t len) {
+    while (len > 0 && isspace((int) line[len - 1])) {
+        len--;
+    }
+    if (len == 0 || len >= SHELL_HISTORY_LINE_SZ) {
+        return;
+    }
+    if (s_history_count > 0) {
+        const char *last = prv_history_entry(1);
+        if (strlen(last) == len && !memcmp(last, line, len)) {
+            return;
+        }
+    }
+    memcpy(s_history[s_history_next], line, len);
+    s_history[s_history_next][len] = '\0';
+    s_history_next = (s_history_next + 1) % SHELL_HISTORY_DEPTH;
+    if (s_history_count < SHELL_HISTORY_DEPTH) {
+        s_history_count++;
+    }
+}
+
+// Replaces the line being typed with the entry `back` lines ago, or clears it for 0.
+static void prv_history_recall(size_t back) {
+    s_history_pos = back;
+    s_buf_len = 0;
+    if (back > 0) {
+        s_buf_len = strlen(prv_history_entry(back));
+        memcpy(s_buf, prv_history_entry(back), s_buf_len);
+    }
+    prv_puts("\r\x1b[K" SHELL_PROMPT);
+    shell_backend_write(s_buf, s_buf_len);
+}
+
+// Handles one character of an escape sequence. Only the up and down arrows do anything.
+static void prv_handle_escape(int c) {
+    if (s_escape_state == 1) {
+        s_escape_state = (c == '[') ? 2 : 0;
+        return;
+    }
+    // Parameter bytes may come before the final byte; wait for it.
+    if (c >= 0x20 && c < 0x40) {
+        return;
+    }
+    s_escape_state = 0;
+    if (c == 'A' && s_history_pos < s_history_count) {
+        prv_history_recall(s_history_pos + 1);
+    } else if (c == 'B' && s_history_pos > 0) {
+        prv_history_recall(s_history_pos - 1);
+    }
+}
+
+// Runs the line in s_buf, which ends with the line ending at s_buf[s_buf_len].
+static void prv_handle_line(void) {
+    if (s_line_handler != NULL) {
+        s_buf[s_buf_len] = '\0';
+        if (!s_line_handler(s_buf)) {
+            s_line_handler = NULL;
+        }
+        return;
+    }
+    // The parser splits the line up in place, so save it first.
+    prv_history_add(s_buf, s_buf_len);
+    s_history_pos = 0;
+    (void) prv_handle_command(s_buf, s_buf + SHELL_BUF_SZ);
+}
+
+bool shell_run_script(char *filename) {
+    if (s_script_running || !filesystem_file_exists(filename)) {
+        return false;
+    }
+    s_script_running = true;
+
+    // Read the script one line at a time, so it can be longer than there is memory for.
+    char line[SHELL_BUF_SZ];
+    int32_t size = filesystem_get_file_size(filename);
+    int32_t offset = 0;
+    while (offset < size) {
+        if (!filesystem_read_line(filename, line, &offset, sizeof(line) - 1)) {
+            break;
+        }
+        line[strcspn(line, "\r")] = '\0';
+        char *start = prv_skip_whitespace(line, line + sizeof(line));
+        if (start == NULL || *start == '#') {
+            continue;
+        }
+        // Show each command as if it had been typed, so the output can be told apart.
+        prv_puts(NEWLINE SHELL_PROMPT);
+        prv_puts(start);
+        if (prv_handle_command(line, line + sizeof(line)) == -1) {
+            prv_puts(NEWLINE "Unknown command");
+        }
+    }
+
+    s_script_running = false;
+    return true;
+}
+
+void shell_set_line_handler(shell_line_handler_t handler) {
+    s_line_handler = handler;
 }
 
 void shell_init(void) {
@@ -177,6 +406,8 @@ void shell_init(void) {
         return;
     }
 
+    prv_sort_commands();
+
     // Register all available backends
     shell_backend_usb_register();
     shell_backend_uart_register();
@@ -202,6 +433,12 @@ void shell_init(void) {
 #endif
 
     s_shell_initialized = true;
+
+#if SHELL_AUTOEXEC_ON_BOOT
+    if (shell_run_script(SHELL_AUTOEXEC_FILE)) {
+        prv_puts(NEWLINE);
+    }
+#endif
 }
 
 bool shell_set_backend(shell_backend_type_t backend_type) {
@@ -233,12 +470,20 @@ void shell_task(void) {
         stringToUTF8(tx, s, len);
         return s;
     });
-    s_buf_len = min((SHELL_BUF_SZ - 2), strlen(received_data));
-    memcpy(s_buf, received_data, s_buf_len);
+    // Run each line of the input as its own command.
+    char *line = received_data;
+    while (*line) {
+        size_t line_len = strcspn(line, "\r\n");
+        s_buf_len = min((SHELL_BUF_SZ - 2), line_len);
+        memcpy(s_buf, line, s_buf_len);
+        s_buf[s_buf_len] = '\n';
+        s_buf[s_buf_len + 1] = '\0';
+        prv_handle_line();
+        line += line_len;
+        line += strspn(line, "\r\n");
+    }
+    s_buf_len = 0;
     free(received_data);
-    s_buf[s_buf_len++] = '\n';
-    s_buf[s_buf_len++] = '\0';
-    prv_handle_command();
     EM_ASM({
         tx = "";
     });
@@ -248,19 +493,24 @@ void shell_task(void) {
         return;
     }
 
-    // Read one character at a time until we run out.
-    while (true) {
+#if SHELL_AUTOEXEC_ON_CONNECT
+    // Run the startup script again whenever a terminal opens the port.
+    bool connected = shell_backend_get_active() == SHELL_BACKEND_USB_CDC && watch_is_usb_serial_connected();
+    if (connected && !s_was_connected) {
+        if (shell_run_script(SHELL_AUTOEXEC_FILE)) {
+            prv_puts(NEWLINE SHELL_PROMPT);
+        }
+    }
+    s_was_connected = connected;
+#endif
+
+    // Read one character at a time until we run out, running each complete line as we go, so a
+    // script sent in one burst doesn't have to wait a loop iteration per command.
+    shell_rpc_poll();
+    size_t commands_run = 0;
+    while (commands_run < SHELL_MAX_COMMANDS_PER_TASK) {
         if (s_buf_len >= (SHELL_BUF_SZ - 1)) {
-            shell_backend_putchar('\r');
-            shell_backend_putchar('\n');
-            for (const char *p = "Command too long, clearing."; *p; p++) {
-                shell_backend_putchar(*p);
-            }
-            shell_backend_putchar('\r');
-            shell_backend_putchar('\n');
-            for (const char *p = SHELL_PROMPT; *p; p++) {
-                shell_backend_putchar(*p);
-            }
+            prv_puts(NEWLINE "Command too long, clearing." NEWLINE SHELL_PROMPT);
             s_buf_len = 0;
             break;
         }
@@ -272,19 +522,45 @@ void shell_task(void) {
             break;
         }
 
-        if (c == '\b') {
+        // A sync byte at the start of a line begins a binary RPC frame; it and the rest of the frame
+        // bypass the line editor.
+        if (shell_rpc_receiving() || (c == SHELL_RPC_SYNC && s_buf_len == 0)) {
+            if (shell_rpc_feed(c)) {
+                commands_run++;
+            }
+            continue;
+        }
+
+        if (s_escape_state != 0) {
+            prv_handle_escape(c);
+            continue;
+        } else if (c == 0x1b && s_line_handler == NULL) {
+            s_escape_state = 1;
+            continue;
+        }
+
+        // A CR LF pair ends one line, not two.
+        bool after_cr = s_last_char_was_cr;
+        s_last_char_was_cr = (c == '\r');
+        if (c == '\n' && after_cr) {
+            continue;
+        }
+
+        if (c == '\t') {
+            prv_complete_command();
+            continue;
+        } else if (c == '\b') {
             // Handle backspace character.
             // We need to emit a backspace, overwrite the character on the
             // screen with a space, and then backspace again to move the cursor.
             if (s_buf_len > 0) {
-                shell_backend_putchar('\b');
-                shell_backend_putchar(' ');
-                shell_backend_putchar('\b');
+                prv_puts("\b \b");
                 s_buf_len--;
             }
             continue;
-        } else if (c != '\n' && c != '\r') {
-            // Print regular characters to the screen.
+        } else if (c != '\n' && c != '\r' && s_line_handler == NULL) {
+            // Print regular characters to the screen. Lines going to a handler are data, not typing,
+            // so they aren't echoed.
             shell_backend_putchar(c);
         }
 
@@ -293,14 +569,12 @@ void shell_task(void) {
         if (c == '\n' || c == '\r') {
             // Newline! Handle the command.
             s_buf[s_buf_len+1] = '\0';
-            (void) prv_handle_command();
+            prv_handle_line();
             s_buf_len = 0;
-            shell_backend_putchar('\r');
-            shell_backend_putchar('\n');
-            for (const char *p = SHELL_PROMPT; *p; p++) {
-                shell_backend_putchar(*p);
+            if (s_line_handler == NULL) {
+                prv_puts(NEWLINE SHELL_PROMPT);
             }
-            break;
+            commands_run++;
         } else {
             s_buf_len++;
         }
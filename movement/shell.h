@@ -49,4 +49,31 @@ shell_backend_type_t shell_get_backend(void);
  */
 void shell_task(void);
 
+/** @brief Runs a command as if it had been typed at the prompt.
+ *  @param argc Number of arguments, including the command name
+ *  @param argv The command name followed by its arguments
+ *  @return The command's return value; -1 for an unknown command, or -2 if the arguments were wrong
+ */
+int shell_run_command(int argc, char *argv[]);
+
+/** @brief Runs each line of a file as a shell command. Blank lines and lines starting with '#'
+ *         are skipped. A script can't run another script.
+ *  @param filename The script to run
+ *  @return false if the file doesn't exist or a script is already running
+ */
+bool shell_run_script(char *filename);
+
+/** @brief Receives one line of input in place of the command parser.
+ *  @param line The line, without its line ending. The handler may modify it.
+ *  @return true to receive the next line too; false to return to the prompt.
+ */
+typedef bool (*shell_line_handler_t)(char *line);
+
+/** @brief Sends the following lines of input to a handler instead of running them as commands,
+ *         until the handler returns false. Lines sent to a handler are not echoed. Commands use
+ *         this to receive data, e.g. file contents, after they return.
+ *  @param handler The handler, or NULL to go back to running commands.
+ */
+void shell_set_line_handler(shell_line_handler_t handler);
+
 #endif
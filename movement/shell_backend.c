@@ -23,7 +23,9 @@
  */
 
 #include "shell_backend.h"
+#include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 
 // Backend registry
 static const shell_backend_t *s_backends[SHELL_BACKEND_COUNT] = {0};
@@ -89,6 +91,37 @@ int shell_backend_putchar(int c) {
     return backend->putchar(c);
 }
 
+size_t shell_backend_write(const char *buf, size_t len) {
+    const shell_backend_t *backend = s_backends[s_active_backend];
+    if (!backend) {
+        return 0;
+    }
+    
+    if (backend->write) {
+        return backend->write(buf, len);
+    }
+    
+    // Fall back to one character at a time for backends without a bulk path.
+    size_t written = 0;
+    while (written < len && backend->putchar && backend->putchar((unsigned char)buf[written])) {
+        written++;
+    }
+    return written;
+}
+
+size_t shell_backend_printf(const char *format, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    // a longer message was cut short by vsnprintf.
+    return shell_backend_write(buf, (size_t)length < sizeof(buf) ? (size_t)length : sizeof(buf) - 1);
+}
+
 void shell_backend_flush(void) {
     const shell_backend_t *backend = s_backends[s_active_backend];
     if (backend && backend->flush) {
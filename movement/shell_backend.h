@@ -25,6 +25,7 @@
 #ifndef SHELL_BACKEND_H_
 #define SHELL_BACKEND_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -52,6 +53,12 @@ typedef struct {
      *  @return number of characters written (0 or 1) */
     int (*putchar)(int c);
     
+    /** @brief Write a buffer to the backend (optional; putchar is used if NULL)
+     *  @param buf bytes to write
+     *  @param len number of bytes in buf
+     *  @return number of bytes written */
+    size_t (*write)(const char *buf, size_t len);
+    
     /** @brief Flush any pending output */
     void (*flush)(void);
     
@@ -84,6 +91,17 @@ int shell_backend_getchar(void);
  *  @return number of characters written */
 int shell_backend_putchar(int c);
 
+/** @brief Write a buffer to the active backend in one call
+ *  @param buf bytes to write
+ *  @param len number of bytes in buf
+ *  @return number of bytes written */
+size_t shell_backend_write(const char *buf, size_t len);
+
+/** @brief printf to the active backend; plain printf always goes to USB
+ *  @param format printf format, output limited to 127 characters
+ *  @return number of bytes written */
+size_t shell_backend_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
 /** @brief Flush output on the active backend */
 void shell_backend_flush(void);
 
@@ -29,12 +29,7 @@
 
 #if SHELL_ENABLE_UART_BACKEND
 
-// Circular buffer for UART input (similar to CDC implementation)
-#define UART_READ_BUF_SZ  SHELL_UART_READ_BUF_SZ
-#define UART_READ_BUF_IDX(x)  ((x) & (UART_READ_BUF_SZ - 1))
-static char s_uart_read_buf[UART_READ_BUF_SZ] = {0};
-static volatile size_t s_uart_read_buf_pos = 0;
-static volatile size_t s_uart_read_buf_len = 0;
+// Input and output are buffered by the interrupt-driven ring buffers in watch_uart.c.
 
 // State tracking
 static bool s_uart_initialized = false;
@@ -44,6 +39,7 @@ static bool uart_backend_init(void);
 static bool uart_backend_is_available(void);
 static int uart_backend_getchar(void);
 static int uart_backend_putchar(int c);
+static size_t uart_backend_write(const char *buf, size_t len);
 static void uart_backend_flush(void);
 static void uart_backend_deinit(void);
 
@@ -53,6 +49,7 @@ static const shell_backend_t uart_backend = {
     .is_available = uart_backend_is_available,
     .getchar = uart_backend_getchar,
     .putchar = uart_backend_putchar,
+    .write = uart_backend_write,
     .flush = uart_backend_flush,
     .deinit = uart_backend_deinit
 };
@@ -65,10 +62,6 @@ static bool uart_backend_init(void) {
     // Initialize UART with configured pins and baud rate
     watch_enable_uart(SHELL_UART_TX_PIN, SHELL_UART_RX_PIN, SHELL_UART_BAUD);
 
-    // Clear the input buffer
-    s_uart_read_buf_pos = 0;
-    s_uart_read_buf_len = 0;
-
     s_uart_initialized = true;
     return true;
 }
@@ -82,17 +75,8 @@ static int uart_backend_getchar(void) {
         return -1;
     }
 
-    // First, try to read any available data from UART and buffer it
-    // Note: watch_uart_getc() is blocking, so we need to check if data is available first
-    // Since the current UART API doesn't have a non-blocking check, we'll implement
-    // a simple polling mechanism
-
-    // If we have buffered data, return it
-    if (s_uart_read_buf_len > 0) {
-        const size_t start_pos = UART_READ_BUF_IDX(s_uart_read_buf_pos - s_uart_read_buf_len);
-        char c = s_uart_read_buf[start_pos];
-        s_uart_read_buf[start_pos] = 0;
-        s_uart_read_buf_len--;
+    uint8_t c;
+    if (watch_uart_read(&c, 1)) {
         return (int)c;
     }
 
@@ -105,31 +89,37 @@ static int uart_backend_putchar(int c) {
         return 0;
     }
 
-    // Convert single character to string for watch_uart_puts
-    char str[2] = {(char)c, '\0'};
-    watch_uart_puts(str);
+    // Characters are batched in the TX ring and sent in the background.
+    // We only wait here if the output outruns the baud rate by a full buffer.
+    uint8_t byte = (uint8_t)c;
+    while (!watch_uart_write(&byte, 1));
     return 1;
 }
 
-static void uart_backend_flush(void) {
-    // UART transmission is synchronous, so no explicit flush needed
-}
+static size_t uart_backend_write(const char *buf, size_t len) {
+    if (!s_uart_initialized) {
+        return 0;
+    }
 
-static void uart_backend_deinit(void) {
-    s_uart_initialized = false;
-    s_uart_read_buf_pos = 0;
-    s_uart_read_buf_len = 0;
+    // Queue as much as fits in the TX ring at a time; wait for room only when it is full.
+    size_t written = 0;
+    while (written < len) {
+        written += watch_uart_write((const uint8_t *)buf + written, len - written);
+    }
+    return written;
 }
 
-// Helper function to be called periodically to read UART data into buffer
-void shell_backend_uart_task(void) {
-    if (!s_uart_initialized) {
-        return;
+static void uart_backend_flush(void) {
+    if (s_uart_initialized) {
+        watch_uart_flush();
     }
+}
 
-    // This is a simplified approach - in a real implementation, you might want
-    // to use interrupts or a more sophisticated polling mechanism
-    // For now, we'll rely on the shell calling this periodically
+static void uart_backend_deinit(void) {
+    if (s_uart_initialized) {
+        watch_disable_uart();
+    }
+    s_uart_initialized = false;
 }
 
 // Auto-registration function
@@ -34,6 +34,7 @@ static bool usb_backend_init(void);
 static bool usb_backend_is_available(void);
 static int usb_backend_getchar(void);
 static int usb_backend_putchar(int c);
+static size_t usb_backend_write(const char *buf, size_t len);
 static void usb_backend_flush(void);
 static void usb_backend_deinit(void);
 
@@ -43,6 +44,7 @@ static const shell_backend_t usb_backend = {
     .is_available = usb_backend_is_available,
     .getchar = usb_backend_getchar,
     .putchar = usb_backend_putchar,
+    .write = usb_backend_write,
     .flush = usb_backend_flush,
     .deinit = usb_backend_deinit
 };
@@ -68,9 +70,15 @@ static int usb_backend_putchar(int c) {
     return (result == c) ? 1 : 0;
 }
 
+static size_t usb_backend_write(const char *buf, size_t len) {
+    // Go through stdio like putchar, so output stays in order with printf from commands;
+    // the CDC layer receives it in spans rather than byte by byte.
+    return fwrite(buf, 1, len, stdout);
+}
+
 static void usb_backend_flush(void) {
-    // Flush is handled automatically by the CDC layer
-    // No explicit flush needed
+    // Hand anything stdio is holding to the CDC layer, which sends it in the background.
+    fflush(stdout);
 }
 
 static void usb_backend_deinit(void) {
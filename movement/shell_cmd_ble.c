@@ -4,6 +4,13 @@
  */
 
 #include "ble_uart.h"
+#include "ble_request.h"
+#include "ble_link.h"
+#include "ble_time_sync.h"
+#include "ble_hid.h"
+#include "ble_notify.h"
+#include "ble_export.h"
+#include "ble_remote.h"
 #include "watch.h"
 #include "movement.h"
 
@@ -11,35 +18,87 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Poll for a ping ACK for up to this many milliseconds */
+/* How long to wait for a ping or echo answer */
 #define PING_TIMEOUT_MS   500
-/* CTS round-trip (discovery + read) can take a few seconds */
-#define TIME_TIMEOUT_MS  3000
-/* Number of timezones in movement_timezone_offsets array */
-#define NUM_MOVEMENT_TIMEZONES 41
+
+extern movement_state_t movement_state;
+
+static const uint8_t s_echo_bytes[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
+
+/*
+ * The commands below return as soon as their request is sent; these
+ * callbacks print the outcome from the main loop when it arrives, so
+ * the watch keeps running in the meantime.
+ */
+
+static bool prv_check_answer(ble_request_status_t status, uint8_t len, uint8_t expected_len) {
+    if (status == BLE_REQUEST_TIMEOUT) {
+        printf("ble: timeout\r\n");
+        return false;
+    }
+    if (status != BLE_REQUEST_OK) return false;
+    if (len != expected_len) {
+        printf("ble: unexpected len=%d\r\n", len);
+        return false;
+    }
+    return true;
+}
+
+static void prv_ping_done(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) context;
+    if (!prv_check_answer(status, len, 1)) return;
+    if (data[0] == 0xAC) {
+        printf("ble: pong\r\n");
+    } else {
+        printf("ble: unexpected ack 0x%02x\r\n", data[0]);
+    }
+}
+
+static void prv_echo_done(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    (void) seq;
+    (void) context;
+    if (!prv_check_answer(status, len, 4)) return;
+    printf("ble: echo %s: %02X %02X %02X %02X\r\n",
+           memcmp(data, s_echo_bytes, 4) == 0 ? "OK" : "MISMATCH",
+           data[0], data[1], data[2], data[3]);
+}
+
+static void prv_time_done(bool ok, int32_t offset_ms, void *context) {
+    (void) context;
+    if (!ok) {
+        printf("ble: time sync failed\r\n");
+        return;
+    }
+    watch_date_time dt = watch_rtc_get_date_time();
+    printf("ble: time %04d-%02d-%02d %02d:%02d:%02d, was off by %ld ms\r\n",
+           2020 + dt.unit.year, dt.unit.month, dt.unit.day,
+           dt.unit.hour, dt.unit.minute, dt.unit.second, offset_ms);
+    printf("ble: timezone %d min\r\n", movement_timezone_offsets[movement_state.settings.bit.time_zone]);
+}
+
+static void prv_baud_done(uint32_t baud, void *context) {
+    (void) context;
+    printf("ble: baud %lu\r\n", baud);
+}
+
+static int prv_request(uint8_t type, const uint8_t *data, uint8_t len, uint16_t timeout_ms, ble_request_cb_t callback) {
+    if (ble_request_send(type, data, len, timeout_ms, callback, NULL) == 0) {
+        printf("busy: too many requests outstanding\r\n");
+        return -1;
+    }
+    printf("sent\r\n");
+    return 0;
+}
 
 int shell_cmd_ble(int argc, char *argv[]) {
     if (argc < 2) return -2;
 
     const char *sub = argv[1];
 
-    /* ble ping — send CMD_PING, wait for ACK (05 01 AC) */
+    /* ble ping — send CMD_PING, expect ACK (05 01 AC) */
     if (strcmp(sub, "ping") == 0) {
-        uint8_t type = 0, data[BLE_TLV_MAX_LEN], len = 0;
-        ble_uart_send(BLE_CMD_PING, NULL, 0);
-        for (int ms = 0; ms < PING_TIMEOUT_MS; ms++) {
-            if (ble_uart_task(&type, data, &len)) {
-                if (type == BLE_CMD_PING && len == 1 && data[0] == 0xAC) {
-                    printf("pong\r\n");
-                } else {
-                    printf("unexpected: type=0x%02x len=%d\r\n", type, len);
-                }
-                return 0;
-            }
-            delay_ms(1);
-        }
-        printf("timeout\r\n");
-        return 0;
+        return prv_request(BLE_CMD_PING, NULL, 0, PING_TIMEOUT_MS, prv_ping_done);
     }
 
     /* ble on — start BLE advertising */
@@ -58,82 +117,36 @@ int shell_cmd_ble(int argc, char *argv[]) {
         return 0;
     }
 
-    /* ble time — request current time via CTS, apply to RTC on response */
+    /* ble time — sync the RTC to the phone's time via CTS now, instead of at the next background sync */
     if (strcmp(sub, "time") == 0) {
-        uint8_t type, data[BLE_TLV_MAX_LEN], len;
-        ble_uart_send(BLE_CMD_GET_TIME, NULL, 0);
-        printf("Waiting for time response (timeout in 3s)...\r\n");
-        for (int ms = 0; ms < TIME_TIMEOUT_MS; ms++) {
-            if (ble_uart_task(&type, data, &len)) {
-                printf("Received: type=0x%02x len=%d\r\n", type, len);
-                if (type == BLE_CMD_GET_TIME && len == 6) {
-                    watch_date_time dt;
-                    dt.reg = (uint32_t)data[0]
-                           | ((uint32_t)data[1] << 8)
-                           | ((uint32_t)data[2] << 16)
-                           | ((uint32_t)data[3] << 24);
-                    watch_rtc_set_date_time(dt);
-
-                    // Parse timezone from bytes 4-5 (int16_t, little-endian)
-                    int16_t tz_minutes = (int16_t)((uint16_t)data[4] | ((uint16_t)data[5] << 8));
-
-                    // Find closest match in movement_timezone_offsets[]
-                    uint8_t best_idx = 0;
-                    int16_t best_diff = 32767;
-                    extern const int16_t movement_timezone_offsets[];
-                    extern movement_state_t movement_state;
-                    for (uint8_t i = 0; i < NUM_MOVEMENT_TIMEZONES; i++) {
-                        int16_t diff = movement_timezone_offsets[i] - tz_minutes;
-                        if (diff < 0) diff = -diff;
-                        if (diff < best_diff) {
-                            best_diff = diff;
-                            best_idx = i;
-                        }
-                    }
-                    movement_state.settings.bit.time_zone = best_idx;
-
-                    printf("Rx time bytes: %02X %02X %02X %02X\r\n", data[0], data[1], data[2], data[3]);
-                    printf("%04d-%02d-%02d %02d:%02d:%02d\r\n",
-                           2020 + dt.unit.year, dt.unit.month, dt.unit.day,
-                           dt.unit.hour, dt.unit.minute, dt.unit.second);
-                    printf("Timezone: %d min (index %d)\r\n", tz_minutes, best_idx);
-                } else {
-                    printf("unexpected: type=0x%02x len=%d\r\n", type, len);
-                }
-                return 0;
-            }
-            delay_ms(1);
+        if (!ble_time_sync_now(prv_time_done, NULL)) {
+            printf("busy: sync already running\r\n");
+            return -1;
         }
-        printf("timeout\r\n");
+        printf("sent\r\n");
         return 0;
     }
 
-    /* ble echo — send 4 test bytes, verify the nRF echoes them back */
-    if (strcmp(sub, "echo") == 0) {
-        static const uint8_t test_bytes[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
-        uint8_t type = 0, data[BLE_TLV_MAX_LEN], len = 0;
-        ble_uart_send(BLE_CMD_ECHO, test_bytes, 4);
-        for (int ms = 0; ms < PING_TIMEOUT_MS; ms++) {
-            if (ble_uart_task(&type, data, &len)) {
-                if (type == BLE_CMD_ECHO && len == 4) {
-                    if (memcmp(data, test_bytes, 4) == 0) {
-                        printf("echo OK: %02X %02X %02X %02X\r\n",
-                               data[0], data[1], data[2], data[3]);
-                    } else {
-                        printf("echo MISMATCH: got %02X %02X %02X %02X\r\n",
-                               data[0], data[1], data[2], data[3]);
-                    }
-                } else {
-                    printf("unexpected: type=0x%02x len=%d\r\n", type, len);
-                }
-                return 0;
-            }
-            delay_ms(1);
+    /* ble sync [reset] — time sync and drift estimate; reset forgets the syncs collected so far */
+    if (strcmp(sub, "sync") == 0) {
+        if (argc >= 3 && strcmp(argv[2], "reset") == 0) {
+            ble_time_sync_reset();
+            return 0;
         }
-        printf("timeout\r\n");
+        ble_time_sync_status_t status;
+        ble_time_sync_get_status(&status);
+        printf("syncs %lu, failures %lu, last offset %ld ms\r\n",
+               status.syncs, status.failures, status.last_offset_ms);
+        printf("drift %ld ppb, freqcorr %d, %d samples over %lu s\r\n",
+               status.drift_ppb, status.freqcorr, status.samples, status.span_s);
         return 0;
     }
 
+    /* ble echo — send 4 test bytes, verify the nRF echoes them back */
+    if (strcmp(sub, "echo") == 0) {
+        return prv_request(BLE_CMD_ECHO, s_echo_bytes, 4, PING_TIMEOUT_MS, prv_echo_done);
+    }
+
     /* ble bonds — clear all BLE bonds */
     if (strcmp(sub, "bonds") == 0) {
         ble_uart_send(BLE_CMD_CLEAR_BONDS, NULL, 0);
@@ -141,14 +154,128 @@ int shell_cmd_ble(int argc, char *argv[]) {
         return 0;
     }
 
-    /* ble str <text> — send ASCII string as HID keypresses */
+    /* ble stats — receive counters, and what bringing the UART up and parking it costs */
+    if (strcmp(sub, "stats") == 0) {
+        ble_uart_stats_t stats;
+        ble_uart_get_stats(&stats);
+        uint32_t cycles_per_us = watch_get_cpu_frequency() / 1000000;
+        printf("frames %lu, pending %d, overruns %lu, crc errors %lu, length errors %lu, uart dropped %lu\r\n",
+               stats.frames, ble_uart_frames_pending(), stats.overruns,
+               stats.crc_errors, stats.length_errors, stats.uart_dropped);
+        printf("%s, wakes %lu (%lu by rx), last wake %lu us, last park %lu us\r\n",
+               ble_uart_is_awake() ? "awake" : "parked", stats.wakes, stats.rx_wakes,
+               stats.wake_cycles / cycles_per_us, stats.park_cycles / cycles_per_us);
+        return 0;
+    }
+
+    /* ble baud [rate] — show the link rate, or negotiate the fastest one up to rate */
+    if (strcmp(sub, "baud") == 0) {
+        if (argc < 3) {
+            printf("%lu\r\n", ble_uart_get_baud());
+            return 0;
+        }
+        if (!ble_link_negotiate_baud(strtoul(argv[2], NULL, 10), prv_baud_done, NULL)) {
+            printf("busy: negotiation already running\r\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    /* ble str <text...> — queue ASCII text to be typed as HID keypresses */
     if (strcmp(sub, "str") == 0) {
         if (argc < 3) return -2;
-        const char *text = argv[2];
-        uint8_t len = (uint8_t)strlen(text);
-        if (len > BLE_TLV_MAX_LEN) len = BLE_TLV_MAX_LEN;
-        ble_uart_send(BLE_CMD_SEND_STRING, (const uint8_t *)text, len);
-        printf("sent %d chars\r\n", len);
+        size_t queued = 0;
+        for (int i = 2; i < argc; i++) {
+            if (i > 2) queued += ble_hid_type(" ");
+            queued += ble_hid_type(argv[i]);
+        }
+        ble_hid_stats_t stats;
+        ble_hid_get_stats(&stats);
+        printf("queued %d chars, depth %d\r\n", queued, stats.depth);
+        return 0;
+    }
+
+    /* ble hid [cancel] — typing queue and throughput; cancel drops what hasn't been typed */
+    if (strcmp(sub, "hid") == 0) {
+        if (argc >= 3 && strcmp(argv[2], "cancel") == 0) {
+            ble_hid_cancel();
+            return 0;
+        }
+        ble_hid_stats_t stats;
+        ble_hid_get_stats(&stats);
+        printf("depth %d (max %d), typed %lu in %lu chunks, dropped %lu\r\n",
+               stats.depth, stats.max_depth, stats.typed, stats.chunks, stats.dropped);
+        if (stats.unacked) printf("nRF doesn't ack; typing without waiting\r\n");
+        printf("last burst %lu chars in %lu ms, %lu chars/s\r\n", stats.last_chars, stats.last_ms,
+               stats.last_ms ? stats.last_chars * 1000 / stats.last_ms : 0);
+        return 0;
+    }
+
+    /* ble notify [clear] — list the mirrored notifications, newest first; clear forgets them */
+    if (strcmp(sub, "notify") == 0) {
+        if (argc >= 3 && strcmp(argv[2], "clear") == 0) {
+            ble_notify_clear();
+            return 0;
+        }
+        ble_notify_stats_t stats;
+        ble_notify_get_stats(&stats);
+        printf("%d kept, %lu received, %lu saved to flash, %lu lost, %d unread\r\n",
+               ble_notify_count(), stats.received, stats.spilled, stats.lost, stats.unread);
+        ble_notification_t notification;
+        for (uint16_t i = 0; ble_notify_get(i, &notification); i++) {
+            printf("%3d  app %3d  %s\r\n", i, notification.app, notification.text);
+        }
+        return 0;
+    }
+
+    /* ble export [FILE [OFFSET] | cancel | on | off] — send a file to the phone, let the phone ask for
+     * them or not, or show how the transfer is going */
+    if (strcmp(sub, "export") == 0) {
+        if (argc >= 3 && strcmp(argv[2], "cancel") == 0) {
+            ble_export_cancel();
+            return 0;
+        }
+        if (argc >= 3 && strcmp(argv[2], "on") == 0) {
+            ble_export_set_enabled(true);
+            return 0;
+        }
+        if (argc >= 3 && strcmp(argv[2], "off") == 0) {
+            ble_export_set_enabled(false);
+            return 0;
+        }
+        if (argc >= 3) {
+            uint32_t offset = (argc >= 4) ? strtoul(argv[3], NULL, 10) : 0;
+            if (!ble_export_start(argv[2], offset)) {
+                printf("export: %s\r\n", ble_export_busy() ? "busy" : "not allowed or no such file");
+                return -1;
+            }
+            return 0;
+        }
+        static const char *states[] = { "idle", "running", "done", "failed", "stopped" };
+        ble_export_status_t status;
+        ble_export_get_status(&status);
+        printf("phone requests %s\r\n", ble_export_enabled() ? "on" : "off");
+        printf("%s %s: %lu of %lu bytes (from %lu), window %d\r\n", states[status.state], status.file,
+               status.acked, status.size, status.start, status.window);
+        printf("%lu chunks, %lu resent, %lu timeouts, %lu ms, %lu bytes/s\r\n", status.chunks,
+               status.resends, status.timeouts, status.elapsed_ms, status.bytes_per_s);
+        return 0;
+    }
+
+    /* ble remote [on|off|clear] — let the phone press buttons or not, or drop what it has queued */
+    if (strcmp(sub, "remote") == 0) {
+        if (argc >= 3) {
+            if (strcmp(argv[2], "on") == 0) ble_remote_set_enabled(true);
+            else if (strcmp(argv[2], "off") == 0) ble_remote_set_enabled(false);
+            else if (strcmp(argv[2], "clear") == 0) ble_remote_clear();
+            else return -2;
+            return 0;
+        }
+        ble_remote_stats_t stats;
+        ble_remote_get_stats(&stats);
+        printf("%s, depth %d (max %d), %lu received, %lu delivered, %lu dropped\r\n",
+               ble_remote_enabled() ? "on" : "off", stats.depth, stats.max_depth,
+               stats.received, stats.delivered, stats.dropped);
         return 0;
     }
 
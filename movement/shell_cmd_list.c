@@ -24,11 +24,16 @@
 
 #include "shell_cmd_list.h"
 
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "filesystem.h"
+#include "movement_log.h"
+#include "shell.h"
+#include "shell_config.h"
 #include "watch.h"
 
 static int help_cmd(int argc, char *argv[]);
@@ -36,10 +41,13 @@ static int flash_cmd(int argc, char *argv[]);
 static int stress_cmd(int argc, char *argv[]);
 static int settime_cmd(int argc, char *argv[]);
 static int gettime_cmd(int argc, char *argv[]);
+static int time_cmd(int argc, char *argv[]);
+static int source_cmd(int argc, char *argv[]);
 extern int shell_cmd_backend_status(int argc, char *argv[]);
 extern int shell_cmd_backend_switch(int argc, char *argv[]);
 extern int shell_cmd_ble(int argc, char *argv[]);
 
+// Keep this table sorted by name (case-insensitive); the shell looks commands up by binary search.
 shell_command_t g_shell_commands[] = {
     {
         .name = "?",
@@ -49,25 +57,25 @@ shell_command_t g_shell_commands[] = {
         .cb = help_cmd,
     },
     {
-        .name = "help",
-        .help = "print command list",
+        .name = "asset",
+        .help = "usage: asset [add NAME FILE | clear] - read-only assets in flash",
         .min_args = 0,
-        .max_args = 0,
-        .cb = help_cmd,
+        .max_args = 3,
+        .cb = filesystem_cmd_asset,
     },
     {
-        .name = "flash",
-        .help = "reboot to UF2 bootloader",
+        .name = "backend",
+        .help = "show current shell backend status",
         .min_args = 0,
         .max_args = 0,
-        .cb = flash_cmd,
+        .cb = shell_cmd_backend_status,
     },
     {
-        .name = "ls",
-        .help = "usage: ls [PATH]",
-        .min_args = 0,
-        .max_args = 1,
-        .cb = filesystem_cmd_ls,
+        .name = "ble",
+        .help = "usage: ble <ping|on|off|time|bonds|stats|sync [reset]|baud [RATE]|str TEXT|hid [cancel]|notify [clear]|export [FILE [OFFSET]|cancel|on|off]|remote [on|off|clear]|key CODE [MOD]>",
+        .min_args = 1,
+        .max_args = 15,
+        .cb = shell_cmd_ble,
     },
     {
         .name = "cat",
@@ -78,38 +86,87 @@ shell_command_t g_shell_commands[] = {
     },
     {
         .name = "df",
-        .help = "print filesystem free space",
+        .help = "usage: df [PATH] - print filesystem free space",
         .min_args = 0,
-        .max_args = 0,
+        .max_args = 1,
         .cb = filesystem_cmd_df,
     },
     {
-        .name = "rm",
-        .help = "usage: rm [PATH]",
+        .name = "echo",
+        .help = "usage: echo TEXT {>,>>} FILE",
+        .min_args = 3,
+        .max_args = 3,
+        .cb = filesystem_cmd_echo,
+    },
+    {
+        .name = "flash",
+        .help = "reboot to UF2 bootloader",
+        .min_args = 0,
+        .max_args = 0,
+        .cb = flash_cmd,
+    },
+    {
+        .name = "format",
+        .help = "usage: format [/ext] YES",
         .min_args = 1,
+        .max_args = 2,
+        .cb = filesystem_cmd_format,
+    },
+    {
+        .name = "fsstat",
+        .help = "usage: fsstat [reset|save] - flash wear and latency counters",
+        .min_args = 0,
         .max_args = 1,
-        .cb = filesystem_cmd_rm,
+        .cb = filesystem_cmd_fsstat,
     },
     {
-        .name = "format",
-        .help = "usage: format YES",
+        .name = "get",
+        .help = "usage: get PATH - print a file as base64 lines, then \"end SIZE CRC\"",
         .min_args = 1,
         .max_args = 1,
-        .cb = filesystem_cmd_format,
+        .cb = filesystem_cmd_get,
     },
     {
-        .name = "echo",
-        .help = "usage: echo TEXT {>,>>} FILE",
+        .name = "gettime",
+        .help = "get RTC time",
+        .min_args = 0,
+        .max_args = 0,
+        .cb = gettime_cmd,
+    },
+    {
+        .name = "help",
+        .help = "print command list",
+        .min_args = 0,
+        .max_args = 0,
+        .cb = help_cmd,
+    },
+    {
+        .name = "log",
+        .help = "usage: log [clear] - print and empty the log, or just empty it",
+        .min_args = 0,
+        .max_args = 1,
+        .cb = movement_log_cmd,
+    },
+    {
+        .name = "ls",
+        .help = "usage: ls [PATH]",
+        .min_args = 0,
+        .max_args = 1,
+        .cb = filesystem_cmd_ls,
+    },
+    {
+        .name = "put",
+        .help = "usage: put PATH SIZE CRC - then send the file as base64 lines; \".\" aborts",
         .min_args = 3,
         .max_args = 3,
-        .cb = filesystem_cmd_echo,
+        .cb = filesystem_cmd_put,
     },
     {
-        .name = "stress",
-        .help = "test CDC write; usage: stress [LEN] [DELAY_MS]",
-        .min_args = 0,
-        .max_args = 2,
-        .cb = stress_cmd,
+        .name = "rm",
+        .help = "usage: rm [PATH]",
+        .min_args = 1,
+        .max_args = 1,
+        .cb = filesystem_cmd_rm,
     },
     {
         .name = "settime",
@@ -119,18 +176,18 @@ shell_command_t g_shell_commands[] = {
         .cb = settime_cmd,
     },
     {
-        .name = "gettime",
-        .help = "get RTC time",
-        .min_args = 0,
-        .max_args = 0,
-        .cb = gettime_cmd,
+        .name = "source",
+        .help = "usage: source PATH - run the shell commands in a file, e.g. " SHELL_AUTOEXEC_FILE,
+        .min_args = 1,
+        .max_args = 1,
+        .cb = source_cmd,
     },
     {
-        .name = "backend",
-        .help = "show current shell backend status",
+        .name = "stress",
+        .help = "usage: stress [tx|rx] [BYTES] [TIMEOUT_MS] - benchmark the active backend with patterned data",
         .min_args = 0,
-        .max_args = 0,
-        .cb = shell_cmd_backend_status,
+        .max_args = 3,
+        .cb = stress_cmd,
     },
     {
         .name = "switch",
@@ -140,11 +197,11 @@ shell_command_t g_shell_commands[] = {
         .cb = shell_cmd_backend_switch,
     },
     {
-        .name = "ble",
-        .help = "usage: ble <ping|on|off|time|bonds|str TEXT|key CODE [MOD]>",
+        .name = "time",
+        .help = "usage: time CMD [ARGS] - run a command and print how long it took (up to 2 s)",
         .min_args = 1,
-        .max_args = 3,
-        .cb = shell_cmd_ble,
+        .max_args = 15,
+        .cb = time_cmd,
     },
 };
 
@@ -173,35 +230,122 @@ static int flash_cmd(int argc, char *argv[]) {
     return 0;
 }
 
-#define STRESS_CMD_MAX_LEN  (512)
-static int stress_cmd(int argc, char *argv[]) {
-    char test_str[STRESS_CMD_MAX_LEN+1] = {0};
+// The benchmark pattern: printable, so a terminal can show it, and not periodic, so a dropped or
+// repeated block doesn't line up with the expected data. Byte i is '!' plus the top byte of
+// i * 2654435761, modulo 94.
+static char prv_stress_pattern(uint32_t i) {
+    return '!' + ((i * 2654435761u) >> 24) % 94;
+}
 
-    int max_len = 512;
-    int delay = 0;
+// watch_get_cycle_count wraps every two to four seconds, so the benchmark accumulates the
+// difference between readings, which it takes far more often than that.
+static uint32_t s_stress_last_count;
+static uint64_t s_stress_cycles;
 
-    if (argc >= 2) {
-        if ((max_len = atoi(argv[1])) == 0) {
-            return -1;
-        }
-        if (max_len > 512) {
-            return -1;
+static void prv_stress_clock_start(void) {
+    s_stress_last_count = watch_get_cycle_count();
+    s_stress_cycles = 0;
+}
+
+static uint32_t prv_stress_clock_us(void) {
+    uint32_t count = watch_get_cycle_count();
+    s_stress_cycles += (count - s_stress_last_count) & 0xFFFFFF;
+    s_stress_last_count = count;
+    return s_stress_cycles / (watch_get_cpu_frequency() / 1000000);
+}
+
+static uint32_t prv_stress_rate(uint32_t bytes, uint32_t us) {
+    return us ? (uint64_t)bytes * 1000000 / us : 0;
+}
+
+#define STRESS_CMD_CHUNK (64)
+static int prv_stress_tx(uint32_t length) {
+    char chunk[STRESS_CMD_CHUNK];
+    uint32_t max_stall = 0;
+
+    // the markers and reports go the payload's way, since plain printf always goes to USB.
+    shell_backend_printf("start\r\n");
+    shell_backend_flush();
+    prv_stress_clock_start();
+    for (uint32_t sent = 0; sent < length;) {
+        size_t n = min(length - sent, STRESS_CMD_CHUNK);
+        for (size_t i = 0; i < n; i++) {
+            chunk[i] = prv_stress_pattern(sent + i);
         }
+        // a write only takes long when it has to wait for the transport to make room.
+        uint32_t before = prv_stress_clock_us();
+        shell_backend_write(chunk, n);
+        uint32_t stall = prv_stress_clock_us() - before;
+        max_stall = max(max_stall, stall);
+        sent += n;
     }
+    shell_backend_flush();
+    uint32_t us = prv_stress_clock_us();
 
-    if (argc >= 3) {
-        delay = atoi(argv[2]);
+    shell_backend_printf("\r\ntx %" PRIu32 " bytes in %" PRIu32 " us, %" PRIu32 " bytes/s, max stall %" PRIu32 " us\r\n",
+                         length, us, prv_stress_rate(length, us), max_stall);
+    return 0;
+}
+
+static int prv_stress_rx(uint32_t length, uint32_t timeout_ms) {
+    uint32_t received = 0;
+    uint32_t corrupt = 0;
+    uint32_t max_gap = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+
+    shell_backend_printf("ready\r\n");
+    shell_backend_flush();
+    prv_stress_clock_start();
+    while (received < length) {
+        uint32_t now = prv_stress_clock_us();
+        int c = shell_backend_getchar();
+        if (c < 0) {
+            // give up after timeout_ms without a byte, including while waiting for the first one.
+            if (now - last > timeout_ms * 1000) {
+                break;
+            }
+            continue;
+        }
+        if (received == 0 && (c == '\r' || c == '\n')) {
+            // the rest of the line ending that ran this command; the pattern has no control characters.
+            continue;
+        }
+        if (received == 0) {
+            first = now;
+        } else {
+            max_gap = max(max_gap, now - last);
+        }
+        last = now;
+        if (c != prv_stress_pattern(received)) {
+            corrupt++;
+        }
+        received++;
     }
+    uint32_t us = last - first;
+
+    shell_backend_printf("rx %" PRIu32 "/%" PRIu32 " bytes in %" PRIu32 " us, %" PRIu32 " bytes/s, %" PRIu32 " corrupt, "
+                         "%" PRIu32 " dropped, max gap %" PRIu32 " us\r\n", received, length, us,
+                         prv_stress_rate(received, us), corrupt, length - received, max_gap);
+    return (received == length && corrupt == 0) ? 0 : -1;
+}
 
-    for (int i = 0; i < max_len; i++) {
-        snprintf(&test_str[i], 2, "%u", (i+1)%10);
-        printf("%u:\t%s\r\n", (i+1), test_str);
-        if (delay > 0) {
-            delay_ms(delay);
+static int stress_cmd(int argc, char *argv[]) {
+    uint32_t length = 4096;
+    if (argc >= 3) {
+        length = strtoul(argv[2], NULL, 10);
+        if (length == 0) {
+            return -2;
         }
     }
 
-    return 0;
+    if (argc >= 2 && strcmp(argv[1], "rx") == 0) {
+        uint32_t timeout_ms = (argc >= 4) ? strtoul(argv[3], NULL, 10) : 2000;
+        return prv_stress_rx(length, timeout_ms);
+    } else if (argc < 2 || strcmp(argv[1], "tx") == 0) {
+        return prv_stress_tx(length);
+    }
+    return -2;
 }
 
 static int settime_cmd(int argc, char *argv[]) {
@@ -238,3 +382,22 @@ static int gettime_cmd(int argc, char *argv[]) {
             date_time.unit.second);
     return 0;
 }
+
+static int time_cmd(int argc, char *argv[]) {
+    uint32_t start = watch_get_cycle_count();
+    int ret = shell_run_command(argc - 1, &argv[1]);
+    // count the time to hand the output to the backend, not just to format it.
+    shell_backend_flush();
+    uint32_t cycles = (watch_get_cycle_count() - start) & 0xFFFFFF;
+    printf("\r\n%s: %lu us\r\n", argv[1], cycles / (watch_get_cpu_frequency() / 1000000));
+    return ret;
+}
+
+static int source_cmd(int argc, char *argv[]) {
+    (void) argc;
+    if (!shell_run_script(argv[1])) {
+        printf("source: can't run %s\r\n", argv[1]);
+        return -1;
+    }
+    return 0;
+}
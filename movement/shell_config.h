@@ -62,9 +62,44 @@
 #define SHELL_PREFERRED_BACKEND SHELL_BACKEND_USB_CDC
 #endif
 
-/** @brief Size of UART input buffer (must be power of 2, default: 64) */
-#ifndef SHELL_UART_READ_BUF_SZ
-#define SHELL_UART_READ_BUF_SZ 64
+/** @brief Most commands run by one shell_task call when several lines arrive at once (default: 16) */
+#ifndef SHELL_MAX_COMMANDS_PER_TASK
+#define SHELL_MAX_COMMANDS_PER_TASK 16
+#endif
+
+/** @brief Largest payload of a binary RPC frame, in bytes (default: 512) */
+#ifndef SHELL_RPC_MAX_PAYLOAD
+#define SHELL_RPC_MAX_PAYLOAD 512
+#endif
+
+/** @brief Number of shell_task calls without input after which a partial RPC frame is dropped (default: 256) */
+#ifndef SHELL_RPC_TIMEOUT_POLLS
+#define SHELL_RPC_TIMEOUT_POLLS 256
+#endif
+
+/** @brief Number of command lines kept for recall with the up and down arrow keys (default: 8) */
+#ifndef SHELL_HISTORY_DEPTH
+#define SHELL_HISTORY_DEPTH 8
+#endif
+
+/** @brief Longest command line kept in the history, including its terminator (default: 64) */
+#ifndef SHELL_HISTORY_LINE_SZ
+#define SHELL_HISTORY_LINE_SZ 64
+#endif
+
+/** @brief Script of shell commands run at startup and on connect (default: /autoexec.sh) */
+#ifndef SHELL_AUTOEXEC_FILE
+#define SHELL_AUTOEXEC_FILE "/autoexec.sh"
+#endif
+
+/** @brief Run SHELL_AUTOEXEC_FILE when the shell starts, if it exists (default: enabled) */
+#ifndef SHELL_AUTOEXEC_ON_BOOT
+#define SHELL_AUTOEXEC_ON_BOOT 1
+#endif
+
+/** @brief Run SHELL_AUTOEXEC_FILE each time a terminal opens the USB serial port (default: disabled) */
+#ifndef SHELL_AUTOEXEC_ON_CONNECT
+#define SHELL_AUTOEXEC_ON_CONNECT 0
 #endif
 
 #endif
@@ -0,0 +1,317 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "shell_rpc.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "watch.h"
+#include "watch_utility.h"
+#include "filesystem.h"
+#include "movement_log.h"
+#include "shell_backend.h"
+#include "shell_config.h"
+
+#define SHELL_RPC_MAX_PATH (64)
+
+typedef enum {
+    RPC_STATE_IDLE = 0,
+    RPC_STATE_COMMAND,
+    RPC_STATE_SEQUENCE,
+    RPC_STATE_LENGTH_LO,
+    RPC_STATE_LENGTH_HI,
+    RPC_STATE_PAYLOAD,
+    RPC_STATE_CRC_LO,
+    RPC_STATE_CRC_HI,
+} rpc_state_t;
+
+static rpc_state_t s_state = RPC_STATE_IDLE;
+static uint8_t s_command;
+static uint8_t s_sequence;
+static uint16_t s_length;
+static uint16_t s_received;
+static uint16_t s_crc;
+static uint16_t s_frame_crc;
+static uint16_t s_idle_polls;
+static uint8_t s_payload[SHELL_RPC_MAX_PAYLOAD];
+
+static uint16_t s_tx_crc;
+
+static uint16_t prv_get_u16(const uint8_t *p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t prv_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void prv_put_u32(uint8_t *p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static void prv_send(const uint8_t *data, size_t length) {
+    s_tx_crc = watch_utility_crc16(data, length, s_tx_crc);
+    shell_backend_write((const char *)data, length);
+}
+
+// Sends the header and status byte of a response; data_length bytes of data must follow.
+static void prv_reply_begin(uint8_t command, shell_rpc_status_t status, uint16_t data_length) {
+    uint16_t length = data_length + 1;
+    uint8_t header[6] = {SHELL_RPC_SYNC, command | SHELL_RPC_RESPONSE, s_sequence, length & 0xFF, length >> 8, status};
+    // the sync byte isn't covered by the CRC.
+    s_tx_crc = watch_utility_crc16(&header[1], sizeof(header) - 1, 0xFFFF);
+    shell_backend_write((const char *)header, sizeof(header));
+}
+
+static void prv_reply_end(void) {
+    uint8_t crc[2] = {s_tx_crc & 0xFF, s_tx_crc >> 8};
+    shell_backend_write((const char *)crc, sizeof(crc));
+    shell_backend_flush();
+}
+
+static void prv_reply(shell_rpc_status_t status, const uint8_t *data, uint16_t length) {
+    prv_reply_begin(s_command, status, length);
+    prv_send(data, length);
+    prv_reply_end();
+}
+
+// Copies a path out of the payload, which may or may not include the NUL terminator, so the
+// payload buffer can be reused for file data.
+static bool prv_get_path(char *path, const uint8_t *src, size_t length) {
+    size_t path_length = strnlen((const char *)src, length);
+    if (path_length == 0 || path_length >= SHELL_RPC_MAX_PATH) {
+        return false;
+    }
+    memcpy(path, src, path_length);
+    path[path_length] = '\0';
+    return true;
+}
+
+static void prv_cmd_file_read(void) {
+    char path[SHELL_RPC_MAX_PATH];
+    if (s_length < 7 || !prv_get_path(path, &s_payload[6], s_length - 6)) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    int32_t offset = prv_get_u32(&s_payload[0]);
+    int32_t length = min(prv_get_u16(&s_payload[4]), SHELL_RPC_MAX_PAYLOAD - 1);
+    if (!filesystem_file_exists(path)) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    int32_t result = filesystem_read_file_at(path, offset, (char *)s_payload, length);
+    if (result < 0) {
+        prv_reply(SHELL_RPC_ERR_IO, NULL, 0);
+        return;
+    }
+    prv_reply(SHELL_RPC_OK, s_payload, result);
+}
+
+static void prv_cmd_file_write(void) {
+    char path[SHELL_RPC_MAX_PATH];
+    if (s_length < 5 || !prv_get_path(path, &s_payload[4], s_length - 4)) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    int32_t offset = prv_get_u32(&s_payload[0]);
+    size_t data_start = 4 + strlen(path) + 1;
+    if (data_start > s_length) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    char *data = (char *)&s_payload[data_start];
+    int32_t length = s_length - data_start;
+
+    // offset 0 replaces the file; any other offset must be the end of the file, so chunks are
+    // written in order and a retried chunk can't be appended twice.
+    bool success;
+    if (offset == 0) {
+        success = filesystem_write_file(path, data, length);
+    } else if (filesystem_get_file_size(path) == offset) {
+        success = length == 0 || filesystem_append_file(path, data, length);
+    } else {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    prv_reply(success ? SHELL_RPC_OK : SHELL_RPC_ERR_IO, NULL, 0);
+}
+
+static void prv_cmd_file_stat(void) {
+    char path[SHELL_RPC_MAX_PATH];
+    if (!prv_get_path(path, s_payload, s_length)) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    int32_t size = filesystem_get_file_size(path);
+    if (size < 0) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    uint8_t data[4];
+    prv_put_u32(data, size);
+    prv_reply(SHELL_RPC_OK, data, sizeof(data));
+}
+
+static void prv_cmd_file_remove(void) {
+    char path[SHELL_RPC_MAX_PATH];
+    // filesystem_rm complains about missing files on stdout, which would land in the middle of a frame.
+    if (!prv_get_path(path, s_payload, s_length) || !filesystem_file_exists(path)) {
+        prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+        return;
+    }
+    prv_reply(filesystem_rm(path) ? SHELL_RPC_OK : SHELL_RPC_ERR_IO, NULL, 0);
+}
+
+static void prv_handle_frame(void) {
+    uint8_t data[32];
+
+    switch (s_command) {
+        case SHELL_RPC_CMD_PING:
+            prv_reply(SHELL_RPC_OK, s_payload, min(s_length, SHELL_RPC_MAX_PAYLOAD - 1));
+            break;
+        case SHELL_RPC_CMD_INFO:
+            data[0] = SHELL_RPC_VERSION;
+            data[1] = SHELL_RPC_MAX_PAYLOAD & 0xFF;
+            data[2] = SHELL_RPC_MAX_PAYLOAD >> 8;
+            prv_reply(SHELL_RPC_OK, data, 3);
+            break;
+        case SHELL_RPC_CMD_FILE_READ:
+            prv_cmd_file_read();
+            break;
+        case SHELL_RPC_CMD_FILE_WRITE:
+            prv_cmd_file_write();
+            break;
+        case SHELL_RPC_CMD_FILE_STAT:
+            prv_cmd_file_stat();
+            break;
+        case SHELL_RPC_CMD_FILE_REMOVE:
+            prv_cmd_file_remove();
+            break;
+        case SHELL_RPC_CMD_RTC_GET:
+            prv_put_u32(data, watch_rtc_get_date_time().reg);
+            prv_reply(SHELL_RPC_OK, data, 4);
+            break;
+        case SHELL_RPC_CMD_RTC_SET:
+            if (s_length != 4) {
+                prv_reply(SHELL_RPC_ERR_BAD_ARGS, NULL, 0);
+                break;
+            }
+            watch_date_time date_time;
+            date_time.reg = prv_get_u32(s_payload);
+            watch_rtc_set_date_time(date_time);
+            prv_reply(SHELL_RPC_OK, NULL, 0);
+            break;
+        case SHELL_RPC_CMD_BACKUP_DUMP:
+            for (uint8_t reg = 0; reg < 8; reg++) {
+                prv_put_u32(&data[reg * 4], watch_get_backup_data(reg));
+            }
+            prv_reply(SHELL_RPC_OK, data, 32);
+            break;
+        case SHELL_RPC_CMD_LOG_READ:
+            // an empty reply means the log has been drained.
+            prv_reply(SHELL_RPC_OK, s_payload, movement_log_read((char *)s_payload, SHELL_RPC_MAX_PAYLOAD - 1));
+            break;
+        default:
+            prv_reply(SHELL_RPC_ERR_UNKNOWN_COMMAND, NULL, 0);
+            break;
+    }
+}
+
+bool shell_rpc_receiving(void) {
+    return s_state != RPC_STATE_IDLE;
+}
+
+bool shell_rpc_feed(uint8_t byte) {
+    s_idle_polls = 0;
+
+    switch (s_state) {
+        case RPC_STATE_IDLE:
+            if (byte == SHELL_RPC_SYNC) {
+                s_crc = 0xFFFF;
+                s_state = RPC_STATE_COMMAND;
+            }
+            return false;
+        case RPC_STATE_CRC_LO:
+            s_frame_crc = byte;
+            s_state = RPC_STATE_CRC_HI;
+            return false;
+        case RPC_STATE_CRC_HI:
+            s_frame_crc |= (uint16_t)byte << 8;
+            s_state = RPC_STATE_IDLE;
+            if (s_frame_crc != s_crc) {
+                prv_reply_begin(SHELL_RPC_CMD_ERROR, SHELL_RPC_ERR_CRC, 0);
+                prv_reply_end();
+            } else if (s_length > SHELL_RPC_MAX_PAYLOAD) {
+                prv_reply(SHELL_RPC_ERR_TOO_LONG, NULL, 0);
+            } else {
+                prv_handle_frame();
+            }
+            return true;
+        default:
+            break;
+    }
+
+    s_crc = watch_utility_crc16(&byte, 1, s_crc);
+    switch (s_state) {
+        case RPC_STATE_COMMAND:
+            s_command = byte;
+            s_state = RPC_STATE_SEQUENCE;
+            break;
+        case RPC_STATE_SEQUENCE:
+            s_sequence = byte;
+            s_state = RPC_STATE_LENGTH_LO;
+            break;
+        case RPC_STATE_LENGTH_LO:
+            s_length = byte;
+            s_state = RPC_STATE_LENGTH_HI;
+            break;
+        case RPC_STATE_LENGTH_HI:
+            s_length |= (uint16_t)byte << 8;
+            s_received = 0;
+            s_state = s_length ? RPC_STATE_PAYLOAD : RPC_STATE_CRC_LO;
+            break;
+        case RPC_STATE_PAYLOAD:
+            // an oversized payload is still read to the end, so its bytes don't spill into the text shell.
+            if (s_received < SHELL_RPC_MAX_PAYLOAD) {
+                s_payload[s_received] = byte;
+            }
+            if (++s_received == s_length) {
+                s_state = RPC_STATE_CRC_LO;
+            }
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+void shell_rpc_poll(void) {
+    if (s_state != RPC_STATE_IDLE && ++s_idle_polls > SHELL_RPC_TIMEOUT_POLLS) {
+        s_state = RPC_STATE_IDLE;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHELL_RPC_H_
+#define SHELL_RPC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Binary RPC channel that shares the shell's backend with the text shell.
+ *
+ * A frame starts with SHELL_RPC_SYNC at the beginning of a line, which can't be typed at the
+ * prompt, so the shell hands every byte from there to the end of the frame to this module.
+ * All multi-byte fields are little-endian:
+ *
+ *   sync (0xA5) | command | sequence | length (2) | payload (length) | crc (2)
+ *
+ * The CRC is CRC-16/CCITT-FALSE over command, sequence, length and payload. Every request gets
+ * exactly one response with command | 0x80, the same sequence number, and a payload whose first
+ * byte is a shell_rpc_status_t. See SHELL_RPC.md for the payload of each command.
+ */
+
+#define SHELL_RPC_SYNC 0xA5
+#define SHELL_RPC_RESPONSE 0x80
+#define SHELL_RPC_VERSION 1
+
+typedef enum {
+    SHELL_RPC_CMD_PING = 0x01,          // echoes the payload back
+    SHELL_RPC_CMD_INFO = 0x02,          // protocol version and maximum payload size
+    SHELL_RPC_CMD_FILE_READ = 0x10,     // offset (4), length (2), path
+    SHELL_RPC_CMD_FILE_WRITE = 0x11,    // offset (4), path, NUL, data
+    SHELL_RPC_CMD_FILE_STAT = 0x12,     // path
+    SHELL_RPC_CMD_FILE_REMOVE = 0x13,   // path
+    SHELL_RPC_CMD_RTC_GET = 0x20,
+    SHELL_RPC_CMD_RTC_SET = 0x21,       // watch_date_time register value (4)
+    SHELL_RPC_CMD_BACKUP_DUMP = 0x30,   // all eight RTC backup registers
+    SHELL_RPC_CMD_LOG_READ = 0x31,      // drains the oldest log records as text
+    SHELL_RPC_CMD_ERROR = 0x7F,         // only sent, as the reply to a frame that failed its CRC
+} shell_rpc_command_t;
+
+typedef enum {
+    SHELL_RPC_OK = 0,
+    SHELL_RPC_ERR_CRC,
+    SHELL_RPC_ERR_UNKNOWN_COMMAND,
+    SHELL_RPC_ERR_BAD_ARGS,
+    SHELL_RPC_ERR_IO,
+    SHELL_RPC_ERR_TOO_LONG,
+} shell_rpc_status_t;
+
+/** @brief Returns true while a frame is partially received, i.e. the next byte belongs to it. */
+bool shell_rpc_receiving(void);
+
+/** @brief Feeds one received byte to the frame parser.
+ *  @return true if the byte completed a frame, which has been handled and answered.
+ */
+bool shell_rpc_feed(uint8_t byte);
+
+/** @brief Called once per shell_task; drops a frame whose bytes stopped arriving. */
+void shell_rpc_poll(void);
+
+#endif
@@ -0,0 +1,421 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The stand-in keeps its own TLV parser and CRC rather than sharing the watch's, so that the two
+// ends can't agree with each other by accident.
+
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ble_nrf_stub.h"
+#include "ble_uart.h"
+#include "ble_export.h"
+
+#define NRF_STUB_PING_ACK       0xAC
+#define NRF_STUB_FALLBACK_MS    1000  // back to the old rate without a valid frame at the new one
+#define NRF_STUB_QUIET_MS       100   // send a wake byte before a frame after this long
+
+typedef enum { STUB_TYPE, STUB_LENGTH, STUB_VALUE, STUB_CRC_LO, STUB_CRC_HI } stub_state_t;
+
+static nrf_stub_config_t s_config;
+static int s_fds[2] = { -1, -1 };
+static pthread_t s_thread;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool s_running;
+
+static volatile uint32_t s_baud;
+static volatile uint32_t s_watch_baud = BLE_UART_BAUD;
+static uint32_t s_old_baud;
+static uint64_t s_switched_ms;  // when SET_BAUD last changed the rate; 0 once a frame has confirmed it
+static uint64_t s_last_tx_ms;
+
+static stub_state_t s_state;
+static uint8_t s_type;
+static uint8_t s_length;
+static uint8_t s_value[BLE_TLV_MAX_LEN];
+static uint8_t s_have;
+static uint16_t s_crc;
+static uint8_t s_message[BLE_MESSAGE_MAX_LEN];
+static uint16_t s_message_len;
+static bool s_message_overflow;
+
+static uint8_t s_export[32768];
+static uint32_t s_export_have;
+static uint32_t s_export_size;
+static uint32_t s_export_count;  // chunks with a good CRC, for export_corrupt_every
+static bool s_export_stopped;
+
+static char s_typed[1024];
+static size_t s_typed_len;
+static nrf_stub_stats_t s_stats;
+
+static uint64_t now_ms(void) {
+    return nrf_stub_now_us() / 1000;
+}
+
+// CRC-16/CCITT-FALSE, as BLE_UART_TLV_CRC specifies.
+static uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc) {
+    while (length--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+// Ten bit times a byte: start, eight data bits, stop.
+static void wire_delay(size_t length, uint32_t baud) {
+    if (s_config.wire_time && baud) usleep((useconds_t)((uint64_t)length * 10 * 1000000 / baud));
+}
+
+// A receiver at the wrong rate sees framing errors and junk instead of the bytes that were sent.
+static bool wire_ok(void) {
+    return s_baud == s_watch_baud && s_baud != s_config.broken_baud;
+}
+
+static void wire_write(int fd, const uint8_t *data, size_t length, uint32_t baud) {
+    uint8_t buf[64];
+    while (length) {
+        size_t n = length < sizeof(buf) ? length : sizeof(buf);
+        memcpy(buf, data, n);
+        if (!wire_ok()) for (size_t i = 0; i < n; i++) buf[i] ^= 0xA5;
+        wire_delay(n, baud);
+        if (write(fd, buf, n) != (ssize_t)n) return;
+        data += n;
+        length -= n;
+    }
+}
+
+// Call with s_lock held.
+static void send_frame_locked(uint8_t type, const uint8_t *data, uint8_t length) {
+    uint8_t frame[2 + BLE_TLV_MAX_LEN + 2];
+    size_t frame_len = 2 + length;
+    frame[0] = type;
+    frame[1] = length;
+    memcpy(&frame[2], data, length);
+    if (s_config.crc) {
+        uint16_t crc = crc16(frame, frame_len, 0xFFFF);
+        frame[frame_len++] = crc & 0xFF;
+        frame[frame_len++] = crc >> 8;
+    }
+
+    if (now_ms() - s_last_tx_ms >= NRF_STUB_QUIET_MS) {
+        uint8_t wake = BLE_UART_WAKE_BYTE;
+        wire_write(s_fds[1], &wake, 1, s_baud);
+        if (s_config.wire_time) usleep(BLE_UART_WAKE_GUARD_US);
+    }
+    wire_write(s_fds[1], frame, frame_len, s_baud);
+    s_last_tx_ms = now_ms();
+    s_stats.answers++;
+}
+
+static void send_frame(uint8_t type, const uint8_t *data, uint8_t length) {
+    pthread_mutex_lock(&s_lock);
+    send_frame_locked(type, data, length);
+    pthread_mutex_unlock(&s_lock);
+}
+
+static void send_message(uint8_t type, const uint8_t *data, uint16_t length) {
+    while (length > BLE_TLV_MAX_LEN) {
+        send_frame(type | BLE_TLV_MORE, data, BLE_TLV_MAX_LEN);
+        data += BLE_TLV_MAX_LEN;
+        length -= BLE_TLV_MAX_LEN;
+    }
+    send_frame(type, data, length);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(uint8_t *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = value >> (8 * i);
+}
+
+// Keeps the chunk if it's the next one and its CRC is good, and asks for what comes next.
+static void export_chunk(const uint8_t *data, uint16_t length) {
+    if (length < 10) return;
+    uint32_t offset = get32(data);
+    uint32_t size = get32(data + 4);
+    uint16_t data_len = length - 10;
+    uint16_t crc = crc16(data, length - 2, 0xFFFF);
+    pthread_mutex_lock(&s_lock);
+    s_export_size = size;
+    if (size == BLE_EXPORT_NO_FILE) {
+        pthread_mutex_unlock(&s_lock);
+        return;
+    }
+
+    bool good = crc == (data[length - 2] | (data[length - 1] << 8));
+    if (good && s_config.export_corrupt_every && ++s_export_count % s_config.export_corrupt_every == 0) good = false;
+    if (good) s_stats.export_chunks++;
+    else s_stats.export_bad_chunks++;
+    if (good && offset == s_export_have && offset + data_len <= sizeof(s_export)) {
+        memcpy(&s_export[offset], data + 8, data_len);
+        s_export_have += data_len;
+    }
+
+    uint8_t answer[4];
+    bool stop = !s_export_stopped && s_config.export_stop_at && s_export_have >= s_config.export_stop_at;
+    if (stop) s_export_stopped = true;
+    put32(answer, stop ? BLE_EXPORT_NO_FILE : s_export_have);
+    pthread_mutex_unlock(&s_lock);
+    send_frame(BLE_CMD_EXPORT, answer, sizeof(answer));
+}
+
+static void handle_message(uint8_t type, const uint8_t *data, uint16_t length) {
+    switch (type) {
+        case BLE_CMD_PING: {
+            uint8_t ack = NRF_STUB_PING_ACK;
+            send_frame(type, &ack, 1);
+            break;
+        }
+        case BLE_CMD_ECHO:
+            send_message(type, data, length);
+            break;
+        case BLE_CMD_GET_TIME: {
+            uint32_t reg = s_config.date_time;
+            uint16_t offset = (uint16_t)s_config.utc_offset;
+            uint8_t answer[6] = { reg & 0xFF, (reg >> 8) & 0xFF, (reg >> 16) & 0xFF, reg >> 24,
+                                  offset & 0xFF, offset >> 8 };
+            send_frame(type, answer, sizeof(answer));
+            break;
+        }
+        case BLE_CMD_SET_BAUD: {
+            uint32_t rate = length < 4 ? 0 : data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+            uint8_t accepted = rate >= 1200 && rate <= s_config.max_baud;
+            // switch as the answer's last byte goes out, before the watch can answer it
+            pthread_mutex_lock(&s_lock);
+            send_frame_locked(type, &accepted, 1);
+            if (accepted && rate != s_baud) {
+                s_old_baud = s_baud;
+                s_baud = rate;
+                s_switched_ms = now_ms();
+            }
+            pthread_mutex_unlock(&s_lock);
+            break;
+        }
+        case BLE_CMD_SEND_STRING: {
+            pthread_mutex_lock(&s_lock);
+            uint16_t taken = length;
+            if (taken > sizeof(s_typed) - s_typed_len) taken = sizeof(s_typed) - s_typed_len;
+            memcpy(&s_typed[s_typed_len], data, taken);
+            s_typed_len += taken;
+            pthread_mutex_unlock(&s_lock);
+            uint8_t ack = taken;
+            send_frame(type, &ack, 1);
+            break;
+        }
+        case BLE_CMD_EXPORT:
+            export_chunk(data, length);
+            break;
+        default:
+            // SEND_KEY, CLEAR_BONDS and BLE_CTRL aren't answered
+            break;
+    }
+}
+
+static void frame_received(void) {
+    s_stats.frames++;
+    s_switched_ms = 0;
+    s_state = STUB_TYPE;
+
+    if (s_message_len + s_length > BLE_MESSAGE_MAX_LEN) {
+        s_message_overflow = true;
+    } else {
+        memcpy(&s_message[s_message_len], s_value, s_length);
+        s_message_len += s_length;
+    }
+    if (s_type & BLE_TLV_MORE) return;
+
+    if (!s_message_overflow) handle_message(s_type, s_message, s_message_len);
+    s_message_len = 0;
+    s_message_overflow = false;
+}
+
+static void value_received(void) {
+    if (!s_config.crc) {
+        frame_received();
+        return;
+    }
+    uint8_t header[2] = { s_type, s_length };
+    s_crc = crc16(header, 2, 0xFFFF);
+    s_crc = crc16(s_value, s_length, s_crc);
+    s_state = STUB_CRC_LO;
+}
+
+static void byte_received(uint8_t byte) {
+    switch (s_state) {
+        case STUB_TYPE:
+            s_type = byte;
+            s_state = STUB_LENGTH;
+            break;
+        case STUB_LENGTH:
+            if (byte > BLE_TLV_MAX_LEN) {
+                s_stats.bad_frames++;
+                s_state = STUB_TYPE;
+                break;
+            }
+            s_length = byte;
+            s_have = 0;
+            s_state = STUB_VALUE;
+            if (s_length == 0) value_received();
+            break;
+        case STUB_VALUE:
+            s_value[s_have++] = byte;
+            if (s_have == s_length) value_received();
+            break;
+        case STUB_CRC_LO:
+            s_crc ^= byte;
+            s_state = STUB_CRC_HI;
+            break;
+        case STUB_CRC_HI:
+            s_crc ^= (uint16_t)byte << 8;
+            if (s_crc == 0) {
+                frame_received();
+            } else {
+                s_stats.bad_frames++;
+                s_state = STUB_TYPE;
+            }
+            break;
+    }
+}
+
+static void *stub_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = s_fds[1], .events = POLLIN };
+    uint8_t buf[64];
+
+    while (s_running) {
+        if (poll(&pfd, 1, 5) > 0) {
+            ssize_t n = read(s_fds[1], buf, sizeof(buf));
+            if (n <= 0) break;
+            for (ssize_t i = 0; i < n; i++) byte_received(buf[i]);
+        }
+        if (s_switched_ms && now_ms() - s_switched_ms >= NRF_STUB_FALLBACK_MS) {
+            s_baud = s_old_baud;
+            s_switched_ms = 0;
+            s_state = STUB_TYPE;
+            s_message_len = 0;
+        }
+    }
+    return NULL;
+}
+
+void nrf_stub_start(const nrf_stub_config_t *config) {
+    s_config = *config;
+    socketpair(AF_UNIX, SOCK_STREAM, 0, s_fds);
+    s_baud = BLE_UART_BAUD;
+    s_switched_ms = 0;
+    s_last_tx_ms = 0;
+    s_state = STUB_TYPE;
+    s_message_len = 0;
+    s_message_overflow = false;
+    s_typed_len = 0;
+    s_export_have = 0;
+    s_export_size = 0;
+    s_export_count = 0;
+    s_export_stopped = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_running = true;
+    pthread_create(&s_thread, NULL, stub_main, NULL);
+}
+
+void nrf_stub_stop(void) {
+    s_running = false;
+    pthread_join(s_thread, NULL);
+    close(s_fds[0]);
+    close(s_fds[1]);
+    s_fds[0] = s_fds[1] = -1;
+}
+
+void nrf_stub_set_watch_baud(uint32_t baud) {
+    s_watch_baud = baud;
+}
+
+void nrf_stub_watch_write(const uint8_t *data, size_t length) {
+    pthread_mutex_lock(&s_lock);
+    wire_write(s_fds[0], data, length, s_watch_baud);
+    pthread_mutex_unlock(&s_lock);
+}
+
+size_t nrf_stub_watch_read(uint8_t *buf, size_t length, int wait_ms) {
+    struct pollfd pfd = { .fd = s_fds[0], .events = POLLIN };
+    if (poll(&pfd, 1, wait_ms) <= 0) return 0;
+    ssize_t n = read(s_fds[0], buf, length);
+    return n < 0 ? 0 : n;
+}
+
+void nrf_stub_send_raw(const uint8_t *data, size_t length) {
+    pthread_mutex_lock(&s_lock);
+    wire_write(s_fds[1], data, length, s_baud);
+    s_last_tx_ms = now_ms();
+    pthread_mutex_unlock(&s_lock);
+}
+
+uint32_t nrf_stub_baud(void) {
+    return s_baud;
+}
+
+uint64_t nrf_stub_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void nrf_stub_get_stats(nrf_stub_stats_t *stats) {
+    *stats = s_stats;
+}
+
+size_t nrf_stub_take_typed(char *buf, size_t length) {
+    pthread_mutex_lock(&s_lock);
+    size_t n = s_typed_len < length ? s_typed_len : length;
+    memcpy(buf, s_typed, n);
+    s_typed_len = 0;
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+void nrf_stub_request_export(const char *filename, uint32_t offset) {
+    uint8_t request[4 + BLE_EXPORT_NAME_MAX];
+    size_t name_len = strlen(filename);
+    pthread_mutex_lock(&s_lock);
+    s_export_have = offset;
+    s_export_size = 0;
+    pthread_mutex_unlock(&s_lock);
+    put32(request, offset);
+    memcpy(&request[4], filename, name_len);
+    send_message(BLE_CMD_EXPORT_START, request, 4 + name_len);
+}
+
+size_t nrf_stub_export_received(uint8_t *buf, size_t length, uint32_t *size) {
+    pthread_mutex_lock(&s_lock);
+    size_t have = s_export_have;
+    if (buf) memcpy(buf, s_export, have < length ? have : length);
+    *size = s_export_size;
+    pthread_mutex_unlock(&s_lock);
+    return have;
+}
@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BLE_NRF_STUB_H_
+#define BLE_NRF_STUB_H_
+
+// A host-side stand-in for the nRF52805 firmware, for testing the watch's side of the BLE UART
+// protocol without hardware. It runs on its own thread at one end of a socketpair and answers
+// frames the way the firmware does: PING, ECHO, GET_TIME, SET_BAUD, SEND_STRING and EXPORT, with
+// BLE_TLV_MORE fragments and the optional CRC. The watch's fake UART driver uses the other end
+// through nrf_stub_watch_write and nrf_stub_watch_read. Writes at either end take as long as the
+// bytes would take on a real wire, if asked to, and are garbled if the two ends disagree on the
+// baud rate. This file keeps the socket calls out of the tests, whose watch headers declare their
+// own read() and sleep().
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t max_baud;     // fastest rate SET_BAUD accepts
+    uint32_t broken_baud;  // a rate SET_BAUD accepts but the wire can't carry; 0 for none
+    bool crc;              // frames carry a CRC, as with ble_uart_set_crc(true)
+    bool wire_time;        // make writes take as long as they would at the current rate
+    uint32_t date_time;    // GET_TIME's answer: a watch_date_time_t's reg...
+    int16_t utc_offset;    // ...and the phone's UTC offset in minutes
+    uint32_t export_corrupt_every;  // treat every nth export chunk as corrupted; 0 for none
+    uint32_t export_stop_at;        // stop an export once this many bytes are in; 0 for never
+} nrf_stub_config_t;
+
+typedef struct {
+    uint32_t frames;       // valid frames received from the watch
+    uint32_t bad_frames;   // frames dropped for a bad length or CRC
+    uint32_t answers;      // frames sent to the watch
+    uint32_t export_chunks;     // export chunks received with a good CRC
+    uint32_t export_bad_chunks; // ...and with a bad one
+} nrf_stub_stats_t;
+
+// Opens the socketpair and starts the stub on its own thread, at BLE_UART_BAUD.
+void nrf_stub_start(const nrf_stub_config_t *config);
+
+void nrf_stub_stop(void);
+
+// The watch's UART driver calls these: when it changes rate, to put bytes on the wire, and to take
+// up to length bytes off it, waiting up to wait_ms for the first. Returns the number of bytes read.
+void nrf_stub_set_watch_baud(uint32_t baud);
+void nrf_stub_watch_write(const uint8_t *data, size_t length);
+size_t nrf_stub_watch_read(uint8_t *buf, size_t length, int wait_ms);
+
+// Sends raw bytes to the watch, as if the stub's firmware were broken.
+void nrf_stub_send_raw(const uint8_t *data, size_t length);
+
+uint32_t nrf_stub_baud(void);
+uint64_t nrf_stub_now_us(void);
+void nrf_stub_get_stats(nrf_stub_stats_t *stats);
+
+// Copies out, and clears, what SEND_STRING has typed so far. Returns its length.
+size_t nrf_stub_take_typed(char *buf, size_t length);
+
+// Asks the watch to export a file, as the phone would, keeping the bytes received so far below
+// offset.
+void nrf_stub_request_export(const char *filename, uint32_t offset);
+
+// Copies out the bytes exported so far, and gives the file size the watch sent, which is
+// BLE_EXPORT_NO_FILE if it has no such file. buf may be NULL. Returns the number of bytes held.
+size_t nrf_stub_export_received(uint8_t *buf, size_t length, uint32_t *size);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host tests for the HID typing queue. A fake request layer records each chunk sent, and the tests
+// play the nRF by answering them. Build and run with `make` in this directory.
+
+#include <stdint.h>
+#include <string.h>
+#include "ble_hid.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "unity.h"
+
+static char s_sent[512];
+static size_t s_sent_len;
+static uint8_t s_chunk_len;
+static ble_request_cb_t s_pending;
+static uint32_t s_now;
+static bool s_table_full;
+
+uint8_t ble_request_send(uint8_t type, const uint8_t *data, uint8_t len,
+                         uint16_t timeout_ms, ble_request_cb_t callback, void *context) {
+    if (s_table_full) return 0;
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_SEND_STRING, type);
+    TEST_ASSERT_NULL(s_pending);
+    TEST_ASSERT_TRUE(len > 0 && len <= BLE_TLV_MAX_LEN);
+    memcpy(&s_sent[s_sent_len], data, len);
+    s_chunk_len = len;
+    s_pending = callback;
+    return 1;
+}
+
+// Chunks sent without waiting for an answer, to a peer that doesn't give one
+static uint8_t s_unacked_frames;
+
+void ble_uart_send(uint8_t type, const uint8_t *data, uint8_t len) {
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_SEND_STRING, type);
+    TEST_ASSERT_TRUE(len > 0 && len <= BLE_TLV_MAX_LEN);
+    memcpy(&s_sent[s_sent_len], data, len);
+    s_sent_len += len;
+    s_unacked_frames++;
+}
+
+uint8_t ble_uart_tx_room(void) {
+    return BLE_TLV_MAX_LEN;
+}
+
+void ble_request_cancel(uint8_t seq) {
+    ble_request_cb_t callback = s_pending;
+    s_pending = NULL;
+    callback(seq, BLE_REQUEST_CANCELLED, NULL, 0, NULL);
+}
+
+uint32_t ble_request_now(void) {
+    return s_now;
+}
+
+void movement_log(uint8_t level, const char *format, ...) {
+}
+
+// The nRF types some of the chunk, a quarter second later, and says how many it took.
+static void ack(uint8_t taken) {
+    s_now += 32;
+    s_sent_len += taken;
+    ble_request_cb_t callback = s_pending;
+    s_pending = NULL;
+    callback(1, BLE_REQUEST_OK, &taken, 1, NULL);
+}
+
+static void ack_all(void) {
+    while (s_pending) ack(s_chunk_len);
+}
+
+void setUp(void) {
+    ble_hid_cancel();
+    s_pending = NULL;
+    s_sent_len = 0;
+    s_table_full = false;
+    s_unacked_frames = 0;
+}
+
+void tearDown(void) {
+}
+
+static void test_long_text_is_typed_in_order_in_chunks(void) {
+    const char *text = "correct horse battery staple, and then some more words to make it long";
+    ble_hid_stats_t before, after;
+    ble_hid_get_stats(&before);
+
+    TEST_ASSERT_EQUAL(strlen(text), ble_hid_type(text));
+    TEST_ASSERT_TRUE(ble_hid_busy());
+    // only one chunk is in flight at a time.
+    TEST_ASSERT_EQUAL_UINT8(BLE_TLV_MAX_LEN, s_chunk_len);
+    ack_all();
+
+    TEST_ASSERT_FALSE(ble_hid_busy());
+    TEST_ASSERT_EQUAL(strlen(text), s_sent_len);
+    TEST_ASSERT_EQUAL_MEMORY(text, s_sent, s_sent_len);
+    ble_hid_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32((strlen(text) + BLE_TLV_MAX_LEN - 1) / BLE_TLV_MAX_LEN, after.chunks - before.chunks);
+    TEST_ASSERT_EQUAL_UINT32(strlen(text), after.last_chars);
+    TEST_ASSERT_EQUAL_UINT32(after.chunks - before.chunks, after.last_ms / 250);
+}
+
+static void test_characters_the_nrf_didnt_take_are_sent_again(void) {
+    ble_hid_type("0123456789");
+    ack(4);
+    TEST_ASSERT_EQUAL_UINT8(6, s_chunk_len);
+    TEST_ASSERT_EQUAL_MEMORY("456789", &s_sent[4], 6);
+    // text queued while a chunk is in flight joins the queue behind it.
+    ble_hid_type("ab");
+    ack_all();
+    TEST_ASSERT_EQUAL_MEMORY("0123456789ab", s_sent, 12);
+}
+
+// The nRF types the chunk but doesn't say so.
+static void time_out(void) {
+    s_now += BLE_HID_ACK_TIMEOUT_MS * 128 / 1000;
+    s_sent_len += s_chunk_len;
+    ble_request_cb_t callback = s_pending;
+    s_pending = NULL;
+    callback(1, BLE_REQUEST_TIMEOUT, NULL, 0, NULL);
+}
+
+static void test_unanswered_chunk_drops_the_rest(void) {
+    // the nRF has answered before, so this one was lost.
+    ble_hid_type("ok");
+    ack_all();
+
+    ble_hid_stats_t before, after;
+    ble_hid_get_stats(&before);
+    ble_hid_type("secret password 1234");
+    time_out();
+
+    TEST_ASSERT_FALSE(ble_hid_busy());
+    TEST_ASSERT_NULL(s_pending);
+    ble_hid_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(20, after.dropped - before.dropped);
+    TEST_ASSERT_FALSE(after.unacked);
+}
+
+static void test_peer_that_never_answers_is_typed_to_without_waiting(void) {
+    const char *text = "correct horse battery staple, and then some more";
+    ble_hid_stats_t before, after;
+    ble_hid_get_stats(&before);
+
+    ble_hid_type(text);
+    time_out();
+    // the first chunk is taken as typed, and the next goes out at once, unanswered.
+    TEST_ASSERT_EQUAL(2 * BLE_TLV_MAX_LEN, s_sent_len);
+    TEST_ASSERT_EQUAL_UINT8(1, s_unacked_frames);
+    TEST_ASSERT_NULL(s_pending);
+
+    // the rest are paced by the task, giving the nRF time to type each chunk.
+    ble_hid_task();
+    TEST_ASSERT_EQUAL_UINT8(1, s_unacked_frames);
+    while (ble_hid_busy()) {
+        s_now++;
+        ble_hid_task();
+    }
+    TEST_ASSERT_EQUAL(strlen(text), s_sent_len);
+    TEST_ASSERT_EQUAL_MEMORY(text, s_sent, s_sent_len);
+    TEST_ASSERT_NULL(s_pending);
+
+    ble_hid_get_stats(&after);
+    TEST_ASSERT_TRUE(after.unacked);
+    TEST_ASSERT_EQUAL_UINT32(strlen(text), after.typed - before.typed);
+    TEST_ASSERT_EQUAL_UINT32(0, after.dropped - before.dropped);
+    TEST_ASSERT_UINT32_WITHIN(10, BLE_TLV_MAX_LEN * BLE_HID_UNACKED_MS_PER_CHAR, after.last_ms - BLE_HID_ACK_TIMEOUT_MS);
+
+    // cancelling forgets it, so the next chunk waits for an answer again.
+    ble_hid_cancel();
+    s_sent_len = 0;
+    ble_hid_type("hi");
+    TEST_ASSERT_NOT_NULL(s_pending);
+    ack_all();
+    TEST_ASSERT_EQUAL_MEMORY("hi", s_sent, 2);
+}
+
+static void test_full_queue_takes_what_fits(void) {
+    static char text[BLE_HID_QUEUE_SZ + 11];
+    memset(text, 'x', sizeof(text) - 1);
+    ble_hid_stats_t before, after;
+    ble_hid_get_stats(&before);
+
+    TEST_ASSERT_EQUAL(BLE_HID_QUEUE_SZ, ble_hid_type(text));
+    ble_hid_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(10, after.dropped - before.dropped);
+    TEST_ASSERT_EQUAL_UINT16(BLE_HID_QUEUE_SZ, after.max_depth);
+    ack_all();
+    TEST_ASSERT_EQUAL(BLE_HID_QUEUE_SZ, s_sent_len);
+}
+
+static void test_full_request_table_is_retried_by_the_task(void) {
+    s_table_full = true;
+    ble_hid_type("hi");
+    TEST_ASSERT_NULL(s_pending);
+    ble_hid_task();
+    TEST_ASSERT_NULL(s_pending);
+
+    s_table_full = false;
+    ble_hid_task();
+    TEST_ASSERT_NOT_NULL(s_pending);
+    ack_all();
+    TEST_ASSERT_EQUAL_MEMORY("hi", s_sent, 2);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_long_text_is_typed_in_order_in_chunks);
+    RUN_TEST(test_characters_the_nrf_didnt_take_are_sent_again);
+    RUN_TEST(test_unanswered_chunk_drops_the_rest);
+    RUN_TEST(test_peer_that_never_answers_is_typed_to_without_waiting);
+    RUN_TEST(test_full_queue_takes_what_fits);
+    RUN_TEST(test_full_request_table_is_retried_by_the_task);
+    return UNITY_END();
+}
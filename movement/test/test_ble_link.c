@@ -0,0 +1,603 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// End-to-end host tests for the BLE link. The watch's real TLV code (ble_uart.c, ble_request.c and
+// ble_link.c) talks over a socketpair to ble_nrf_stub.c, a stand-in for the nRF52805 firmware
+// running on its own thread. A fake UART driver feeds received bytes to the watch's receive
+// callback, and a fake EIC wakes it when the nRF's wake byte arrives while it's parked, the way
+// the RX pin does on hardware. The fast tick follows the real clock.
+//
+// A fake filesystem holds one file for the watch to export.
+//
+// Besides checking that requests are answered, this fuzzes the watch's parser with malformed
+// input, and prints round-trip figures (frames/sec and latency) at two baud rates, with wire time
+// simulated, and with none, for the parser alone, and how long an export takes. Build and run with `make` in this directory.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble_uart.h"
+#include "ble_request.h"
+#include "ble_link.h"
+#include "ble_export.h"
+#include "ble_nrf_stub.h"
+#include "watch_uart.h"
+#include "watch_extint.h"
+#include "filesystem.h"
+#include "unity.h"
+
+#define TEST_DATE_TIME  0x5A3C1F27
+#define TEST_UTC_OFFSET (-300)
+#define EXPORT_FILE "/ext/accel.dat"
+#define SECRET_FILE "totp_uris.txt"
+#define EXPORT_FILE_SIZE 12345
+
+static bool s_running;
+static watch_uart_rx_cb_t s_rx_callback;
+static ext_irq_cb_t s_edge_callback;
+static uint8_t s_file[EXPORT_FILE_SIZE];
+static uint64_t s_start_us;
+static uint32_t s_ticks;
+
+void watch_enable_uart(const uint8_t tx_pin, const uint8_t rx_pin, uint32_t baud) {
+    s_rx_callback = NULL;
+    nrf_stub_set_watch_baud(baud);
+}
+
+void watch_disable_uart(void) {
+    s_rx_callback = NULL;
+}
+
+void watch_uart_set_rx_callback(watch_uart_rx_cb_t callback) {
+    s_rx_callback = callback;
+}
+
+uint32_t watch_uart_rx_dropped(void) {
+    return 0;
+}
+
+void watch_register_interrupt_callback(const uint8_t pin, ext_irq_cb_t callback, watch_interrupt_trigger trigger) {
+    s_edge_callback = callback;
+}
+
+uint32_t watch_get_cycle_count(void) {
+    return 0;
+}
+
+size_t watch_uart_write(const uint8_t *data, size_t length) {
+    nrf_stub_watch_write(data, length);
+    return length;
+}
+
+// writes take their wire time before returning, so the ring is always empty.
+size_t watch_uart_tx_free(void) {
+    return WATCH_UART_TX_BUF_SZ - 1;
+}
+
+int32_t filesystem_get_file_size(char *filename) {
+    // the secret is there too, to show it isn't handed out.
+    if (strcmp(filename, SECRET_FILE) == 0) return 16;
+    return strcmp(filename, EXPORT_FILE) == 0 ? EXPORT_FILE_SIZE : -1;
+}
+
+int32_t filesystem_read_file_at(char *filename, int32_t offset, char *buf, int32_t length) {
+    if (strcmp(filename, EXPORT_FILE) != 0) return -1;
+    if (offset + length > EXPORT_FILE_SIZE) length = EXPORT_FILE_SIZE - offset;
+    memcpy(buf, &s_file[offset], length);
+    return length;
+}
+
+void movement_log(uint8_t level, const char *format, ...) {
+}
+
+// One pass of the watch's main loop, waiting up to wait_ms for bytes from the nRF first.
+// Returns whether any arrived.
+static bool pump(int wait_ms) {
+    uint8_t buf[64];
+    size_t n = nrf_stub_watch_read(buf, sizeof(buf), wait_ms);
+    if (n) {
+        for (size_t i = 0; i < n; i++) {
+            if (s_rx_callback) {
+                s_rx_callback(buf[i]);
+            } else if (buf[i] == BLE_UART_WAKE_BYTE && s_edge_callback) {
+                // while parked, the low level is an edge on the RX pin; anything else is lost
+                s_edge_callback();
+            }
+            if (ble_uart_frames_pending() == BLE_UART_RX_QUEUE_LEN) ble_request_task();
+        }
+    }
+
+    uint32_t due = (nrf_stub_now_us() - s_start_us) * 128 / 1000000;
+    while (s_ticks < due) {
+        s_ticks++;
+        ble_request_fast_tick();
+        ble_uart_fast_tick();
+    }
+    ble_request_task();
+    ble_export_task();
+    // as in Movement's main loop, the UART isn't parked while anything is in flight.
+    if (!ble_request_pending() && !ble_export_busy()) ble_uart_park_if_idle();
+    return n != 0;
+}
+
+static bool run_until(volatile bool *done, uint32_t timeout_ms) {
+    uint64_t deadline = nrf_stub_now_us() + (uint64_t)timeout_ms * 1000;
+    while (!*done && nrf_stub_now_us() < deadline) pump(1);
+    return *done;
+}
+
+// Lets whatever is still in flight arrive, and be parsed.
+static void drain(void) {
+    while (pump(5));
+}
+
+static void start_link(nrf_stub_config_t *config) {
+    config->date_time = TEST_DATE_TIME;
+    config->utc_offset = TEST_UTC_OFFSET;
+    nrf_stub_start(config);
+    s_running = true;
+    ble_uart_deinit();
+    ble_uart_set_baud(BLE_UART_BAUD);
+    nrf_stub_set_watch_baud(BLE_UART_BAUD);
+    ble_uart_set_crc(config->crc);
+    ble_uart_init();
+    ble_export_init();
+    ble_export_set_enabled(true);
+    for (size_t i = 0; i < sizeof(s_file); i++) s_file[i] = i * 131 + (i >> 8);
+    s_start_us = nrf_stub_now_us();
+    s_ticks = 0;
+}
+
+// Waits for one request's answer.
+typedef struct {
+    volatile bool done;
+    ble_request_status_t status;
+    uint8_t data[BLE_MESSAGE_MAX_LEN];
+    uint8_t len;
+} answer_t;
+
+static void answered(uint8_t seq, ble_request_status_t status, const uint8_t *data, uint8_t len, void *context) {
+    answer_t *answer = context;
+    answer->status = status;
+    answer->len = len;
+    if (data) memcpy(answer->data, data, len);
+    answer->done = true;
+}
+
+static bool request(answer_t *answer, uint8_t type, const uint8_t *data, uint8_t len) {
+    memset(answer, 0, sizeof(*answer));
+    if (!ble_request_send(type, data, len, 500, answered, answer)) return false;
+    return run_until(&answer->done, 2000) && answer->status == BLE_REQUEST_OK;
+}
+
+static volatile bool s_negotiated;
+static uint32_t s_negotiated_baud;
+
+static void negotiated(uint32_t baud, void *context) {
+    s_negotiated_baud = baud;
+    s_negotiated = true;
+}
+
+static uint32_t negotiate(uint32_t max_baud) {
+    s_negotiated = false;
+    TEST_ASSERT_TRUE(ble_link_negotiate_baud(max_baud, negotiated, NULL));
+    TEST_ASSERT_TRUE(run_until(&s_negotiated, 5000));
+    return s_negotiated_baud;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+    if (!s_running) return;
+    ble_export_cancel();
+    drain();
+    ble_uart_deinit();
+    nrf_stub_stop();
+    s_running = false;
+}
+
+static void test_requests_are_answered(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+    answer_t answer;
+
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_PING, NULL, 0));
+    TEST_ASSERT_EQUAL_UINT8(1, answer.len);
+    TEST_ASSERT_EQUAL_HEX8(0xAC, answer.data[0]);
+
+    uint8_t echo[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_ECHO, echo, sizeof(echo)));
+    TEST_ASSERT_EQUAL_UINT8(sizeof(echo), answer.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(echo, answer.data, sizeof(echo));
+
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_GET_TIME, NULL, 0));
+    TEST_ASSERT_EQUAL_UINT8(6, answer.len);
+    uint32_t reg = answer.data[0] | (answer.data[1] << 8) | (answer.data[2] << 16) | ((uint32_t)answer.data[3] << 24);
+    TEST_ASSERT_EQUAL_HEX32(TEST_DATE_TIME, reg);
+    TEST_ASSERT_EQUAL_INT16(TEST_UTC_OFFSET, (int16_t)(answer.data[4] | (answer.data[5] << 8)));
+
+    nrf_stub_stats_t stub;
+    nrf_stub_get_stats(&stub);
+    TEST_ASSERT_EQUAL_UINT32(3, stub.frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stub.bad_frames);
+}
+
+static void test_late_answers_are_not_taken_for_newer_requests(void) {
+    nrf_stub_config_t config = { .max_baud = 115200, .wire_time = true };
+    start_link(&config);
+
+    // at 9600 baud this takes far longer than it is given.
+    uint8_t slow[200];
+    memset(slow, 0x55, sizeof(slow));
+    answer_t late;
+    memset(&late, 0, sizeof(late));
+    TEST_ASSERT_NOT_EQUAL(0, ble_request_send(BLE_CMD_ECHO, slow, sizeof(slow), 50, answered, &late));
+    TEST_ASSERT_TRUE(run_until(&late.done, 2000));
+    TEST_ASSERT_EQUAL(BLE_REQUEST_TIMEOUT, late.status);
+
+    // the first echo's answer arrives while this one waits, and must not be taken for its own.
+    uint8_t echo[4] = { 1, 2, 3, 4 };
+    answer_t answer;
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_ECHO, echo, sizeof(echo)));
+    TEST_ASSERT_EQUAL_UINT8(sizeof(echo), answer.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(echo, answer.data, sizeof(echo));
+}
+
+static void test_long_messages_cross_in_fragments(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+    answer_t answer;
+
+    uint8_t echo[200];
+    for (size_t i = 0; i < sizeof(echo); i++) echo[i] = i * 7;
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_ECHO, echo, sizeof(echo)));
+    TEST_ASSERT_EQUAL_UINT8(sizeof(echo), answer.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(echo, answer.data, sizeof(echo));
+
+    const char *text = "the quick brown fox jumps over the lazy dog";
+    char typed[64];
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_SEND_STRING, (const uint8_t *)text, strlen(text)));
+    TEST_ASSERT_EQUAL_UINT8(strlen(text), answer.data[0]);
+    TEST_ASSERT_EQUAL(strlen(text), nrf_stub_take_typed(typed, sizeof(typed)));
+    TEST_ASSERT_EQUAL_MEMORY(text, typed, strlen(text));
+}
+
+static void test_message_cut_short_by_parking_isnt_joined_to_the_next(void) {
+    nrf_stub_config_t config = { .max_baud = 115200, .wire_time = true };
+    start_link(&config);
+
+    uint8_t slow[200];
+    memset(slow, 0x55, sizeof(slow));
+    answer_t cut;
+    memset(&cut, 0, sizeof(cut));
+    ble_uart_stats_t before, now;
+    ble_uart_get_stats(&before);
+    uint8_t seq = ble_request_send(BLE_CMD_ECHO, slow, sizeof(slow), 5000, answered, &cut);
+    TEST_ASSERT_NOT_EQUAL(0, seq);
+    // park partway through the answer; the rest of it is lost.
+    do {
+        pump(1);
+        ble_uart_get_stats(&now);
+    } while (now.frames - before.frames < 3);
+    TEST_ASSERT_FALSE(cut.done);
+    ble_request_cancel(seq);
+    ble_uart_park();
+    // frames take about 20 ms each at 9600 baud; wait out the rest of them.
+    while (pump(50));
+    ble_request_forget_late();
+
+    uint8_t echo[4] = { 1, 2, 3, 4 };
+    answer_t answer;
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_ECHO, echo, sizeof(echo)));
+    TEST_ASSERT_EQUAL_UINT8(sizeof(echo), answer.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(echo, answer.data, sizeof(echo));
+}
+
+static void test_crc_frames_round_trip(void) {
+    nrf_stub_config_t config = { .max_baud = 115200, .crc = true };
+    start_link(&config);
+    ble_uart_stats_t before, after;
+    ble_uart_get_stats(&before);
+    answer_t answer;
+
+    uint8_t echo[50];
+    for (size_t i = 0; i < sizeof(echo); i++) echo[i] = 0xFF - i;
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_ECHO, echo, sizeof(echo)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(echo, answer.data, sizeof(echo));
+
+    nrf_stub_stats_t stub;
+    nrf_stub_get_stats(&stub);
+    ble_uart_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(0, stub.bad_frames);
+    TEST_ASSERT_EQUAL_UINT32(before.crc_errors, after.crc_errors);
+}
+
+static void test_baud_negotiation_falls_back_from_a_broken_rate(void) {
+    // the nRF says yes to 115200, but the link doesn't work there.
+    nrf_stub_config_t config = { .max_baud = 115200, .broken_baud = 115200 };
+    start_link(&config);
+
+    TEST_ASSERT_EQUAL_UINT32(57600, negotiate(115200));
+    TEST_ASSERT_EQUAL_UINT32(57600, ble_uart_get_baud());
+    TEST_ASSERT_EQUAL_UINT32(57600, nrf_stub_baud());
+
+    answer_t answer;
+    TEST_ASSERT_TRUE(request(&answer, BLE_CMD_PING, NULL, 0));
+}
+
+static void test_baud_negotiation_stops_at_the_nrf_limit(void) {
+    nrf_stub_config_t config = { .max_baud = 38400 };
+    start_link(&config);
+
+    TEST_ASSERT_EQUAL_UINT32(38400, negotiate(115200));
+    TEST_ASSERT_EQUAL_UINT32(38400, nrf_stub_baud());
+}
+
+static uint32_t s_fuzz_state = 0x2545F491;
+
+static uint32_t fuzz_random(void) {
+    s_fuzz_state ^= s_fuzz_state << 13;
+    s_fuzz_state ^= s_fuzz_state >> 17;
+    s_fuzz_state ^= s_fuzz_state << 5;
+    return s_fuzz_state;
+}
+
+// Fills buf with one kind of bad input. Returns its length.
+static size_t make_garbage(uint8_t *buf) {
+    size_t len = 0;
+    switch (fuzz_random() % 4) {
+        case 0:
+            // noise
+            len = 1 + fuzz_random() % 40;
+            for (size_t i = 0; i < len; i++) buf[i] = fuzz_random();
+            break;
+        case 1:
+            // a length no frame can have
+            buf[len++] = fuzz_random();
+            buf[len++] = BLE_TLV_MAX_LEN + 1 + fuzz_random() % (255 - BLE_TLV_MAX_LEN);
+            for (size_t i = fuzz_random() % 20; i; i--) buf[len++] = fuzz_random();
+            break;
+        case 2:
+            // a frame cut short
+            buf[len++] = 1 + fuzz_random() % 0x7F;
+            buf[len++] = 2 + fuzz_random() % (BLE_TLV_MAX_LEN - 1);
+            for (size_t i = fuzz_random() % (buf[1] - 1); i; i--) buf[len++] = fuzz_random();
+            break;
+        case 3:
+            // fragments that run past BLE_MESSAGE_MAX_LEN and never finish
+            for (int n = 0; n < 17; n++) {
+                buf[len++] = BLE_CMD_ECHO | BLE_TLV_MORE;
+                buf[len++] = BLE_TLV_MAX_LEN;
+                for (int i = 0; i < BLE_TLV_MAX_LEN; i++) buf[len++] = fuzz_random();
+            }
+            break;
+    }
+    return len;
+}
+
+static void test_fuzzed_input_never_wedges_the_parser(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+    ble_uart_stats_t before, after;
+    ble_uart_get_stats(&before);
+
+    // whatever state the garbage leaves the parser in, this much filler finishes the frame, and
+    // the parser then skips it as wake bytes.
+    uint8_t filler[2 + BLE_TLV_MAX_LEN] = { 0 };
+    uint8_t garbage[17 * (2 + BLE_TLV_MAX_LEN)];
+    answer_t answer;
+
+    for (int round = 0; round < 200; round++) {
+        ble_uart_wake();
+        nrf_stub_send_raw(garbage, make_garbage(garbage));
+        nrf_stub_send_raw(filler, sizeof(filler));
+        drain();
+
+        // a message left open by the garbage may still swallow the answer's bytes, but not the answer.
+        TEST_ASSERT_TRUE(request(&answer, BLE_CMD_PING, NULL, 0));
+        TEST_ASSERT_EQUAL_HEX8(0xAC, answer.data[answer.len - 1]);
+    }
+
+    ble_uart_get_stats(&after);
+    TEST_ASSERT_GREATER_THAN_UINT32(before.length_errors, after.length_errors);
+}
+
+// Asks for a file the way the phone does, and waits for the watch to start sending it.
+static void phone_export(const char *filename, uint32_t offset) {
+    nrf_stub_request_export(filename, offset);
+    uint64_t deadline = nrf_stub_now_us() + 1000000;
+    while (!ble_export_busy() && nrf_stub_now_us() < deadline) pump(1);
+    TEST_ASSERT_TRUE(ble_export_busy());
+}
+
+// Runs the main loop until the export ends; returns how it ended.
+static ble_export_state_t finish_export(uint32_t timeout_ms) {
+    uint64_t deadline = nrf_stub_now_us() + (uint64_t)timeout_ms * 1000;
+    while (ble_export_busy() && nrf_stub_now_us() < deadline) pump(1);
+    ble_export_status_t status;
+    ble_export_get_status(&status);
+    return status.state;
+}
+
+static void expect_file_received(void) {
+    static uint8_t received[EXPORT_FILE_SIZE + 1];
+    uint32_t size;
+    TEST_ASSERT_EQUAL(EXPORT_FILE_SIZE, nrf_stub_export_received(received, sizeof(received), &size));
+    TEST_ASSERT_EQUAL_UINT32(EXPORT_FILE_SIZE, size);
+    TEST_ASSERT_EQUAL_MEMORY(s_file, received, EXPORT_FILE_SIZE);
+}
+
+static void test_export_reaches_the_phone_intact(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+
+    phone_export(EXPORT_FILE, 0);
+    TEST_ASSERT_EQUAL(BLE_EXPORT_DONE, finish_export(5000));
+    expect_file_received();
+
+    ble_export_status_t status;
+    ble_export_get_status(&status);
+    TEST_ASSERT_EQUAL_UINT8(BLE_EXPORT_MAX_WINDOW, status.window);
+    TEST_ASSERT_EQUAL_UINT32(0, status.resends);
+
+    // every chunk arrived whole, the first time, and none went out after the last.
+    nrf_stub_stats_t stub;
+    nrf_stub_get_stats(&stub);
+    TEST_ASSERT_EQUAL_UINT32(status.chunks, stub.export_chunks);
+    TEST_ASSERT_EQUAL_UINT32(0, stub.export_bad_chunks);
+}
+
+static void test_export_resends_corrupted_chunks(void) {
+    nrf_stub_config_t config = { .max_baud = 115200, .export_corrupt_every = 7 };
+    start_link(&config);
+
+    TEST_ASSERT_TRUE(ble_export_start(EXPORT_FILE, 0));
+    TEST_ASSERT_EQUAL(BLE_EXPORT_DONE, finish_export(5000));
+    expect_file_received();
+
+    ble_export_status_t status;
+    ble_export_get_status(&status);
+    nrf_stub_stats_t stub;
+    nrf_stub_get_stats(&stub);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stub.export_bad_chunks);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stub.export_bad_chunks, status.resends);
+}
+
+static void test_export_resumes_where_the_phone_left_off(void) {
+    nrf_stub_config_t config = { .max_baud = 115200, .export_stop_at = 5000 };
+    start_link(&config);
+
+    TEST_ASSERT_TRUE(ble_export_start(EXPORT_FILE, 0));
+    TEST_ASSERT_EQUAL(BLE_EXPORT_STOPPED, finish_export(5000));
+    uint32_t size;
+    size_t have = nrf_stub_export_received(NULL, 0, &size);
+
+    ble_export_status_t status;
+    ble_export_get_status(&status);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(5000, have);
+    TEST_ASSERT_LESS_THAN_UINT32(EXPORT_FILE_SIZE, have);
+    // the chunk the phone stopped at was kept, but the watch didn't hear so.
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(have, status.acked);
+
+    // the phone comes back for the rest.
+    phone_export(EXPORT_FILE, have);
+    TEST_ASSERT_EQUAL(BLE_EXPORT_DONE, finish_export(5000));
+    expect_file_received();
+    ble_export_get_status(&status);
+    TEST_ASSERT_EQUAL_UINT32(EXPORT_FILE_SIZE, status.acked);
+    TEST_ASSERT_EQUAL_UINT32(have, status.start);
+}
+
+static void test_export_of_a_missing_file_is_refused(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+
+    TEST_ASSERT_FALSE(ble_export_start("nope.dat", 0));
+    nrf_stub_request_export("nope.dat", 0);
+    drain();
+    uint32_t size = 0;
+    nrf_stub_export_received(NULL, 0, &size);
+    TEST_ASSERT_EQUAL_HEX32(BLE_EXPORT_NO_FILE, size);
+}
+
+static void test_export_is_refused_unless_enabled_and_listed(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+    uint32_t size = 0;
+
+    TEST_ASSERT_FALSE(ble_export_start(SECRET_FILE, 0));
+    nrf_stub_request_export(SECRET_FILE, 0);
+    drain();
+    nrf_stub_export_received(NULL, 0, &size);
+    TEST_ASSERT_EQUAL_HEX32(BLE_EXPORT_NO_FILE, size);
+    TEST_ASSERT_FALSE(ble_export_busy());
+
+    // with exports off, even a listed file is refused to the phone.
+    ble_export_set_enabled(false);
+    size = 0;
+    nrf_stub_request_export(EXPORT_FILE, 0);
+    drain();
+    nrf_stub_export_received(NULL, 0, &size);
+    TEST_ASSERT_EQUAL_HEX32(BLE_EXPORT_NO_FILE, size);
+    TEST_ASSERT_FALSE(ble_export_busy());
+}
+
+// Times echo round trips one after another, and prints frames/sec both ways and the latency.
+static void benchmark(const char *label, int round_trips) {
+    answer_t answer;
+    uint8_t echo[4] = { 1, 2, 3, 4 };
+    uint64_t worst = 0;
+    uint64_t start = nrf_stub_now_us();
+
+    for (int i = 0; i < round_trips; i++) {
+        uint64_t sent = nrf_stub_now_us();
+        TEST_ASSERT_TRUE(request(&answer, BLE_CMD_ECHO, echo, sizeof(echo)));
+        uint64_t latency = nrf_stub_now_us() - sent;
+        if (latency > worst) worst = latency;
+    }
+
+    uint64_t elapsed = nrf_stub_now_us() - start;
+    printf("%-18s %7.0f frames/s, latency %6.0f us mean, %6lu us worst\n", label,
+           2.0 * round_trips * 1000000 / elapsed, (double)elapsed / round_trips, (unsigned long)worst);
+}
+
+static void test_benchmark_round_trips(void) {
+    nrf_stub_config_t config = { .max_baud = 115200 };
+    start_link(&config);
+    benchmark("parser only:", 500);
+    tearDown();
+
+    config.wire_time = true;
+    start_link(&config);
+    benchmark("9600 baud wire:", 20);
+    TEST_ASSERT_EQUAL_UINT32(115200, negotiate(115200));
+    benchmark("115200 baud wire:", 100);
+
+    ble_export_status_t status;
+    TEST_ASSERT_TRUE(ble_export_start(EXPORT_FILE, 0));
+    TEST_ASSERT_EQUAL(BLE_EXPORT_DONE, finish_export(10000));
+    ble_export_get_status(&status);
+    printf("%-18s %7lu bytes/s, %lu bytes in %lu ms\n", "export at 115200:",
+           (unsigned long)status.bytes_per_s, (unsigned long)status.size, (unsigned long)status.elapsed_ms);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_requests_are_answered);
+    RUN_TEST(test_late_answers_are_not_taken_for_newer_requests);
+    RUN_TEST(test_long_messages_cross_in_fragments);
+    RUN_TEST(test_message_cut_short_by_parking_isnt_joined_to_the_next);
+    RUN_TEST(test_crc_frames_round_trip);
+    RUN_TEST(test_baud_negotiation_falls_back_from_a_broken_rate);
+    RUN_TEST(test_baud_negotiation_stops_at_the_nrf_limit);
+    RUN_TEST(test_fuzzed_input_never_wedges_the_parser);
+    RUN_TEST(test_export_reaches_the_phone_intact);
+    RUN_TEST(test_export_resends_corrupted_chunks);
+    RUN_TEST(test_export_resumes_where_the_phone_left_off);
+    RUN_TEST(test_export_of_a_missing_file_is_refused);
+    RUN_TEST(test_export_is_refused_unless_enabled_and_listed);
+    RUN_TEST(test_benchmark_round_trips);
+    return UNITY_END();
+}
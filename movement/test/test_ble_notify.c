@@ -0,0 +1,270 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host tests for the BLE notification store. A fake request layer hands the tests the frame handler
+// to play the nRF with, and a fake filesystem keeps files in RAM so spilling and rotation can be
+// checked. Build and run with `make` in this directory.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ble_notify.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "filesystem.h"
+#include "movement.h"
+#include "unity.h"
+
+#define RECORD_SIZE (2 + BLE_NOTIFY_TEXT_MAX)
+
+typedef struct {
+    char name[16];
+    bool exists;
+    int32_t size;
+    char data[(BLE_NOTIFY_FILE_RECORDS + 1) * RECORD_SIZE];
+} fake_file_t;
+
+static fake_file_t s_files[2];
+static bool s_flash_broken;
+static ble_frame_handler_t s_handler;
+static uint32_t s_cues;
+
+bool ble_request_set_handler(uint8_t type, ble_frame_handler_t handler) {
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_NOTIFY, type);
+    s_handler = handler;
+    return true;
+}
+
+void movement_play_sequence(int8_t *note_sequence) {
+    TEST_ASSERT_NOT_NULL(note_sequence);
+    s_cues++;
+}
+
+void movement_log(uint8_t level, const char *format, ...) {
+}
+
+static fake_file_t *find(const char *name) {
+    for (int i = 0; i < 2; i++) {
+        if (s_files[i].exists && strcmp(s_files[i].name, name) == 0) return &s_files[i];
+    }
+    return NULL;
+}
+
+int32_t filesystem_get_file_size(char *filename) {
+    fake_file_t *file = find(filename);
+    return file ? file->size : -1;
+}
+
+bool filesystem_append_file(char *filename, char *text, int32_t length) {
+    if (s_flash_broken) return false;
+    fake_file_t *file = find(filename);
+    for (int i = 0; file == NULL && i < 2; i++) {
+        if (!s_files[i].exists) {
+            file = &s_files[i];
+            strcpy(file->name, filename);
+            file->exists = true;
+            file->size = 0;
+        }
+    }
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(file->size + length <= (int32_t)sizeof(file->data));
+    memcpy(&file->data[file->size], text, length);
+    file->size += length;
+    return true;
+}
+
+int32_t filesystem_read_file_at(char *filename, int32_t offset, char *buf, int32_t length) {
+    fake_file_t *file = find(filename);
+    if (file == NULL) return -1;
+    if (offset + length > file->size) length = file->size - offset;
+    memcpy(buf, &file->data[offset], length);
+    return length;
+}
+
+bool filesystem_rename(char *old_name, char *new_name) {
+    fake_file_t *file = find(old_name);
+    if (file == NULL) return false;
+    fake_file_t *replaced = find(new_name);
+    if (replaced) replaced->exists = false;
+    strcpy(file->name, new_name);
+    return true;
+}
+
+bool filesystem_rm(char *filename) {
+    fake_file_t *file = find(filename);
+    if (file == NULL) return false;
+    file->exists = false;
+    return true;
+}
+
+// The nRF passes on a notification: the app ID, then the text.
+static void notify(uint8_t app, const char *text) {
+    uint8_t value[BLE_MESSAGE_MAX_LEN];
+    size_t len = strlen(text);
+    value[0] = app;
+    memcpy(&value[1], text, len);
+    TEST_ASSERT_NOT_NULL(s_handler);
+    s_handler(BLE_CMD_NOTIFY, value, 1 + len);
+}
+
+// Sends n numbered notifications, "msg 0" first.
+static void notify_numbered(int n) {
+    char text[16];
+    for (int i = 0; i < n; i++) {
+        sprintf(text, "msg %d", i);
+        notify(i & 0xFF, text);
+    }
+}
+
+static void expect(uint16_t index, uint8_t app, const char *text) {
+    ble_notification_t notification;
+    TEST_ASSERT_TRUE(ble_notify_get(index, &notification));
+    TEST_ASSERT_EQUAL_UINT8(app, notification.app);
+    TEST_ASSERT_EQUAL_STRING(text, notification.text);
+    TEST_ASSERT_EQUAL_UINT8(strlen(text), notification.len);
+}
+
+static void expect_numbered(uint16_t index, int number) {
+    char text[16];
+    sprintf(text, "msg %d", number);
+    expect(index, number & 0xFF, text);
+}
+
+static ble_notify_stats_t s_before;
+
+void setUp(void) {
+    ble_notify_clear();
+    memset(s_files, 0, sizeof(s_files));
+    s_flash_broken = false;
+    s_handler = NULL;
+    ble_notify_init();
+    ble_notify_get_stats(&s_before);
+    s_cues = 0;
+}
+
+void tearDown(void) {
+}
+
+static void test_notifications_are_kept_newest_first(void) {
+    notify(BLE_NOTIFY_APP_SMS, "lunch?");
+    notify(BLE_NOTIFY_APP_CALL, "Mum");
+    notify(BLE_NOTIFY_APP_EMAIL, "Invoice 42");
+
+    TEST_ASSERT_EQUAL_UINT16(3, ble_notify_count());
+    expect(0, BLE_NOTIFY_APP_EMAIL, "Invoice 42");
+    expect(1, BLE_NOTIFY_APP_CALL, "Mum");
+    expect(2, BLE_NOTIFY_APP_SMS, "lunch?");
+    ble_notification_t notification;
+    TEST_ASSERT_FALSE(ble_notify_get(3, &notification));
+
+    // one cue each, and nothing touches flash while they fit in RAM.
+    TEST_ASSERT_EQUAL_UINT32(3, s_cues);
+    TEST_ASSERT_EQUAL_INT32(-1, filesystem_get_file_size(BLE_NOTIFY_FILE));
+
+    ble_notify_stats_t stats;
+    ble_notify_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.received - s_before.received);
+    TEST_ASSERT_EQUAL_UINT16(3, stats.unread);
+    ble_notify_mark_read();
+    ble_notify_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT16(0, stats.unread);
+}
+
+static void test_text_is_truncated_and_made_printable(void) {
+    notify(BLE_NOTIFY_APP_OTHER, "0123456789abcdefghijklmnopqrstuvwxyzABCDEF");
+    expect(0, BLE_NOTIFY_APP_OTHER, "0123456789abcdefghijklmnopqrstuv");
+
+    notify(BLE_NOTIFY_APP_SOCIAL, "caf\xc3\xa9\a ok");
+    expect(0, BLE_NOTIFY_APP_SOCIAL, "caf??? ok");
+
+    // a frame without even an app ID isn't a notification.
+    s_handler(BLE_CMD_NOTIFY, NULL, 0);
+    TEST_ASSERT_EQUAL_UINT16(2, ble_notify_count());
+}
+
+static void test_overflow_moves_the_oldest_to_flash(void) {
+    notify_numbered(BLE_NOTIFY_QUEUE_LEN + 5);
+
+    TEST_ASSERT_EQUAL_UINT16(BLE_NOTIFY_QUEUE_LEN + 5, ble_notify_count());
+    TEST_ASSERT_EQUAL_INT32(5 * RECORD_SIZE, filesystem_get_file_size(BLE_NOTIFY_FILE));
+    for (int i = 0; i < BLE_NOTIFY_QUEUE_LEN + 5; i++) expect_numbered(i, BLE_NOTIFY_QUEUE_LEN + 4 - i);
+
+    ble_notify_stats_t stats;
+    ble_notify_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.spilled - s_before.spilled);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.lost - s_before.lost);
+}
+
+static void test_full_file_is_rotated(void) {
+    // enough to fill the file twice over, and start a third.
+    int total = BLE_NOTIFY_QUEUE_LEN + 2 * BLE_NOTIFY_FILE_RECORDS + 3;
+    notify_numbered(total);
+
+    // the first file's worth went when the second file was rotated.
+    int kept = BLE_NOTIFY_QUEUE_LEN + BLE_NOTIFY_FILE_RECORDS + 3;
+    TEST_ASSERT_EQUAL_UINT16(kept, ble_notify_count());
+    TEST_ASSERT_EQUAL_INT32(3 * RECORD_SIZE, filesystem_get_file_size(BLE_NOTIFY_FILE));
+    TEST_ASSERT_EQUAL_INT32(BLE_NOTIFY_FILE_RECORDS * RECORD_SIZE, filesystem_get_file_size(BLE_NOTIFY_OLD_FILE));
+    for (int i = 0; i < kept; i++) expect_numbered(i, total - 1 - i);
+    ble_notification_t notification;
+    TEST_ASSERT_FALSE(ble_notify_get(kept, &notification));
+}
+
+static void test_files_are_counted_at_startup_and_cleared(void) {
+    notify_numbered(BLE_NOTIFY_QUEUE_LEN + 4);
+
+    // as after a reset with the RAM queue lost: what is in flash is still there.
+    ble_notify_init();
+    TEST_ASSERT_EQUAL_UINT16(BLE_NOTIFY_QUEUE_LEN + 4, ble_notify_count());
+    expect_numbered(BLE_NOTIFY_QUEUE_LEN, 3);
+
+    ble_notify_clear();
+    TEST_ASSERT_EQUAL_UINT16(0, ble_notify_count());
+    TEST_ASSERT_EQUAL_INT32(-1, filesystem_get_file_size(BLE_NOTIFY_FILE));
+    ble_notification_t notification;
+    TEST_ASSERT_FALSE(ble_notify_get(0, &notification));
+}
+
+static void test_unusable_flash_loses_only_the_oldest(void) {
+    s_flash_broken = true;
+    notify_numbered(BLE_NOTIFY_QUEUE_LEN + 2);
+
+    TEST_ASSERT_EQUAL_UINT16(BLE_NOTIFY_QUEUE_LEN, ble_notify_count());
+    expect_numbered(0, BLE_NOTIFY_QUEUE_LEN + 1);
+    expect_numbered(BLE_NOTIFY_QUEUE_LEN - 1, 2);
+    ble_notify_stats_t stats;
+    ble_notify_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.lost - s_before.lost);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_notifications_are_kept_newest_first);
+    RUN_TEST(test_text_is_truncated_and_made_printable);
+    RUN_TEST(test_overflow_moves_the_oldest_to_flash);
+    RUN_TEST(test_full_file_is_rotated);
+    RUN_TEST(test_files_are_counted_at_startup_and_cleared);
+    RUN_TEST(test_unusable_flash_loses_only_the_oldest);
+    return UNITY_END();
+}
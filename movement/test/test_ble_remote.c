@@ -0,0 +1,172 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host tests for the BLE button remote. A fake request layer hands the tests the frame handler to
+// play the nRF with, and a fake clock times the gap between events. Build and run with `make` in
+// this directory.
+
+#include <stdint.h>
+#include <string.h>
+#include "ble_remote.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "movement.h"
+#include "unity.h"
+
+static ble_frame_handler_t s_handler;
+static uint32_t s_now;
+static uint8_t s_answer;
+static uint32_t s_answers;
+
+bool ble_request_set_handler(uint8_t type, ble_frame_handler_t handler) {
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_BUTTON, type);
+    s_handler = handler;
+    return true;
+}
+
+uint32_t ble_request_now(void) {
+    return s_now;
+}
+
+void ble_uart_send(uint8_t type, const uint8_t *data, uint8_t len) {
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_BUTTON, type);
+    TEST_ASSERT_EQUAL_UINT8(1, len);
+    s_answer = data[0];
+    s_answers++;
+}
+
+static void send(const uint8_t *codes, uint8_t len) {
+    s_answers = 0;
+    s_handler(BLE_CMD_BUTTON, codes, len);
+    TEST_ASSERT_EQUAL_UINT32(1, s_answers);
+}
+
+// Runs the fast tick until the next event is due, and returns it.
+static uint8_t next_event(void) {
+    for (int i = 0; i < 128; i++) {
+        uint8_t event = ble_remote_next();
+        if (event != EVENT_NONE) return event;
+        s_now++;
+    }
+    return EVENT_NONE;
+}
+
+void setUp(void) {
+    ble_remote_set_enabled(true);
+    ble_remote_clear();
+    ble_remote_init();
+    TEST_ASSERT_NOT_NULL(s_handler);
+    // let the gap after the last test's events run out.
+    s_now += 128;
+}
+
+void tearDown(void) {
+}
+
+static void test_a_press_reaches_the_face_as_button_events(void) {
+    const uint8_t press[] = {
+        BLE_REMOTE_MODE | BLE_REMOTE_DOWN, BLE_REMOTE_MODE | BLE_REMOTE_UP,
+        BLE_REMOTE_ALARM | BLE_REMOTE_DOWN, BLE_REMOTE_ALARM | BLE_REMOTE_LONG_PRESS,
+        BLE_REMOTE_ALARM | BLE_REMOTE_LONG_UP, BLE_REMOTE_LIGHT | BLE_REMOTE_DOWN,
+    };
+    send(press, sizeof(press));
+    TEST_ASSERT_EQUAL_UINT8(sizeof(press), s_answer);
+    TEST_ASSERT_TRUE(ble_remote_busy());
+
+    TEST_ASSERT_EQUAL(EVENT_MODE_BUTTON_DOWN, next_event());
+    TEST_ASSERT_EQUAL(EVENT_MODE_BUTTON_UP, next_event());
+    TEST_ASSERT_EQUAL(EVENT_ALARM_BUTTON_DOWN, next_event());
+    TEST_ASSERT_EQUAL(EVENT_ALARM_LONG_PRESS, next_event());
+    TEST_ASSERT_EQUAL(EVENT_ALARM_LONG_UP, next_event());
+    TEST_ASSERT_EQUAL(EVENT_LIGHT_BUTTON_DOWN, next_event());
+    TEST_ASSERT_FALSE(ble_remote_busy());
+    TEST_ASSERT_EQUAL(EVENT_NONE, next_event());
+}
+
+static void test_events_are_spaced_out(void) {
+    const uint8_t presses[] = { BLE_REMOTE_LIGHT | BLE_REMOTE_DOWN, BLE_REMOTE_LIGHT | BLE_REMOTE_UP };
+    send(presses, sizeof(presses));
+
+    // the first goes at once, the next not until the gap has passed.
+    TEST_ASSERT_EQUAL(EVENT_LIGHT_BUTTON_DOWN, ble_remote_next());
+    uint32_t sent_at = s_now;
+    TEST_ASSERT_EQUAL(EVENT_NONE, ble_remote_next());
+    TEST_ASSERT_EQUAL(EVENT_LIGHT_BUTTON_UP, next_event());
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BLE_REMOTE_GAP_MS * 128 / 1000, s_now - sent_at);
+}
+
+static void test_invalid_events_are_refused(void) {
+    const uint8_t codes[] = { 0x30, BLE_REMOTE_MODE | 0x04, BLE_REMOTE_MODE | BLE_REMOTE_UP, 0xFF };
+    ble_remote_stats_t before, after;
+    ble_remote_get_stats(&before);
+    send(codes, sizeof(codes));
+    TEST_ASSERT_EQUAL_UINT8(1, s_answer);
+    ble_remote_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(3, after.dropped - before.dropped);
+    TEST_ASSERT_EQUAL(EVENT_MODE_BUTTON_UP, next_event());
+    TEST_ASSERT_FALSE(ble_remote_busy());
+}
+
+static void test_a_full_queue_tells_the_phone_to_back_off(void) {
+    uint8_t codes[BLE_REMOTE_QUEUE_LEN + 4];
+    for (size_t i = 0; i < sizeof(codes); i++) codes[i] = BLE_REMOTE_ALARM | (i & 1);
+    send(codes, sizeof(codes));
+    TEST_ASSERT_EQUAL_UINT8(BLE_REMOTE_QUEUE_LEN, s_answer);
+
+    ble_remote_stats_t stats;
+    ble_remote_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT8(BLE_REMOTE_QUEUE_LEN, stats.depth);
+    TEST_ASSERT_EQUAL_UINT8(BLE_REMOTE_QUEUE_LEN, stats.max_depth);
+
+    // once one has been delivered, there's room for the next.
+    TEST_ASSERT_EQUAL(EVENT_ALARM_BUTTON_DOWN, next_event());
+    send(&codes[BLE_REMOTE_QUEUE_LEN], 1);
+    TEST_ASSERT_EQUAL_UINT8(1, s_answer);
+    for (int i = 1; i <= BLE_REMOTE_QUEUE_LEN; i++) {
+        TEST_ASSERT_EQUAL(i & 1 ? EVENT_ALARM_BUTTON_UP : EVENT_ALARM_BUTTON_DOWN, next_event());
+    }
+    TEST_ASSERT_FALSE(ble_remote_busy());
+}
+
+static void test_disabling_drops_waiting_events(void) {
+    const uint8_t presses[] = { BLE_REMOTE_MODE | BLE_REMOTE_DOWN, BLE_REMOTE_MODE | BLE_REMOTE_UP };
+    send(presses, sizeof(presses));
+    ble_remote_set_enabled(false);
+    TEST_ASSERT_FALSE(ble_remote_busy());
+    TEST_ASSERT_EQUAL(EVENT_NONE, next_event());
+
+    send(presses, sizeof(presses));
+    TEST_ASSERT_EQUAL_UINT8(0, s_answer);
+    TEST_ASSERT_FALSE(ble_remote_busy());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_a_press_reaches_the_face_as_button_events);
+    RUN_TEST(test_events_are_spaced_out);
+    RUN_TEST(test_invalid_events_are_refused);
+    RUN_TEST(test_a_full_queue_tells_the_phone_to_back_off);
+    RUN_TEST(test_disabling_drops_waiting_events);
+    return UNITY_END();
+}
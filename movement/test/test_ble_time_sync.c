@@ -0,0 +1,226 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host tests for BLE time sync. A simulated RTC runs at a rate set by its crystal's drift and by the
+// frequency correction the sync writes, and a simulated phone answers each time request with the
+// true time after a random delay. Build and run with `make` in this directory.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble_time_sync.h"
+#include "ble_request.h"
+#include "ble_uart.h"
+#include "movement.h"
+#include "watch_utility.h"
+#include "unity.h"
+
+movement_state_t movement_state;
+const int16_t movement_timezone_offsets[] = {
+    0, 60, 120, 180, 240, 270, 300, 330, 345, 360, 390, 420, 480, 525, 540, 570, 600, 630, 660, 690,
+    720, 765, 780, 840, -60, -120, -150, -180, -210, -240, -300, -360, -420, -480, -540, -570, -600,
+    -660, -720, 585, 765,
+};
+
+static double s_true_ms;      // the phone's time, as milliseconds of local "unix" time
+static double s_watch_ms;     // what the RTC would show if it had a sub-second register
+static double s_drift_ppm;    // how fast the uncorrected crystal runs
+static int16_t s_freqcorr;
+static ble_request_cb_t s_pending;
+static uint32_t s_requests;
+static uint32_t s_seed;
+
+void watch_rtc_freqcorr_write(int16_t value, int16_t sign) {
+    s_freqcorr = sign ? -value : value;
+}
+
+int16_t watch_rtc_freqcorr_read(void) {
+    return s_freqcorr;
+}
+
+watch_date_time watch_rtc_get_date_time(void) {
+    return watch_utility_date_time_from_unix_time((uint32_t)(s_watch_ms / 1000), 0);
+}
+
+// Like the hardware, setting the clock leaves the prescaler, and so the sub-second phase, alone.
+void watch_rtc_set_date_time(watch_date_time date_time) {
+    s_watch_ms = watch_utility_date_time_to_unix_time(date_time, 0) * 1000.0 + fmod(s_watch_ms, 1000);
+}
+
+uint8_t ble_request_send(uint8_t type, const uint8_t *data, uint8_t len,
+                         uint16_t timeout_ms, ble_request_cb_t callback, void *context) {
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_GET_TIME, type);
+    TEST_ASSERT_NULL(s_pending);
+    s_pending = callback;
+    s_requests++;
+    return 1;
+}
+
+void movement_log(uint8_t level, const char *format, ...) {
+}
+
+static double watch_rate(void) {
+    return 1 + s_drift_ppm * 1e-6 - s_freqcorr / 1048576.0;
+}
+
+// Lets time pass, in true milliseconds.
+static void advance(double true_ms) {
+    s_true_ms += true_ms;
+    s_watch_ms += true_ms * watch_rate();
+}
+
+// The phone answers after 50 to 450 ms, with its time to 1/256 s and a UTC offset.
+static void answer(int16_t tz_minutes) {
+    s_seed = s_seed * 1103515245 + 12345;
+    advance(50 + (s_seed >> 16) % 400);
+
+    uint32_t seconds = (uint32_t)(s_true_ms / 1000);
+    watch_date_time phone = watch_utility_date_time_from_unix_time(seconds, 0);
+    uint8_t value[7] = {
+        phone.reg & 0xFF, (phone.reg >> 8) & 0xFF, (phone.reg >> 16) & 0xFF, phone.reg >> 24,
+        (uint16_t)tz_minutes & 0xFF, (uint16_t)tz_minutes >> 8,
+        (uint8_t)(fmod(s_true_ms, 1000) * 256 / 1000),
+    };
+    ble_request_cb_t callback = s_pending;
+    s_pending = NULL;
+    callback(1, BLE_REQUEST_OK, value, sizeof(value), NULL);
+}
+
+// Runs the watch for a number of its own minutes, answering every sync request.
+static void run_minutes(uint32_t minutes) {
+    for (uint32_t i = 0; i < minutes; i++) {
+        // the minute alarm fires when the RTC's seconds roll over to zero.
+        double next = (floor(s_watch_ms / 60000) + 1) * 60000;
+        advance((next - s_watch_ms) / watch_rate());
+        s_watch_ms = next;
+        ble_time_sync_background_task(true);
+        if (s_pending) answer(0);
+    }
+}
+
+static double residual_ppm(void) {
+    return s_drift_ppm - s_freqcorr / 1.048576;
+}
+
+static double watch_error_ms(void) {
+    return s_true_ms - s_watch_ms;
+}
+
+static void start(double drift_ppm, int16_t freqcorr, double offset_ms) {
+    s_true_ms = 1717200000000.0;  // June 2024
+    s_watch_ms = s_true_ms - offset_ms;
+    s_drift_ppm = drift_ppm;
+    s_freqcorr = freqcorr;
+    s_requests = 0;
+    s_seed = 1;
+}
+
+void setUp(void) {
+    ble_time_sync_reset();
+    s_pending = NULL;
+}
+
+void tearDown(void) {
+}
+
+static void test_fast_crystal_is_trimmed_out(void) {
+    start(30, 0, 2500);
+    run_minutes(14 * 24 * 60);
+
+    TEST_ASSERT_FLOAT_WITHIN(2, 0, residual_ppm());
+    TEST_ASSERT_FLOAT_WITHIN(1500, 0, watch_error_ms());
+    TEST_ASSERT_EQUAL_UINT32(14 * 24 * 60 / BLE_TIME_SYNC_INTERVAL_MINUTES, s_requests);
+}
+
+static void test_slow_crystal_is_trimmed_out_from_the_factory_correction(void) {
+    ble_time_sync_status_t before, status;
+    ble_time_sync_get_status(&before);
+    start(-45, 22, -800);
+    run_minutes(14 * 24 * 60);
+
+    TEST_ASSERT_FLOAT_WITHIN(2, 0, residual_ppm());
+    TEST_ASSERT_FLOAT_WITHIN(1500, 0, watch_error_ms());
+
+    ble_time_sync_get_status(&status);
+    TEST_ASSERT_EQUAL_INT16(s_freqcorr, status.freqcorr);
+    TEST_ASSERT_EQUAL_UINT32(14 * 24 * 60 / BLE_TIME_SYNC_INTERVAL_MINUTES, status.syncs - before.syncs);
+}
+
+static void test_accurate_crystal_is_left_alone(void) {
+    start(0.2, 0, 0);
+    run_minutes(7 * 24 * 60);
+
+    TEST_ASSERT_INT16_WITHIN(1, 0, s_freqcorr);
+}
+
+static void test_large_offset_sets_the_clock_and_timezone(void) {
+    start(10, 0, -3600000);
+    TEST_ASSERT_TRUE(ble_time_sync_now(NULL, NULL));
+    answer(330);
+
+    TEST_ASSERT_FLOAT_WITHIN(1000, 0, watch_error_ms());
+    TEST_ASSERT_EQUAL_INT16(330, movement_timezone_offsets[movement_state.settings.bit.time_zone]);
+
+    // a jump like that says nothing about drift, so no sample is kept from it.
+    ble_time_sync_status_t status;
+    ble_time_sync_get_status(&status);
+    TEST_ASSERT_EQUAL_UINT8(0, status.samples);
+}
+
+static void test_failed_sync_is_retried_sooner(void) {
+    start(0, 0, 0);
+    run_minutes(BLE_TIME_SYNC_INTERVAL_MINUTES - 1);
+    ble_time_sync_background_task(true);
+    TEST_ASSERT_NOT_NULL(s_pending);
+    ble_request_cb_t callback = s_pending;
+    s_pending = NULL;
+    callback(1, BLE_REQUEST_TIMEOUT, NULL, 0, NULL);
+
+    for (int i = 0; i < BLE_TIME_SYNC_RETRY_MINUTES - 1; i++) ble_time_sync_background_task(true);
+    TEST_ASSERT_NULL(s_pending);
+    ble_time_sync_background_task(true);
+    TEST_ASSERT_NOT_NULL(s_pending);
+    answer(0);
+}
+
+static void test_due_sync_waits_until_allowed(void) {
+    start(0, 0, 0);
+    for (int i = 0; i < BLE_TIME_SYNC_INTERVAL_MINUTES + 10; i++) ble_time_sync_background_task(false);
+    TEST_ASSERT_NULL(s_pending);
+    ble_time_sync_background_task(true);
+    TEST_ASSERT_NOT_NULL(s_pending);
+    answer(0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_crystal_is_trimmed_out);
+    RUN_TEST(test_slow_crystal_is_trimmed_out_from_the_factory_correction);
+    RUN_TEST(test_accurate_crystal_is_left_alone);
+    RUN_TEST(test_large_offset_sets_the_clock_and_timezone);
+    RUN_TEST(test_failed_sync_is_retried_sooner);
+    RUN_TEST(test_due_sync_waits_until_allowed);
+    return UNITY_END();
+}
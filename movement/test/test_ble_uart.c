@@ -0,0 +1,375 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host tests for the BLE UART TLV receiver. A fake UART stands in for watch_uart.c: bytes are fed
+// to the receive callback one at a time, the way SERCOM3_Handler delivers them, while the "main
+// loop" polls ble_uart_task only every so often. A fake EIC stands in for the RX pin's wake
+// interrupt. Build and run with `make` in this directory.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble_uart.h"
+#include "watch_uart.h"
+#include "watch_extint.h"
+#include "watch_utility.h"
+#include "unity.h"
+
+static watch_uart_rx_cb_t s_rx_callback;
+static uint8_t s_tx[512];
+static size_t s_tx_len;
+static uint32_t s_baud;
+static ext_irq_cb_t s_edge_callback;
+static watch_interrupt_trigger s_edge_trigger;
+
+void watch_enable_uart(const uint8_t tx_pin, const uint8_t rx_pin, uint32_t baud) {
+    s_rx_callback = NULL;
+    s_baud = baud;
+}
+
+void watch_disable_uart(void) {
+    s_rx_callback = NULL;
+}
+
+void watch_uart_set_rx_callback(watch_uart_rx_cb_t callback) {
+    s_rx_callback = callback;
+}
+
+uint32_t watch_uart_rx_dropped(void) {
+    return 0;
+}
+
+void watch_register_interrupt_callback(const uint8_t pin, ext_irq_cb_t callback, watch_interrupt_trigger trigger) {
+    s_edge_callback = callback;
+    s_edge_trigger = trigger;
+}
+
+uint32_t watch_get_cycle_count(void) {
+    return 0;
+}
+
+size_t watch_uart_write(const uint8_t *data, size_t length) {
+    memcpy(&s_tx[s_tx_len], data, length);
+    s_tx_len += length;
+    return length;
+}
+
+// nothing drains the fake TX ring; the tests empty it by clearing s_tx_len.
+size_t watch_uart_tx_free(void) {
+    return s_tx_len < WATCH_UART_TX_BUF_SZ - 1 ? WATCH_UART_TX_BUF_SZ - 1 - s_tx_len : 0;
+}
+
+// Receives bytes as the interrupt would, at full rate, with no polling in between.
+static void inject(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        TEST_ASSERT_NOT_NULL(s_rx_callback);
+        s_rx_callback(data[i]);
+    }
+}
+
+// Builds a frame with a recognizable payload: byte i of frame n is n + i.
+static size_t make_frame(uint8_t *out, uint8_t type, uint8_t len, uint8_t n, bool crc) {
+    out[0] = type;
+    out[1] = len;
+    for (uint8_t i = 0; i < len; i++) out[2 + i] = n + i;
+    size_t size = 2 + len;
+    if (crc) {
+        uint16_t value = watch_utility_crc16(out, size, 0xFFFF);
+        out[size++] = value & 0xFF;
+        out[size++] = value >> 8;
+    }
+    return size;
+}
+
+static void expect_frame(uint8_t type, uint8_t len, uint8_t n) {
+    uint8_t got_type, got_len, data[BLE_TLV_MAX_LEN];
+    TEST_ASSERT_TRUE(ble_uart_task(&got_type, data, &got_len));
+    TEST_ASSERT_EQUAL_UINT8(type, got_type);
+    TEST_ASSERT_EQUAL_UINT8(len, got_len);
+    for (uint8_t i = 0; i < len; i++) TEST_ASSERT_EQUAL_UINT8((uint8_t)(n + i), data[i]);
+}
+
+static ble_uart_stats_t s_before;
+
+// The counters run from power-on, so tests look at how much they moved.
+static ble_uart_stats_t stats_delta(void) {
+    ble_uart_stats_t now;
+    ble_uart_get_stats(&now);
+    now.frames -= s_before.frames;
+    now.overruns -= s_before.overruns;
+    now.crc_errors -= s_before.crc_errors;
+    now.length_errors -= s_before.length_errors;
+    now.wakes -= s_before.wakes;
+    now.rx_wakes -= s_before.rx_wakes;
+    return now;
+}
+
+void setUp(void) {
+    ble_uart_deinit();
+    ble_uart_set_crc(false);
+    ble_uart_init();
+    ble_uart_wake();
+    while (ble_uart_task(NULL, NULL, NULL));
+    ble_uart_get_stats(&s_before);
+    s_tx_len = 0;
+}
+
+void tearDown(void) {
+}
+
+static void test_back_to_back_frames_are_all_queued(void) {
+    uint8_t stream[BLE_UART_RX_QUEUE_LEN * (2 + BLE_TLV_MAX_LEN)];
+    size_t size = 0;
+    for (uint8_t n = 0; n < BLE_UART_RX_QUEUE_LEN; n++) {
+        size += make_frame(&stream[size], BLE_CMD_ECHO, n * 4, n, false);
+    }
+    inject(stream, size);
+
+    TEST_ASSERT_EQUAL_UINT8(BLE_UART_RX_QUEUE_LEN, ble_uart_frames_pending());
+    for (uint8_t n = 0; n < BLE_UART_RX_QUEUE_LEN; n++) expect_frame(BLE_CMD_ECHO, n * 4, n);
+    TEST_ASSERT_FALSE(ble_uart_task(NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL_UINT32(BLE_UART_RX_QUEUE_LEN, stats_delta().frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats_delta().overruns);
+}
+
+static void test_overflowing_the_queue_drops_newest_and_counts_it(void) {
+    uint8_t frame[2 + BLE_TLV_MAX_LEN];
+    for (uint8_t n = 0; n < BLE_UART_RX_QUEUE_LEN + 3; n++) {
+        inject(frame, make_frame(frame, BLE_CMD_PING, 1, n, false));
+    }
+
+    // the oldest frames survive, in order, and the parser is still in step afterwards.
+    for (uint8_t n = 0; n < BLE_UART_RX_QUEUE_LEN; n++) expect_frame(BLE_CMD_PING, 1, n);
+    TEST_ASSERT_FALSE(ble_uart_task(NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL_UINT32(3, stats_delta().overruns);
+
+    inject(frame, make_frame(frame, BLE_CMD_PING, 1, 42, false));
+    expect_frame(BLE_CMD_PING, 1, 42);
+}
+
+static void test_stream_with_slow_polling_loses_nothing(void) {
+    // 200 frames of 10 to 18 bytes, with the main loop only looking every 40 bytes: at 9600 baud,
+    // about 40 ms of being busy at a time, in which no more than a queue's worth of frames can arrive.
+    uint8_t stream[200 * (2 + BLE_TLV_MAX_LEN)];
+    size_t size = 0;
+    for (int n = 0; n < 200; n++) {
+        size += make_frame(&stream[size], 1 + n % 0x7F, 8 + n % 9, n, false);
+    }
+
+    int expected = 0;
+    for (size_t pos = 0; pos < size; pos += 40) {
+        inject(&stream[pos], (size - pos < 40) ? size - pos : 40);
+        while (ble_uart_frames_pending()) {
+            expect_frame(1 + expected % 0x7F, 8 + expected % 9, expected);
+            expected++;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(200, expected);
+    TEST_ASSERT_EQUAL_UINT32(0, stats_delta().overruns);
+}
+
+static void test_impossible_length_resets_the_parser(void) {
+    uint8_t bad[2] = {BLE_CMD_ECHO, BLE_TLV_MAX_LEN + 1};
+    uint8_t frame[2 + BLE_TLV_MAX_LEN];
+    inject(bad, sizeof(bad));
+    inject(frame, make_frame(frame, BLE_CMD_GET_TIME, 6, 7, false));
+
+    expect_frame(BLE_CMD_GET_TIME, 6, 7);
+    TEST_ASSERT_EQUAL_UINT32(1, stats_delta().length_errors);
+}
+
+static void test_crc_accepts_good_frames_and_counts_bad_ones(void) {
+    ble_uart_set_crc(true);
+    uint8_t frame[2 + BLE_TLV_MAX_LEN + 2];
+    size_t size = make_frame(frame, BLE_CMD_ECHO, 4, 0xDE, true);
+    inject(frame, size);
+    expect_frame(BLE_CMD_ECHO, 4, 0xDE);
+
+    frame[3] ^= 0x01;
+    inject(frame, size);
+    TEST_ASSERT_FALSE(ble_uart_task(NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL_UINT32(1, stats_delta().crc_errors);
+
+    // zero-length frames carry a CRC too.
+    inject(frame, make_frame(frame, BLE_CMD_PING, 0, 0, true));
+    expect_frame(BLE_CMD_PING, 0, 0);
+}
+
+static void test_send_appends_crc_when_enabled(void) {
+    const uint8_t value[2] = {0x04, 0x05};
+    uint8_t expected[2 + 2 + 2];
+
+    ble_uart_send(BLE_CMD_SEND_KEY, value, 2);
+    TEST_ASSERT_EQUAL(4, s_tx_len);
+
+    ble_uart_set_crc(true);
+    s_tx_len = 0;
+    ble_uart_send(BLE_CMD_SEND_KEY, value, 2);
+    size_t size = make_frame(expected, BLE_CMD_SEND_KEY, 2, 0x04, true);
+    TEST_ASSERT_EQUAL(size, s_tx_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, s_tx, size);
+}
+
+static void test_long_messages_are_sent_as_fragments(void) {
+    uint8_t message[BLE_TLV_MAX_LEN * 2 + 8];
+    for (uint8_t i = 0; i < sizeof(message); i++) message[i] = i;
+    ble_uart_send_long(BLE_CMD_SEND_STRING, message, sizeof(message));
+
+    // every fragment but the last is full and has the MORE bit set.
+    uint8_t expected[2 + BLE_TLV_MAX_LEN];
+    size_t pos = 0;
+    for (uint8_t offset = 0; offset < sizeof(message); offset += BLE_TLV_MAX_LEN) {
+        bool last = sizeof(message) - offset <= BLE_TLV_MAX_LEN;
+        uint8_t type = last ? BLE_CMD_SEND_STRING : (BLE_CMD_SEND_STRING | BLE_TLV_MORE);
+        size_t size = make_frame(expected, type, last ? sizeof(message) - offset : BLE_TLV_MAX_LEN, offset, false);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &s_tx[pos], size);
+        pos += size;
+    }
+    TEST_ASSERT_EQUAL(pos, s_tx_len);
+
+    // a message that fits in one frame goes out as a plain frame.
+    s_tx_len = 0;
+    ble_uart_send_long(BLE_CMD_SEND_STRING, message, 3);
+    TEST_ASSERT_EQUAL(5, s_tx_len);
+    TEST_ASSERT_EQUAL_UINT8(BLE_CMD_SEND_STRING, s_tx[0]);
+}
+
+static void test_tx_room_is_what_fits_in_the_ring(void) {
+    uint8_t message[BLE_MESSAGE_MAX_LEN] = { 0 };
+    for (int crc = 0; crc < 2; crc++) {
+        ble_uart_set_crc(crc);
+        s_tx_len = 0;
+        uint8_t room = ble_uart_tx_room();
+        TEST_ASSERT_GREATER_THAN_UINT8(0, room);
+        ble_uart_send_long(BLE_CMD_SEND_STRING, message, room);
+        TEST_ASSERT_LESS_OR_EQUAL(WATCH_UART_TX_BUF_SZ - 1, s_tx_len);
+
+        // a byte more would not have fitted.
+        s_tx_len = 0;
+        ble_uart_send_long(BLE_CMD_SEND_STRING, message, room + 1);
+        TEST_ASSERT_GREATER_THAN(WATCH_UART_TX_BUF_SZ - 1, s_tx_len);
+
+        // and what's queued leaves that much less room.
+        s_tx_len = 2 + BLE_TLV_MAX_LEN;
+        TEST_ASSERT_LESS_THAN_UINT8(room, ble_uart_tx_room());
+    }
+}
+
+static void test_baud_rate_survives_parking(void) {
+    ble_uart_set_baud(115200);
+    TEST_ASSERT_EQUAL_UINT32(115200, s_baud);
+    ble_uart_park();
+    ble_uart_wake();
+    TEST_ASSERT_EQUAL_UINT32(115200, s_baud);
+    TEST_ASSERT_NOT_NULL(s_rx_callback);
+
+    ble_uart_set_baud(BLE_UART_BAUD);
+    TEST_ASSERT_EQUAL_UINT32(BLE_UART_BAUD, ble_uart_get_baud());
+}
+
+static void test_queued_frames_survive_parking(void) {
+    uint8_t frame[2 + BLE_TLV_MAX_LEN];
+    inject(frame, make_frame(frame, BLE_CMD_PING, 1, 1, false));
+    // the next frame is cut off by parking; its remains must not be taken as a frame start.
+    inject(frame, 2);
+    ble_uart_park();
+    ble_uart_wake();
+    inject(frame, make_frame(frame, BLE_CMD_PING, 1, 2, false));
+
+    expect_frame(BLE_CMD_PING, 1, 1);
+    expect_frame(BLE_CMD_PING, 1, 2);
+    TEST_ASSERT_FALSE(ble_uart_task(NULL, NULL, NULL));
+}
+
+static void test_quiet_uart_parks_itself(void) {
+    uint8_t frame[2 + BLE_TLV_MAX_LEN];
+    for (int i = 0; i < BLE_UART_IDLE_TICKS - 1; i++) ble_uart_fast_tick();
+    // traffic restarts the idle clock.
+    inject(frame, make_frame(frame, BLE_CMD_PING, 1, 1, false));
+    ble_uart_fast_tick();
+    TEST_ASSERT_FALSE(ble_uart_park_if_idle());
+    TEST_ASSERT_TRUE(ble_uart_is_awake());
+
+    for (int i = 0; i < BLE_UART_IDLE_TICKS; i++) ble_uart_fast_tick();
+    TEST_ASSERT_TRUE(ble_uart_park_if_idle());
+    TEST_ASSERT_FALSE(ble_uart_is_awake());
+    TEST_ASSERT_NULL(s_rx_callback);
+    TEST_ASSERT_NOT_NULL(s_edge_callback);
+    TEST_ASSERT_EQUAL(INTERRUPT_TRIGGER_FALLING, s_edge_trigger);
+    expect_frame(BLE_CMD_PING, 1, 1);
+}
+
+static void test_rx_edge_wakes_parked_uart(void) {
+    ble_uart_park();
+    TEST_ASSERT_FALSE(ble_uart_is_awake());
+
+    // the nRF's wake byte pulls RX low, which the EIC sees; the UART comes up in the interrupt itself,
+    // in time for the frame, without waiting for the main loop.
+    s_edge_callback();
+    TEST_ASSERT_TRUE(ble_uart_is_awake());
+    TEST_ASSERT_EQUAL(INTERRUPT_TRIGGER_NONE, s_edge_trigger);
+    TEST_ASSERT_EQUAL_UINT32(1, stats_delta().rx_wakes);
+
+    uint8_t frame[2 + BLE_TLV_MAX_LEN];
+    size_t size = make_frame(frame, BLE_CMD_GET_TIME, 6, 3, false);
+    // a wake byte sent while the UART is already up is skipped too.
+    const uint8_t wake = BLE_UART_WAKE_BYTE;
+    inject(&wake, 1);
+    inject(frame, size);
+    expect_frame(BLE_CMD_GET_TIME, 6, 3);
+}
+
+static void test_send_wakes_parked_uart(void) {
+    const uint8_t value = 0x01;
+    ble_uart_park();
+    ble_uart_send(BLE_CMD_BLE_CTRL, &value, 1);
+    TEST_ASSERT_TRUE(ble_uart_is_awake());
+    TEST_ASSERT_EQUAL(3, s_tx_len);
+    TEST_ASSERT_EQUAL_UINT32(0, stats_delta().rx_wakes);
+
+    // nothing is sent, and nothing wakes, once the UART is off.
+    ble_uart_deinit();
+    s_tx_len = 0;
+    ble_uart_send(BLE_CMD_BLE_CTRL, &value, 1);
+    TEST_ASSERT_FALSE(ble_uart_is_awake());
+    TEST_ASSERT_EQUAL(0, s_tx_len);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_back_to_back_frames_are_all_queued);
+    RUN_TEST(test_overflowing_the_queue_drops_newest_and_counts_it);
+    RUN_TEST(test_stream_with_slow_polling_loses_nothing);
+    RUN_TEST(test_impossible_length_resets_the_parser);
+    RUN_TEST(test_crc_accepts_good_frames_and_counts_bad_ones);
+    RUN_TEST(test_send_appends_crc_when_enabled);
+    RUN_TEST(test_long_messages_are_sent_as_fragments);
+    RUN_TEST(test_tx_room_is_what_fits_in_the_ring);
+    RUN_TEST(test_baud_rate_survives_parking);
+    RUN_TEST(test_queued_frames_survive_parking);
+    RUN_TEST(test_quiet_uart_parks_itself);
+    RUN_TEST(test_rx_edge_wakes_parked_uart);
+    RUN_TEST(test_send_wakes_parked_uart);
+    return UNITY_END();
+}
@@ -0,0 +1,136 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host tests for the /ext littlefs volume, run against the RAM flash emulator used by the simulator.
+// Build and run with `make` in this directory.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "lfs.h"
+#include "filesystem_ext.h"
+#include "filesystem_config.h"
+#include "spiflash.h"
+#include "unity.h"
+
+static lfs_t lfs;
+static lfs_file_t file;
+
+void setUp(void) {
+    spi_flash_init();
+    spi_flash_command(CMD_ENABLE_WRITE);
+    spi_flash_command(CMD_CHIP_ERASE);
+}
+
+void tearDown(void) {
+}
+
+static void test_emulator_behaves_like_nor(void) {
+    uint8_t data[4] = {0xF0, 0x0F, 0x00, 0xFF};
+    uint8_t readback[4];
+
+    // programming without the write enable latch does nothing.
+    spi_flash_write_data(0, data, 4);
+    spi_flash_read_data(0, readback, 4);
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xFF, readback, 4);
+
+    // programming can only clear bits.
+    spi_flash_program(0, data, 4);
+    uint8_t more[4] = {0x3C, 0x3C, 0x3C, 0x3C};
+    spi_flash_program(0, more, 4);
+    spi_flash_read_data(0, readback, 4);
+    uint8_t expected[4] = {0x30, 0x0C, 0x00, 0x3C};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, readback, 4);
+
+    // erasing works on the whole sector, and only that sector.
+    spi_flash_program(SPI_FLASH_SECTOR_SIZE, data, 4);
+    spi_flash_erase_sector(100);
+    spi_flash_read_data(0, readback, 4);
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xFF, readback, 4);
+    spi_flash_read_data(SPI_FLASH_SECTOR_SIZE, readback, 4);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, readback, 4);
+}
+
+static void test_program_splits_at_page_boundaries(void) {
+    uint8_t data[300];
+    uint8_t readback[300];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = i;
+
+    spi_flash_program(SPI_FLASH_PAGE_SIZE - 10, data, sizeof(data));
+    spi_flash_read_data(SPI_FLASH_PAGE_SIZE - 10, readback, sizeof(readback));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, readback, sizeof(data));
+}
+
+static void test_format_mount_and_remount(void) {
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_format(&lfs, &filesystem_ext_cfg));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_mount(&lfs, &filesystem_ext_cfg));
+
+    const char *text = "hello from the external flash\n";
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_open(&lfs, &file, "hello.txt", LFS_O_WRONLY | LFS_O_CREAT));
+    TEST_ASSERT_EQUAL((lfs_ssize_t)strlen(text), lfs_file_write(&lfs, &file, text, strlen(text)));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_close(&lfs, &file));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_unmount(&lfs));
+
+    char buf[64] = {0};
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_mount(&lfs, &filesystem_ext_cfg));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_open(&lfs, &file, "hello.txt", LFS_O_RDONLY));
+    TEST_ASSERT_EQUAL((lfs_ssize_t)strlen(text), lfs_file_read(&lfs, &file, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING(text, buf);
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_close(&lfs, &file));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_unmount(&lfs));
+}
+
+static void test_page_appends_span_blocks(void) {
+    // the same pattern accelerometer_data_acquisition_face uses: one 256-byte page per append.
+    uint8_t page[256];
+    const int page_count = 3 * FILESYSTEM_EXT_BLOCK_SIZE / sizeof(page);
+
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_format(&lfs, &filesystem_ext_cfg));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_mount(&lfs, &filesystem_ext_cfg));
+    for (int i = 0; i < page_count; i++) {
+        memset(page, i, sizeof(page));
+        TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_open(&lfs, &file, "accel.dat", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND));
+        TEST_ASSERT_EQUAL((lfs_ssize_t)sizeof(page), lfs_file_write(&lfs, &file, page, sizeof(page)));
+        TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_close(&lfs, &file));
+    }
+
+    uint8_t readback[256];
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_open(&lfs, &file, "accel.dat", LFS_O_RDONLY));
+    TEST_ASSERT_EQUAL(page_count * (lfs_soff_t)sizeof(page), lfs_file_size(&lfs, &file));
+    for (int i = 0; i < page_count; i++) {
+        TEST_ASSERT_EQUAL((lfs_ssize_t)sizeof(readback), lfs_file_read(&lfs, &file, readback, sizeof(readback)));
+        TEST_ASSERT_EACH_EQUAL_UINT8((uint8_t)i, readback, sizeof(readback));
+    }
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_file_close(&lfs, &file));
+    TEST_ASSERT_EQUAL(LFS_ERR_OK, lfs_unmount(&lfs));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_emulator_behaves_like_nor);
+    RUN_TEST(test_program_splits_at_page_boundaries);
+    RUN_TEST(test_format_mount_and_remount);
+    RUN_TEST(test_page_appends_span_blocks);
+    return UNITY_END();
+}
@@ -0,0 +1,167 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "notification_face.h"
+#include "watch.h"
+#include "watch_private_display.h"
+
+#define NOTIFICATION_FACE_TICK_FREQ 4
+// ticks to hold the text still at either end before it scrolls
+#define NOTIFICATION_FACE_HOLD_TICKS 6
+
+static const char *_app_label(uint8_t app) {
+    switch (app) {
+        case BLE_NOTIFY_APP_CALL: return "CA";
+        case BLE_NOTIFY_APP_SMS: return "SM";
+        case BLE_NOTIFY_APP_EMAIL: return "EM";
+        case BLE_NOTIFY_APP_CALENDAR: return "CL";
+        case BLE_NOTIFY_APP_SOCIAL: return "SO";
+        default: return "NO";
+    }
+}
+
+// Fetches the notification to show; reading one that was moved to flash costs a file read, so
+// this happens only when the index or the number of notifications changes, not on every tick.
+static void _fetch(notification_state_t *state) {
+    ble_notification_t notification;
+    state->count = ble_notify_count();
+    if (state->index >= state->count) state->index = 0;
+    state->scroll = 0;
+    state->hold = NOTIFICATION_FACE_HOLD_TICKS;
+    if (state->count && ble_notify_get(state->index, &notification)) {
+        state->app = notification.app;
+        state->len = notification.len;
+        memcpy(state->text, notification.text, notification.len + 1);
+    } else {
+        state->app = BLE_NOTIFY_APP_OTHER;
+        state->len = 0;
+        state->text[0] = '\0';
+    }
+}
+
+static void _display(notification_state_t *state) {
+    char buf[11];
+    if (state->count == 0) {
+        watch_display_string("NO   none ", 0);
+        return;
+    }
+    sprintf(buf, "%s%2d", _app_label(state->app), (state->index + 1) % 100);
+    watch_display_string(buf, 0);
+    for (uint8_t i = 0; i < 6; i++) {
+        uint8_t pos = state->scroll + i;
+        watch_display_character(pos < state->len ? state->text[pos] : ' ', 4 + i);
+    }
+}
+
+// Holds the text still for a moment at each end, and scrolls it one character a tick in between.
+static void _scroll(notification_state_t *state) {
+    if (state->len <= 6) return;
+    if (state->hold) {
+        state->hold--;
+        return;
+    }
+    if (state->scroll + 6 >= state->len) {
+        state->scroll = 0;
+        state->hold = NOTIFICATION_FACE_HOLD_TICKS;
+    } else if (++state->scroll + 6 >= state->len) {
+        state->hold = NOTIFICATION_FACE_HOLD_TICKS;
+    }
+    _display(state);
+}
+
+void notification_face_setup(movement_settings_t *settings, uint8_t watch_face_index, void ** context_ptr) {
+    (void) settings;
+    (void) watch_face_index;
+    if (*context_ptr == NULL) {
+        *context_ptr = malloc(sizeof(notification_state_t));
+        memset(*context_ptr, 0, sizeof(notification_state_t));
+    }
+}
+
+void notification_face_activate(movement_settings_t *settings, void *context) {
+    (void) settings;
+    notification_state_t *state = (notification_state_t *)context;
+    state->index = 0;
+    _fetch(state);
+    ble_notify_mark_read();
+    movement_request_tick_frequency(NOTIFICATION_FACE_TICK_FREQ);
+}
+
+bool notification_face_loop(movement_event_t event, movement_settings_t *settings, void *context) {
+    notification_state_t *state = (notification_state_t *)context;
+
+    switch (event.event_type) {
+        case EVENT_ACTIVATE:
+            _display(state);
+            break;
+        case EVENT_TICK:
+            if (ble_notify_count() != state->count) {
+                // a new one arrived, or some were deleted from the shell
+                state->index = 0;
+                _fetch(state);
+                ble_notify_mark_read();
+                _display(state);
+            } else {
+                _scroll(state);
+            }
+            break;
+        case EVENT_ALARM_BUTTON_UP:
+            if (state->count) {
+                state->index = (state->index + 1) % state->count;
+                _fetch(state);
+                _display(state);
+            }
+            break;
+        case EVENT_LIGHT_BUTTON_UP:
+            if (state->count) {
+                state->index = (state->index + state->count - 1) % state->count;
+                _fetch(state);
+                _display(state);
+            }
+            break;
+        case EVENT_LIGHT_BUTTON_DOWN:
+            // LIGHT moves through the notifications instead
+            break;
+        case EVENT_ALARM_LONG_PRESS:
+            ble_notify_clear();
+            _fetch(state);
+            _display(state);
+            break;
+        case EVENT_TIMEOUT:
+            movement_move_to_face(0);
+            break;
+        default:
+            return movement_default_loop_handler(event, settings);
+    }
+
+    return true;
+}
+
+void notification_face_resign(movement_settings_t *settings, void *context) {
+    (void) settings;
+    (void) context;
+    movement_request_tick_frequency(1);
+}
@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NOTIFICATION_FACE_H_
+#define NOTIFICATION_FACE_H_
+
+/*
+ * NOTIFICATION face
+ *
+ * Shows the phone notifications mirrored over BLE (see ble_notify.h),
+ * newest first. The day-of-week digits show where the notification came
+ * from (CA call, SM message, EM email, CL calendar, SO social, NO
+ * anything else), the day digits its number, and the main display
+ * scrolls its text.
+ *
+ * Notifications are received, and the buzzer cue played, whichever face
+ * is on screen; this face just shows them. If one arrives while it's
+ * on screen, it jumps to it.
+ *
+ * Short-press ALARM to show the next (older) notification.
+ * Short-press LIGHT to show the previous (newer) one.
+ * Long-press ALARM to delete them all.
+ */
+
+#include "movement.h"
+#include "ble_notify.h"
+
+typedef struct {
+    uint16_t index;         // which notification is shown, 0 for the newest
+    uint16_t count;         // how many there were when it was fetched
+    uint8_t scroll;         // first character on the display
+    uint8_t hold;           // ticks left before the text moves
+    uint8_t app;
+    uint8_t len;
+    char text[BLE_NOTIFY_TEXT_MAX + 1];
+} notification_state_t;
+
+void notification_face_setup(movement_settings_t *settings, uint8_t watch_face_index, void ** context_ptr);
+void notification_face_activate(movement_settings_t *settings, void *context);
+bool notification_face_loop(movement_event_t event, movement_settings_t *settings, void *context);
+void notification_face_resign(movement_settings_t *settings, void *context);
+
+#define notification_face ((const watch_face_t){ \
+    notification_face_setup, \
+    notification_face_activate, \
+    notification_face_loop, \
+    notification_face_resign, \
+    NULL, \
+})
+
+#endif // NOTIFICATION_FACE_H_
@@ -38,6 +38,7 @@
 #include "watch_utility.h"
 #include "TOTP.h"
 #include "base32.h"
+#include "ble_hid.h"
 
 #ifndef TOTP_FACE_MAX_KEY_LENGTH
 #define TOTP_FACE_MAX_KEY_LENGTH 128
@@ -226,8 +227,15 @@ bool totp_face_loop(movement_event_t event, movement_settings_t *settings, void
             totp_generate_and_display(totp_state);
 
             break;
-        case EVENT_ALARM_BUTTON_DOWN:
         case EVENT_ALARM_LONG_PRESS:
+            if (totp_state->current_decoded_key_length > 0) {
+                // type the code on the paired host
+                char code[7];
+                sprintf(code, "%06lu", totp_state->current_code);
+                ble_hid_type(code);
+            }
+            break;
+        case EVENT_ALARM_BUTTON_DOWN:
         case EVENT_LIGHT_BUTTON_DOWN:
             break;
         case EVENT_LIGHT_LONG_PRESS:
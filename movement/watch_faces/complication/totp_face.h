@@ -64,7 +64,8 @@
  *
  * If you have more than one secret key, press ALARM to cycle through them.
  * Press LIGHT to cycle in the other direction or keep it pressed longer to
- * activate the light.
+ * activate the light. Hold ALARM to type the current code on the host
+ * paired over BLE.
  */
 
 #include "movement.h"
@@ -27,13 +27,38 @@
 #include "accelerometer_data_acquisition_face.h"
 #include "watch_utility.h"
 #include "lis2dw.h"
-#include "spiflash.h"
+#include "filesystem.h"
+#include "filesystem_config.h"
+#include "movement_log.h"
 
 #define ACCELEROMETER_RANGE LIS2DW_RANGE_4_G
 #define ACCELEROMETER_LPMODE LIS2DW_LP_MODE_2
 #define ACCELEROMETER_FILTER LIS2DW_BANDWIDTH_FILTER_DIV2
 #define ACCELEROMETER_LOW_NOISE true
 #define SECONDS_TO_RECORD 15
+#ifndef ACCELEROMETER_DATA_ACQUISITION_INTERNAL
+#define ACCELEROMETER_DATA_ACQUISITION_INTERNAL 0
+#endif
+#if FILESYSTEM_ENABLE_EXT
+#define HAVE_DATA_VOLUME 1
+#define DATA_VOLUME FILESYSTEM_EXT_PREFIX
+#define DATA_FILE FILESYSTEM_EXT_PREFIX "/accel.dat"
+#define SPARE_SPACE FILESYSTEM_EXT_BLOCK_SIZE
+#elif ACCELEROMETER_DATA_ACQUISITION_INTERNAL
+// only when asked for: the 8 KB internal filesystem has room for a couple of captures, and every page
+// written to it wears the same few rows everything else lives in.
+#define HAVE_DATA_VOLUME 1
+#define DATA_VOLUME "/"
+#define DATA_FILE "accel.dat"
+#define SPARE_SPACE 1024
+#else
+// nowhere to record; the face says so rather than filling the internal filesystem.
+#define HAVE_DATA_VOLUME 0
+#define DATA_VOLUME NULL
+#define DATA_FILE NULL
+#define SPARE_SPACE 0
+#endif
+#define PAGE_SIZE sizeof(((accelerometer_data_acquisition_state_t *)0)->records)
 
 static const char activity_types[][3] = {
     "TE",   // Testing
@@ -59,9 +84,7 @@ static void advance_current_setting(accelerometer_data_acquisition_state_t *stat
 static void start_reading(accelerometer_data_acquisition_state_t *state, movement_settings_t *settings);
 static void continue_reading(accelerometer_data_acquisition_state_t *state);
 static void finish_reading(accelerometer_data_acquisition_state_t *state);
-static bool wait_for_flash_ready(void);
-static int16_t get_next_available_page(void);
-static void write_buffer_to_page(uint8_t *buf, uint16_t page);
+static void update_free_space(accelerometer_data_acquisition_state_t *state);
 static void write_page(accelerometer_data_acquisition_state_t *state);
 static void log_data_point(accelerometer_data_acquisition_state_t *state, lis2dw_reading_t reading, uint8_t centiseconds);
 
@@ -76,26 +99,12 @@ void accelerometer_data_acquisition_face_setup(movement_settings_t *settings, ui
         state->beep_with_countdown = true;
         state->countdown_length = 3;
     }
-    spi_flash_init();
-    wait_for_flash_ready();
-    uint8_t buf[256] = {0xFF};
-    spi_flash_read_data(0, buf, 256);
-    if (buf[0] & 0xF0) {
-        // mark first four pages as used
-        buf[0] = 0x0F;
-        wait_for_flash_ready();
-        watch_set_pin_level(A3, false);
-        spi_flash_command(CMD_ENABLE_WRITE);
-        wait_for_flash_ready();
-        spi_flash_write_data(0, buf, 256);
-    }
-
 }
 
 void accelerometer_data_acquisition_face_activate(movement_settings_t *settings, void *context) {
     (void) settings;
     accelerometer_data_acquisition_state_t *state = (accelerometer_data_acquisition_state_t *)context;
-    state->next_available_page = get_next_available_page();
+    update_free_space(state);
 }
 
 bool accelerometer_data_acquisition_face_loop(movement_event_t event, movement_settings_t *settings, void *context) {
@@ -117,14 +126,14 @@ bool accelerometer_data_acquisition_face_loop(movement_event_t event, movement_s
                     }
                     break;
                 case ACCELEROMETER_DATA_ACQUISITION_MODE_COUNTDOWN:
-                    if (state->next_available_page < 0) {
+                    if (state->percent_free < 0) {
                         state->countdown_ticks = 0;
                         state->repeat_ticks = 0;
                         state->mode = ACCELEROMETER_DATA_ACQUISITION_MODE_IDLE;
                     }
                     if (state->countdown_ticks > 0) {
                         state->countdown_ticks--;
-                        printf("countdown: %d\n", state->countdown_ticks);
+                        MOVEMENT_LOG_DEBUG("countdown: %d", state->countdown_ticks);
                         if (state->countdown_ticks == 0) {
                             // at zero, begin reading
                             state->mode = ACCELEROMETER_DATA_ACQUISITION_MODE_SENSING;
@@ -183,13 +192,13 @@ bool accelerometer_data_acquisition_face_loop(movement_event_t event, movement_s
             movement_illuminate_led();
             break;
         case EVENT_ALARM_BUTTON_UP:
-            printf("Alarm up! Mode is %d\n", state->mode);
+            MOVEMENT_LOG_DEBUG("Alarm up! Mode is %d", state->mode);
             switch (state->mode) {
                 case ACCELEROMETER_DATA_ACQUISITION_MODE_IDLE:
                     state->countdown_ticks = state->countdown_length;
-                    printf("Setting countdown ticks to %d\n", state->countdown_ticks);
+                    MOVEMENT_LOG_DEBUG("Setting countdown ticks to %d", state->countdown_ticks);
                     state->mode = ACCELEROMETER_DATA_ACQUISITION_MODE_COUNTDOWN;
-                    printf("and mode to %d\n", state->mode);
+                    MOVEMENT_LOG_DEBUG("and mode to %d", state->mode);
                     update(state);
                     break;
                 case ACCELEROMETER_DATA_ACQUISITION_MODE_COUNTDOWN:
@@ -207,7 +216,7 @@ bool accelerometer_data_acquisition_face_loop(movement_event_t event, movement_s
             }
             break;
         case EVENT_ALARM_LONG_PRESS:
-            printf("Alarm long\n");
+            MOVEMENT_LOG_DEBUG("Alarm long");
             if (state->mode == ACCELEROMETER_DATA_ACQUISITION_MODE_IDLE) {
                 state->repeat_ticks = 0;
                 state->mode = ACCELEROMETER_DATA_ACQUISITION_MODE_SETTINGS;
@@ -259,14 +268,15 @@ static void update(accelerometer_data_acquisition_state_t *state) {
     sprintf(buf, "%s%2dre%2d#o",
             activity_types[state->activity_type_index],
             ticks,
-            (8192 - state->next_available_page) / 82);
+            max(state->percent_free, 0));
     watch_display_string(buf, 0);
 
     watch_set_colon();
 
-    // special case: display full if full, <1% if nearly full
-    if (state->next_available_page < 0) watch_display_string(" FUL", 6);
-    else if (state->next_available_page > 8110) watch_display_string("<1", 6);
+    // special case: display no volume if there's none, full if full, <1% if nearly full
+    if (state->percent_free == -2) watch_display_string("noFS", 6);
+    else if (state->percent_free < 0) watch_display_string(" FUL", 6);
+    else if (state->percent_free == 0) watch_display_string("<1", 6);
 
     // Bell if beep enabled
     if (state->beep_with_countdown) watch_set_indicator(WATCH_INDICATOR_BELL);
@@ -329,85 +339,35 @@ static void advance_current_setting(accelerometer_data_acquisition_state_t *stat
     }
 }
 
-static int16_t get_next_available_page(void) {
-    uint8_t buf[256] = {0};
-
-    uint16_t page = 0;
-    for(int16_t i = 0; i < 4; i++) {
-        wait_for_flash_ready();
-        spi_flash_read_data(i * 256, buf, 256);
-        for(int16_t j = 0; j < 256; j++) {
-            if(buf[j] == 0) {
-                page += 8;
-            } else {
-                page += __builtin_clz(((uint32_t)buf[j]) << 24);
-                break;
-            }
-        }
-    }
-
-    if (page >= 8192) return -1;
-
-    return page;
+static void update_percent_free(accelerometer_data_acquisition_state_t *state) {
+    // percent_free is -2 when there's no volume to record to, and -1 when it can't take another page.
+    if (state->volume_size <= 0) state->percent_free = -2;
+    else if (state->free_bytes < (int32_t)(PAGE_SIZE + SPARE_SPACE)) state->percent_free = -1;
+    else state->percent_free = min(99, (int64_t)state->free_bytes * 100 / state->volume_size);
 }
 
-static void write_buffer_to_page(uint8_t *buf, uint16_t page) {
-    uint32_t address = 256 * page;
-
-    wait_for_flash_ready();
-    watch_set_pin_level(A3, false);
-    spi_flash_command(CMD_ENABLE_WRITE);
-    wait_for_flash_ready();
-    watch_set_pin_level(A3, false);
-    spi_flash_write_data(address, buf, 256);
-    wait_for_flash_ready();
-
-    uint8_t buf2[256];
-    watch_set_pin_level(A3, false);
-    spi_flash_read_data(address, buf2, 256);
-    wait_for_flash_ready();
-
-    uint8_t used_pages[256] = {0xFF};
-    uint16_t address_to_mark_used = page / 8;
-    uint8_t header_page = address_to_mark_used / 256;
-    uint8_t used_byte = 0x7F >> (page % 8);
-    uint8_t offset_in_buf = address_to_mark_used % 256;
-
-    printf("\twrite 256 bytes to address %ld, page %d.\n", address, page);
-    for(int i = 0; i < 256; i++) {
-        if (buf[i] != buf2[i]) {
-            printf("\tData mismatch detected at offset  %d: %d != %d.\n", i, buf[i], buf2[i]);
-        }
+static void update_free_space(accelerometer_data_acquisition_state_t *state) {
+    if (!HAVE_DATA_VOLUME) {
+        MOVEMENT_LOG_ERROR("No volume to record to: build with FILESYSTEM_EXT=1, or ACCELEROMETER_DATA_ACQUISITION_INTERNAL=1.");
+        state->volume_size = 0;
+        update_percent_free(state);
+        return;
     }
-
-    watch_set_pin_level(A3, false);
-    spi_flash_read_data(header_page * 256, used_pages, 256);
-    used_pages[offset_in_buf] = used_byte;
-    watch_set_pin_level(A3, false);
-    spi_flash_command(CMD_ENABLE_WRITE);
-    wait_for_flash_ready();
-    watch_set_pin_level(A3, false);
-    spi_flash_write_data(header_page * 256, used_pages, 256);
-    wait_for_flash_ready();
-}
-
-static bool wait_for_flash_ready(void) {
-    watch_set_pin_level(A3, false);
-    bool ok = true;
-    uint8_t read_status_response[1] = {0x00};
-    do {
-        ok = spi_flash_read_command(CMD_READ_STATUS, read_status_response, 1);
-    } while ((read_status_response[0] & 0x3) != 0);
-    delay_ms(1); // why do i need this?
-    watch_set_pin_level(A3, true);
-    return ok;
+    // walking a large volume takes a while, so this is only done when the face comes up.
+    state->volume_size = filesystem_get_volume_size(DATA_VOLUME);
+    state->free_bytes = filesystem_get_volume_free_space(DATA_VOLUME);
+    update_percent_free(state);
 }
 
 static void write_page(accelerometer_data_acquisition_state_t *state) {
-    if (state->next_available_page > 0) {
-        write_buffer_to_page((uint8_t *)(state->records), state->next_available_page);
-        wait_for_flash_ready();
-        state->next_available_page++;
+    if (state->percent_free >= 0) {
+        if (filesystem_append_file(DATA_FILE, (char *)(state->records), PAGE_SIZE)) {
+            state->free_bytes -= PAGE_SIZE;
+        } else {
+            MOVEMENT_LOG_ERROR("Failed to append to %s.", DATA_FILE);
+            state->free_bytes = 0;
+        }
+        update_percent_free(state);
     }
     state->pos = 0;
     memset(state->records, 0xFF, sizeof(state->records));
@@ -422,7 +382,7 @@ static void log_data_point(accelerometer_data_acquisition_state_t *state, lis2dw
     record.data.y.accel = (reading.y >> 2) + 8192;
     record.data.z.accel = (reading.z >> 2) + 8192;
     record.data.counter = 100 * (SECONDS_TO_RECORD - state->reading_ticks + 1) + centiseconds;
-    printf("logged data point for %d\n", record.data.counter);
+    MOVEMENT_LOG_DEBUG("logged data point for %d", record.data.counter);
     state->records[state->pos++] = record;
     if (state->pos >= 32) {
         write_page(state);
@@ -430,7 +390,7 @@ static void log_data_point(accelerometer_data_acquisition_state_t *state, lis2dw
 }
 
 static void start_reading(accelerometer_data_acquisition_state_t *state, movement_settings_t *settings) {
-    printf("Start reading\n");
+    MOVEMENT_LOG_DEBUG("Start reading");
     watch_enable_i2c();
     lis2dw_begin();
     lis2dw_set_data_rate(LIS2DW_DATA_RATE_25_HZ);
@@ -456,7 +416,7 @@ static void start_reading(accelerometer_data_acquisition_state_t *state, movemen
 }
 
 static void continue_reading(accelerometer_data_acquisition_state_t *state) {
-    printf("Continue reading\n");
+    MOVEMENT_LOG_DEBUG("Continue reading");
     lis2dw_fifo_t fifo;
     lis2dw_read_fifo(&fifo);
 
@@ -470,7 +430,7 @@ static void continue_reading(accelerometer_data_acquisition_state_t *state) {
 }
 
 static void finish_reading(accelerometer_data_acquisition_state_t *state) {
-    printf("Finish reading\n");
+    MOVEMENT_LOG_DEBUG("Finish reading");
     if (state->pos != 0) {
         write_page(state);
     }
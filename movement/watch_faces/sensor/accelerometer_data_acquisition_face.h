@@ -29,6 +29,11 @@
  * ACCELEROMETER DATA ACQUISITION
  *
  * TODO: Add description here, including controls.
+ *
+ * Recordings are appended to /ext/accel.dat as 256-byte pages of records, so this face needs a
+ * build with FILESYSTEM_EXT=1 and the motion sensor board's SPI flash. Without them it shows
+ * "noFS" and won't record, unless built with ACCELEROMETER_DATA_ACQUISITION_INTERNAL=1 to record
+ * to accel.dat on the small internal filesystem instead.
  */
 
 #include "movement.h"
@@ -90,8 +95,10 @@ typedef struct {
     bool beep_with_countdown;   // should we beep at the countdown
     uint8_t countdown_length;   // how many seconds to count down
     uint16_t repeat_interval;   // how many seconds to wait for a repeat
-    // info about the flash chip
-    int16_t next_available_page;
+    // info about the volume the data goes to
+    int8_t percent_free;        // -1 if the volume is full, -2 if it's missing
+    int32_t free_bytes;         // counted down as pages are written, rather than walking the volume
+    int32_t volume_size;
     // transient properties
     uint8_t countdown_ticks;
     uint8_t repeat_ticks;
@@ -0,0 +1,249 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host benchmark for the littlefs geometry profiles in movement/filesystem_config.h.
+// Replays typical face workloads through the real littlefs against a RAM model of the 8 KB RWWEE
+// array. The block device traffic it reports is counted; the times are not measured, but estimated
+// from the assumed per-operation costs below, so use them to compare profiles, not as on-device figures.
+// The workloads follow the calls faces make, rather than linking movement/filesystem.c, which
+// needs the watch hardware.
+// Build and run all profiles with `make run`, or a single one with e.g. `make filesystem_bench_THROUGHPUT`.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lfs.h"
+#include "filesystem_config.h"
+
+// Geometry of the SAM L22 RWWEE area, see watch_storage.h
+#define PAGE_SIZE 64
+#define ROW_SIZE 256
+#define ROW_COUNT 32
+
+// Assumed SAM L22 costs at 4 MHz, which turn operation counts into the estimated time. They are
+// guesses, not measurements; replace them with numbers from the `fsstat` shell command on real
+// hardware to make the estimates closer.
+#define READ_US_PER_CALL 10
+#define READ_US_PER_BYTE 1
+#define PROG_US_PER_PAGE 2500
+#define ERASE_US_PER_ROW 6000
+
+static uint8_t storage[ROW_SIZE * ROW_COUNT];
+
+typedef struct {
+    uint32_t reads;
+    uint32_t progs;
+    uint32_t erases;
+    uint32_t bytes_read;
+    uint32_t bytes_programmed;
+} bench_counters_t;
+
+static bench_counters_t counters;
+
+static int bench_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
+    (void) c;
+    memcpy(buffer, storage + block * ROW_SIZE + off, size);
+    counters.reads++;
+    counters.bytes_read += size;
+    return 0;
+}
+
+static int bench_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
+    (void) c;
+    // like the real flash, programming can only clear bits.
+    const uint8_t *src = buffer;
+    for (lfs_size_t i = 0; i < size; i++) storage[block * ROW_SIZE + off + i] &= src[i];
+    counters.progs++;
+    counters.bytes_programmed += size;
+    return 0;
+}
+
+static int bench_erase(const struct lfs_config *c, lfs_block_t block) {
+    (void) c;
+    memset(storage + block * ROW_SIZE, 0xFF, ROW_SIZE);
+    counters.erases++;
+    return 0;
+}
+
+static int bench_sync(const struct lfs_config *c) {
+    (void) c;
+    return 0;
+}
+
+static const struct lfs_config cfg = {
+    .read = bench_read,
+    .prog = bench_prog,
+    .erase = bench_erase,
+    .sync = bench_sync,
+
+    .read_size = FILESYSTEM_READ_SIZE,
+    .prog_size = PAGE_SIZE,
+    .block_size = ROW_SIZE,
+    .block_count = ROW_COUNT,
+    .cache_size = FILESYSTEM_CACHE_SIZE,
+    .lookahead_size = FILESYSTEM_LOOKAHEAD_SIZE,
+    .block_cycles = FILESYSTEM_BLOCK_CYCLES,
+};
+
+static lfs_t lfs;
+static lfs_file_t file;
+
+// These mirror the open / seek / read / close sequences in movement/filesystem.c.
+
+static int32_t bench_get_file_size(const char *filename) {
+    struct lfs_info info;
+    if (lfs_stat(&lfs, filename, &info) < 0 || info.type != LFS_TYPE_REG) return -1;
+    return info.size;
+}
+
+static void bench_write_file(const char *filename, const void *data, lfs_size_t length) {
+    if (lfs_file_open(&lfs, &file, filename, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC) < 0) return;
+    lfs_file_write(&lfs, &file, data, length);
+    lfs_file_close(&lfs, &file);
+}
+
+static void bench_append_file(const char *filename, const void *data, lfs_size_t length) {
+    if (lfs_file_open(&lfs, &file, filename, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) return;
+    lfs_file_write(&lfs, &file, data, length);
+    lfs_file_close(&lfs, &file);
+}
+
+static void bench_read_file(const char *filename, void *buf, int32_t length) {
+    int32_t file_size = bench_get_file_size(filename);
+    if (file_size <= 0) return;
+    if (lfs_file_open(&lfs, &file, filename, LFS_O_RDONLY) < 0) return;
+    lfs_file_read(&lfs, &file, buf, length < file_size ? length : file_size);
+    lfs_file_close(&lfs, &file);
+}
+
+static bool bench_read_line(const char *filename, char *buf, int32_t *offset, int32_t length) {
+    memset(buf, 0, length + 1);
+    int32_t file_size = bench_get_file_size(filename);
+    if (file_size <= 0) return false;
+    if (lfs_file_open(&lfs, &file, filename, LFS_O_RDONLY) < 0) return false;
+    lfs_file_seek(&lfs, &file, *offset, LFS_SEEK_SET);
+    int32_t to_read = file_size - *offset < length - 1 ? file_size - *offset : length - 1;
+    if (to_read > 0) lfs_file_read(&lfs, &file, buf, to_read);
+    for (int i = 0; i < length; i++) {
+        (*offset)++;
+        if (buf[i] == '\n') {
+            buf[i] = 0;
+            break;
+        }
+    }
+    lfs_file_close(&lfs, &file);
+    return true;
+}
+
+// totp_face_lfs: read every line of the URI file, as done on each activation.
+static void workload_totp_parse(void) {
+    for (int round = 0; round < 10; round++) {
+        char line[256];
+        int32_t offset = 0;
+        while (bench_read_line("totp_uris.txt", line, &offset, 255) && strlen(line));
+    }
+}
+
+// save_load_face: save all four 40-byte slots, then read them back.
+static void workload_save_load(void) {
+    uint8_t savefile[40];
+    char filename[23];
+    for (int round = 0; round < 25; round++) {
+        for (int slot = 0; slot < 4; slot++) {
+            memset(savefile, round + slot, sizeof(savefile));
+            sprintf(filename, "save_load_face_%d.bin", slot);
+            bench_write_file(filename, savefile, sizeof(savefile));
+        }
+        for (int slot = 0; slot < 4; slot++) {
+            sprintf(filename, "save_load_face_%d.bin", slot);
+            if (bench_get_file_size(filename) == sizeof(savefile)) bench_read_file(filename, savefile, sizeof(savefile));
+        }
+    }
+}
+
+// a data logger appending 8-byte records, rotating the file once it reaches 2 KB.
+static void workload_logger(void) {
+    uint8_t record[8];
+    for (int i = 0; i < 500; i++) {
+        memset(record, i, sizeof(record));
+        if (bench_get_file_size("log.bin") >= 2048) lfs_remove(&lfs, "log.bin");
+        bench_append_file("log.bin", record, sizeof(record));
+    }
+}
+
+// randonaut_face: check for and read place.loc on each activation, occasionally saving a new point.
+static void workload_randonaut(void) {
+    uint8_t place[8] = {0};
+    for (int i = 0; i < 200; i++) {
+        if (bench_get_file_size("place.loc") >= 0) bench_read_file("place.loc", place, sizeof(place));
+        if (i % 20 == 0) {
+            place[0] = i;
+            bench_write_file("place.loc", place, sizeof(place));
+        }
+    }
+}
+
+static void prepare_filesystem(void) {
+    static const char *uris[] = {
+        "otpauth://totp/Example:alice@example.com?secret=JBSWY3DPEHPK3PXP&issuer=Example\n",
+        "otpauth://totp/GitHub:alice?secret=KRSXG5CTMVRXEZLUKN2XAZLSKNSWG4TFOQ&issuer=GitHub&digits=6\n",
+        "otpauth://totp/Mail:alice@example.org?secret=GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ&algorithm=SHA256\n",
+        "otpauth://totp/Bank?secret=MFRGGZDFMZTWQ2LKNNWG23TPOBYXE43UOV3HO6DZPI&period=60\n",
+    };
+    memset(storage, 0xFF, sizeof(storage));
+    lfs_format(&lfs, &cfg);
+    lfs_mount(&lfs, &cfg);
+    for (int copy = 0; copy < 2; copy++) {
+        for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) bench_append_file("totp_uris.txt", uris[i], strlen(uris[i]));
+    }
+}
+
+static void run_workload(const char *name, void (*workload)(void)) {
+    memset(&counters, 0, sizeof(counters));
+    workload();
+    uint64_t us = (uint64_t)counters.reads * READ_US_PER_CALL + (uint64_t)counters.bytes_read * READ_US_PER_BYTE +
+                  (uint64_t)(counters.bytes_programmed / PAGE_SIZE) * PROG_US_PER_PAGE +
+                  (uint64_t)counters.erases * ERASE_US_PER_ROW;
+    printf("%-12s %7u %8u %6u %6u %9u %10.1f\n", name, counters.reads, counters.bytes_read, counters.progs,
+           counters.erases, counters.bytes_programmed, us / 1000.0);
+}
+
+int main(void) {
+    static const char *profile_names[] = {"balanced", "throughput"};
+    printf("profile: %s (read %d, cache %d, lookahead %d, block_cycles %d), ~%d bytes of heap\n",
+           profile_names[FILESYSTEM_PROFILE], FILESYSTEM_READ_SIZE, FILESYSTEM_CACHE_SIZE,
+           FILESYSTEM_LOOKAHEAD_SIZE, FILESYSTEM_BLOCK_CYCLES, 3 * FILESYSTEM_CACHE_SIZE + FILESYSTEM_LOOKAHEAD_SIZE);
+    printf("%-12s %7s %8s %6s %6s %9s %10s\n", "workload", "reads", "rd bytes", "progs", "erases", "pr bytes", "est. ms");
+
+    printf("(traffic counted through littlefs; times estimated from assumed costs, not measured)\n");
+
+    prepare_filesystem();
+    run_workload("totp", workload_totp_parse);
+    run_workload("save_load", workload_save_load);
+    run_workload("logger", workload_logger);
+    run_workload("randonaut", workload_randonaut);
+    lfs_unmount(&lfs);
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Reference client for the watch's binary RPC channel (see movement/SHELL_RPC.md).
+
+Usage:
+    swrpc.py PORT ping
+    swrpc.py PORT get REMOTE_PATH LOCAL_PATH
+    swrpc.py PORT put LOCAL_PATH REMOTE_PATH
+    swrpc.py PORT rm REMOTE_PATH
+    swrpc.py PORT time [now]
+    swrpc.py PORT backup
+    swrpc.py PORT log
+
+Requires pyserial.
+"""
+
+import binascii
+import datetime
+import struct
+import sys
+
+import serial
+
+SYNC = 0xA5
+RESPONSE = 0x80
+
+PING = 0x01
+INFO = 0x02
+FILE_READ = 0x10
+FILE_WRITE = 0x11
+FILE_STAT = 0x12
+FILE_REMOVE = 0x13
+RTC_GET = 0x20
+RTC_SET = 0x21
+BACKUP_DUMP = 0x30
+LOG_READ = 0x31
+
+STATUS = ["ok", "crc mismatch", "unknown command", "bad arguments", "filesystem error", "too long"]
+
+
+class RpcError(Exception):
+    pass
+
+
+class Watch:
+    def __init__(self, port, timeout=2.0):
+        self.port = serial.Serial(port, 115200, timeout=timeout)
+        self.sequence = 0
+        # end any half-typed shell line so the first sync byte starts a line.
+        self.port.write(b"\r")
+        self.port.reset_input_buffer()
+        self.max_payload = struct.unpack("<BH", self.call(INFO))[1]
+
+    def call(self, command, payload=b""):
+        self.sequence = (self.sequence + 1) & 0xFF
+        body = struct.pack("<BBH", command, self.sequence, len(payload)) + payload
+        self.port.write(bytes([SYNC]) + body + struct.pack("<H", binascii.crc_hqx(body, 0xFFFF)))
+        while True:
+            byte = self.port.read(1)
+            if not byte:
+                raise RpcError("timed out")
+            if byte[0] == SYNC:
+                break
+        header = self._read(4)
+        reply, sequence, length = struct.unpack("<BBH", header)
+        payload = self._read(length)
+        (crc,) = struct.unpack("<H", self._read(2))
+        if crc != binascii.crc_hqx(header + payload, 0xFFFF):
+            raise RpcError("bad response crc")
+        if sequence != self.sequence or reply not in (command | RESPONSE, 0xFF):
+            raise RpcError("unexpected response")
+        if payload[0] != 0:
+            raise RpcError(STATUS[payload[0]] if payload[0] < len(STATUS) else "status %d" % payload[0])
+        return payload[1:]
+
+    def _read(self, length):
+        data = self.port.read(length)
+        if len(data) != length:
+            raise RpcError("timed out")
+        return data
+
+    def get(self, path):
+        data = b""
+        chunk = self.max_payload - 1
+        while True:
+            part = self.call(FILE_READ, struct.pack("<IH", len(data), chunk) + path.encode())
+            data += part
+            if len(part) < chunk:
+                return data
+
+    def put(self, path, data):
+        chunk = self.max_payload - 4 - len(path) - 1
+        offset = 0
+        while True:
+            part = data[offset:offset + chunk]
+            self.call(FILE_WRITE, struct.pack("<I", offset) + path.encode() + b"\0" + part)
+            offset += len(part)
+            if offset >= len(data):
+                return
+
+
+def decode_date_time(reg):
+    return datetime.datetime(2020 + (reg >> 26), (reg >> 22) & 0xF, (reg >> 17) & 0x1F,
+                             (reg >> 12) & 0x1F, (reg >> 6) & 0x3F, reg & 0x3F)
+
+
+def encode_date_time(dt):
+    return ((dt.year - 2020) << 26) | (dt.month << 22) | (dt.day << 17) | (dt.hour << 12) | (dt.minute << 6) | dt.second
+
+
+def main(argv):
+    if len(argv) < 3:
+        print(__doc__)
+        return 1
+    watch = Watch(argv[1])
+    command = argv[2]
+    if command == "ping":
+        print(watch.call(PING, b"ping").decode())
+    elif command == "get":
+        with open(argv[4], "wb") as f:
+            f.write(watch.get(argv[3]))
+    elif command == "put":
+        with open(argv[3], "rb") as f:
+            watch.put(argv[4], f.read())
+    elif command == "rm":
+        watch.call(FILE_REMOVE, argv[3].encode())
+    elif command == "time":
+        if len(argv) > 3 and argv[3] == "now":
+            watch.call(RTC_SET, struct.pack("<I", encode_date_time(datetime.datetime.now())))
+        (reg,) = struct.unpack("<I", watch.call(RTC_GET))
+        print(decode_date_time(reg))
+    elif command == "backup":
+        for i, value in enumerate(struct.unpack("<8I", watch.call(BACKUP_DUMP))):
+            print("%d: 0x%08x" % (i, value))
+    elif command == "log":
+        while True:
+            text = watch.call(LOG_READ)
+            if not text:
+                break
+            sys.stdout.write(text.decode(errors="replace"))
+    else:
+        print(__doc__)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Host side of the shell's `stress` benchmark: measures the serial link in both directions.
+
+Usage:
+    swstress.py PORT [BYTES] [BAUD]
+
+Sends `stress tx BYTES` and checks the patterned data the watch streams back, then sends
+`stress rx BYTES` and streams the same pattern to the watch, which checks it. Prints the rate
+seen from each end. BAUD only matters for the UART backend (default 19200, SHELL_UART_BAUD).
+
+Requires pyserial.
+"""
+
+import sys
+import time
+
+import serial
+
+
+def pattern(length):
+    # must match prv_stress_pattern in movement/shell_cmd_list.c.
+    return bytes(33 + (((i * 2654435761) & 0xFFFFFFFF) >> 24) % 94 for i in range(length))
+
+
+def read_until(port, marker):
+    data = port.read_until(marker)
+    if not data.endswith(marker):
+        raise RuntimeError("timed out waiting for %r" % marker)
+    return data
+
+
+def run_tx(port, length):
+    port.write(b"stress tx %d\r" % length)
+    read_until(port, b"start\r\n")
+    start = time.monotonic()
+    data = port.read(length)
+    elapsed = time.monotonic() - start
+    expected = pattern(length)
+    corrupt = sum(1 for a, b in zip(data, expected) if a != b)
+    print("host rx %d/%d bytes in %.3f s, %d bytes/s, %d corrupt" %
+          (len(data), length, elapsed, len(data) / elapsed if elapsed else 0, corrupt))
+    print("watch " + read_until(port, b" us\r\n").decode(errors="replace").strip())
+
+
+def run_rx(port, length):
+    port.write(b"stress rx %d\r" % length)
+    read_until(port, b"ready\r\n")
+    start = time.monotonic()
+    port.write(pattern(length))
+    port.flush()
+    print("host tx %d bytes in %.3f s" % (length, time.monotonic() - start))
+    print("watch " + read_until(port, b" us\r\n").decode(errors="replace").strip())
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        return 1
+    length = int(argv[2]) if len(argv) > 2 else 4096
+    baud = int(argv[3]) if len(argv) > 3 else 19200
+    port = serial.Serial(argv[1], baud, timeout=10)
+    # end any half-typed shell line.
+    port.write(b"\r")
+    time.sleep(0.2)
+    port.reset_input_buffer()
+    run_tx(port, length)
+    run_rx(port, length)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
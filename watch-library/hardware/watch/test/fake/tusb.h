@@ -0,0 +1,51 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Stand-in for TinyUSB's CDC device API and the few CMSIS calls watch_private_cdc.c makes,
+// so the CDC buffering can be exercised on the host. See test_cdc.c.
+
+#ifndef FAKE_TUSB_H_
+#define FAKE_TUSB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+
+typedef enum {
+    TC1_IRQn = 19,
+} IRQn_Type;
+
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_EnableIRQ(IRQn_Type irq);
+uint32_t __get_IPSR(void);
+
+bool tud_cdc_connected(void);
+uint32_t tud_cdc_available(void);
+int32_t tud_cdc_read_char(void);
+uint32_t tud_cdc_write_available(void);
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize);
+uint32_t tud_cdc_write_flush(void);
+
+#endif // FAKE_TUSB_H_
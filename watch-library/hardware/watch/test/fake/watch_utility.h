@@ -0,0 +1 @@
+// Empty stand-in; watch_private_cdc.c needs nothing from the real header.
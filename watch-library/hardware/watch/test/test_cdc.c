@@ -0,0 +1,152 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host test for the USB CDC output path in watch_private_cdc.c. Pushes a few megabytes through
+// _write() into a fake TinyUSB FIFO, checks that every byte arrives in order, and reports how many
+// bytes each cdc_task() call moves. Build and run with `make` in this directory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tusb.h"
+#include "watch_private_cdc.h"
+
+// The host side drains the FIFO one 64-byte packet per tud_task() call; TC0 runs tud_task()
+// about twice for every cdc_task() on TC1.
+#define PACKET_SIZE 64
+#define PACKETS_PER_TASK 2
+#define TOTAL_BYTES (4UL * 1024 * 1024)
+
+static uint8_t fifo[CFG_TUD_CDC_TX_BUFSIZE];
+static uint32_t fifo_len = 0;
+static bool irq_masked = false;
+static bool in_tc1_handler = false;
+
+static uint32_t received = 0;
+static uint32_t mismatches = 0;
+static uint32_t task_calls = 0;
+static uint32_t expected_state = 1;
+
+static uint8_t next_pattern_byte(uint32_t *state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+static void host_drain(void) {
+    uint32_t budget = PACKET_SIZE * PACKETS_PER_TASK;
+    uint32_t n = fifo_len < budget ? fifo_len : budget;
+    for (uint32_t i = 0; i < n; i++) {
+        if (fifo[i] != next_pattern_byte(&expected_state)) mismatches++;
+    }
+    memmove(fifo, fifo + n, fifo_len - n);
+    fifo_len -= n;
+    received += n;
+}
+
+static void run_tc1(void) {
+    host_drain();
+    task_calls++;
+    in_tc1_handler = true;
+    cdc_task();
+    in_tc1_handler = false;
+}
+
+// TC1 fires whenever it is unmasked, as it would if its period had elapsed while it was masked.
+void NVIC_DisableIRQ(IRQn_Type irq) {
+    (void) irq;
+    irq_masked = true;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+    (void) irq;
+    if (irq_masked && !in_tc1_handler) {
+        irq_masked = false;
+        run_tc1();
+    }
+    irq_masked = false;
+}
+
+uint32_t __get_IPSR(void) {
+    // exception number of TC1 while in its handler, 0 (thread mode) otherwise.
+    return in_tc1_handler ? TC1_IRQn + 16 : 0;
+}
+
+bool tud_cdc_connected(void) {
+    return true;
+}
+
+uint32_t tud_cdc_available(void) {
+    return 0;
+}
+
+int32_t tud_cdc_read_char(void) {
+    return -1;
+}
+
+uint32_t tud_cdc_write_available(void) {
+    return sizeof(fifo) - fifo_len;
+}
+
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize) {
+    uint32_t n = bufsize < tud_cdc_write_available() ? bufsize : tud_cdc_write_available();
+    memcpy(fifo + fifo_len, buffer, n);
+    fifo_len += n;
+    return n;
+}
+
+uint32_t tud_cdc_write_flush(void) {
+    return fifo_len;
+}
+
+int main(void) {
+    char chunk[300];
+    uint32_t state = 1;
+    uint32_t sent = 0;
+    clock_t start = clock();
+
+    // uneven write sizes, so spans wrap around the circular buffer at every possible offset.
+    while (sent < TOTAL_BYTES) {
+        int len = 1 + rand() % sizeof(chunk);
+        for (int i = 0; i < len; i++) chunk[i] = next_pattern_byte(&state);
+        if (_write(1, chunk, len) != len) {
+            printf("FAIL: short write\n");
+            return 1;
+        }
+        sent += len;
+    }
+    // let the rest drain.
+    for (int i = 0; i < 1000 && received < sent; i++) run_tc1();
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("sent %lu bytes, received %lu, %lu mismatched\n", (unsigned long)sent, (unsigned long)received, (unsigned long)mismatches);
+    printf("%.1f bytes per cdc_task (%.1f KB/s at 390 Hz), %.2f MB/s on the host\n",
+           (double)received / task_calls, received / (double)task_calls * 390.0 / 1024, sent / seconds / 1024 / 1024);
+    if (received != sent || mismatches) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
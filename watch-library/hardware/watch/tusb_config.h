@@ -79,7 +79,7 @@
 
 // CDC FIFO size of TX and RX
 #define CFG_TUD_CDC_RX_BUFSIZE   (64)
-#define CFG_TUD_CDC_TX_BUFSIZE   (64)
+#define CFG_TUD_CDC_TX_BUFSIZE   (256)
 
 // CDC Endpoint transfer buffer size, more is faster
 #define CFG_TUD_CDC_EP_BUFSIZE   (64)
@@ -23,6 +23,7 @@
  */
 
 #include "watch.h"
+#include "tusb.h"
 
 // receives interrupts from MCLK, OSC32KCTRL, OSCCTRL, PAC, PM, SUPC and TAL, whatever that is.
 void SYSTEM_Handler(void) {
@@ -46,8 +47,22 @@ bool watch_is_usb_enabled(void) {
     return USB->DEVICE.CTRLA.bit.ENABLE;
 }
 
+bool watch_is_usb_serial_connected(void) {
+    return watch_is_usb_enabled() && tud_cdc_connected();
+}
+
 void watch_reset_to_bootloader(void) {
     volatile uint32_t *dbl_tap_ptr = ((volatile uint32_t *)(HSRAM_ADDR + HSRAM_SIZE - 4));
     *dbl_tap_ptr = 0xf01669ef; // from the UF2 bootloaer: uf2.h line 255
     NVIC_SystemReset();
 }
+
+uint32_t watch_get_cycle_count(void) {
+    // SysTick counts down through its full 24-bit period; delay_ms waits on it without reloading it.
+    return 0xFFFFFF - SysTick->VAL;
+}
+
+uint32_t watch_get_cpu_frequency(void) {
+    // the main clock is bumped from 4 to 8 MHz when USB is enabled.
+    return watch_is_usb_enabled() ? 8000000 : 4000000;
+}
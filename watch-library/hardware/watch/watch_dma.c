@@ -0,0 +1,171 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "watch.h"
+#include "watch_dma.h"
+#include "hpl_sleep.h"
+
+// The controller reads each channel's first descriptor from BASEADDR[channel] and saves progress to
+// WRBADDR[channel]; we only use channels 0 through WATCH_DMA_NUM_CHANNELS - 1, so the tables stop there.
+static DmacDescriptor s_descriptors[WATCH_DMA_NUM_CHANNELS] __attribute__((aligned(16)));
+static DmacDescriptor s_writeback[WATCH_DMA_NUM_CHANNELS] __attribute__((aligned(16)));
+
+static const uint8_t s_triggers[WATCH_DMA_NUM_CHANNELS] = {
+    SERCOM3_DMAC_ID_TX,
+    SERCOM3_DMAC_ID_RX,
+    SERCOM1_DMAC_ID_TX,
+    SERCOM1_DMAC_ID_RX,
+};
+
+static watch_dma_cb_t s_callbacks[WATCH_DMA_NUM_CHANNELS];
+static void *s_contexts[WATCH_DMA_NUM_CHANNELS];
+static volatile bool s_busy[WATCH_DMA_NUM_CHANNELS];
+
+static void _watch_dma_init(void) {
+    if (DMAC->CTRL.reg & DMAC_CTRL_DMAENABLE) return;
+
+    MCLK->AHBMASK.reg |= MCLK_AHBMASK_DMAC;
+    DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL.reg & DMAC_CTRL_SWRST);
+
+    DMAC->BASEADDR.reg = (uint32_t)s_descriptors;
+    DMAC->WRBADDR.reg = (uint32_t)s_writeback;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+
+    NVIC_ClearPendingIRQ(DMAC_IRQn);
+    NVIC_EnableIRQ(DMAC_IRQn);
+}
+
+bool watch_dma_start(watch_dma_channel_t channel, const volatile void *src, bool src_increment,
+                     volatile void *dst, bool dst_increment, uint16_t count, watch_dma_cb_t callback, void *context) {
+    if (channel >= WATCH_DMA_NUM_CHANNELS || count == 0) return false;
+    _watch_dma_init();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (s_busy[channel]) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+    s_busy[channel] = true;
+    s_callbacks[channel] = callback;
+    s_contexts[channel] = context;
+
+    // when an address increments, the descriptor holds the address just past the end of the block.
+    DmacDescriptor *descriptor = &s_descriptors[channel];
+    descriptor->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_BLOCKACT_NOACT |
+                             (src_increment ? DMAC_BTCTRL_SRCINC : 0) | (dst_increment ? DMAC_BTCTRL_DSTINC : 0);
+    descriptor->BTCNT.reg = count;
+    descriptor->SRCADDR.reg = (uint32_t)src + (src_increment ? count : 0);
+    descriptor->DSTADDR.reg = (uint32_t)dst + (dst_increment ? count : 0);
+    descriptor->DESCADDR.reg = 0;
+
+    // CHID selects which channel the CH* registers refer to; the interrupt handler changes it too.
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    DMAC->CHCTRLA.reg = 0;
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_TRIGSRC(s_triggers[channel]) | DMAC_CHCTRLB_TRIGACT_BEAT | DMAC_CHCTRLB_LVL(0);
+    DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+    DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+bool watch_dma_busy(watch_dma_channel_t channel) {
+    return channel < WATCH_DMA_NUM_CHANNELS && s_busy[channel];
+}
+
+// does the DMAC interrupt's job for one channel, if its transfer has ended. For waits in an interrupt handler,
+// which the DMAC interrupt can't preempt if it has the same or a lower priority.
+static void _watch_dma_poll(watch_dma_channel_t channel) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t saved_channel = DMAC->CHID.reg;
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    uint8_t flags = DMAC->CHINTFLAG.reg & (DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR);
+    DMAC->CHINTFLAG.reg = flags;
+    DMAC->CHID.reg = saved_channel;
+    // the DMAC interrupt may have got there first, if it could preempt us.
+    bool ended = flags && s_busy[channel];
+    if (ended) s_busy[channel] = false;
+    __set_PRIMASK(primask);
+
+    if (ended && s_callbacks[channel]) s_callbacks[channel](s_contexts[channel], !(flags & DMAC_CHINTFLAG_TERR));
+}
+
+void watch_dma_wait(watch_dma_channel_t channel) {
+    if (channel >= WATCH_DMA_NUM_CHANNELS) return;
+    if (__get_IPSR() != 0) {
+        while (s_busy[channel]) _watch_dma_poll(channel);
+        return;
+    }
+
+    // check and sleep with interrupts masked, so a completion that lands in between still wakes the WFI.
+    // The DMAC interrupt has to run to end the wait, so they're unmasked between checks, but the
+    // caller gets PRIMASK back as it was.
+    uint32_t primask = __get_PRIMASK();
+    while (true) {
+        __disable_irq();
+        if (!s_busy[channel]) break;
+        _set_sleep_mode(2); // IDLE: the CPU stops, but the bus clocks and the DMAC keep running.
+        while (_get_sleep_mode() != 2);
+        __DSB();
+        __WFI();
+        __enable_irq();
+    }
+    __set_PRIMASK(primask);
+}
+
+void watch_dma_abort(watch_dma_channel_t channel) {
+    if (channel >= WATCH_DMA_NUM_CHANNELS || !s_busy[channel]) return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    DMAC->CHCTRLA.reg = 0;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+    DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+    s_busy[channel] = false;
+    __set_PRIMASK(primask);
+}
+
+void DMAC_Handler(void) {
+    uint8_t saved_channel = DMAC->CHID.reg;
+
+    while (DMAC->INTPEND.reg & (DMAC_INTPEND_TCMPL | DMAC_INTPEND_TERR)) {
+        uint8_t channel = DMAC->INTPEND.reg & DMAC_INTPEND_ID_Msk;
+        DMAC->CHID.reg = DMAC_CHID_ID(channel);
+        uint8_t flags = DMAC->CHINTFLAG.reg;
+        DMAC->CHINTFLAG.reg = flags;
+        if (channel >= WATCH_DMA_NUM_CHANNELS) continue;
+
+        // mark the channel idle first, so the callback can start the next transfer.
+        s_busy[channel] = false;
+        if (s_callbacks[channel]) s_callbacks[channel](s_contexts[channel], !(flags & DMAC_CHINTFLAG_TERR));
+        DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    }
+
+    DMAC->CHID.reg = saved_channel;
+}
@@ -26,14 +26,26 @@
 
 struct io_descriptor *I2C_0_io;
 
+// the caller's completion callback for the asynchronous transfer in progress.
+static watch_dma_cb_t s_async_callback;
+static void *s_async_context;
+static volatile bool s_async_failed;
+
 void watch_enable_i2c(void) {
     I2C_0_init();
     i2c_m_sync_get_io_descriptor(&I2C_0, &I2C_0_io);
     i2c_m_sync_enable(&I2C_0);
+    NVIC_ClearPendingIRQ(SERCOM1_IRQn);
+    NVIC_EnableIRQ(SERCOM1_IRQn);
 }
 
 void watch_disable_i2c(void) {
+    SERCOM1->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MASK;
+    NVIC_DisableIRQ(SERCOM1_IRQn);
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM1_TX);
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM1_RX);
     i2c_m_sync_disable(&I2C_0);
+    I2C_0_io = NULL;
 	hri_mclk_clear_APBCMASK_SERCOM1_bit(MCLK);
 }
 
@@ -47,6 +59,76 @@ void watch_i2c_receive(int16_t addr, uint8_t *buf, uint16_t length) {
     io_read(I2C_0_io, buf, length);
 }
 
+static void _watch_i2c_async_done(void *context, bool success) {
+    (void) context;
+    SERCOM1->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MASK;
+    if (!success) s_async_failed = true;
+    if (s_async_callback) s_async_callback(s_async_context, success);
+}
+
+// With ADDR.LENEN set, the SERCOM counts the data bytes itself: it ACKs each byte read (smart mode is
+// on), then NACKs the last one and issues a STOP, so the DMA channel only has to feed or drain DATA.
+// What the DMA channel can't see is the device failing to answer. On a write, a NACK ends the
+// transfer early with a STOP and sets LENERR, which raises ERROR; on a read, a NACK to the address
+// raises MB, which otherwise only fires on writes. SERCOM1_Handler watches for both.
+static bool _watch_i2c_start_dma(int16_t addr, bool read, uint8_t length, watch_dma_cb_t callback, void *context) {
+    if (I2C_0_io == NULL || length == 0) return false;
+    if (watch_dma_busy(WATCH_DMA_CHANNEL_SERCOM1_TX) || watch_dma_busy(WATCH_DMA_CHANNEL_SERCOM1_RX)) return false;
+    if ((SERCOM1->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) != SERCOM_I2CM_STATUS_BUSSTATE(1)) return false;
+
+    s_async_callback = callback;
+    s_async_context = context;
+    s_async_failed = false;
+    SERCOM1->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_LENERR | SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST;
+    SERCOM1->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_MASK;
+    SERCOM1->I2CM.INTENSET.reg = SERCOM_I2CM_INTENSET_ERROR | (read ? SERCOM_I2CM_INTENSET_MB : 0);
+
+    while (SERCOM1->I2CM.SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+    SERCOM1->I2CM.ADDR.reg = SERCOM_I2CM_ADDR_ADDR((addr << 1) | (read ? 1 : 0)) |
+                             SERCOM_I2CM_ADDR_LENEN | SERCOM_I2CM_ADDR_LEN(length);
+    return true;
+}
+
+bool watch_i2c_send_async(int16_t addr, const uint8_t *buf, uint8_t length, watch_dma_cb_t callback, void *context) {
+    if (!_watch_i2c_start_dma(addr, false, length, callback, context)) return false;
+    return watch_dma_start(WATCH_DMA_CHANNEL_SERCOM1_TX, buf, true, &SERCOM1->I2CM.DATA.reg, false, length,
+                           _watch_i2c_async_done, NULL);
+}
+
+bool watch_i2c_receive_async(int16_t addr, uint8_t *buf, uint8_t length, watch_dma_cb_t callback, void *context) {
+    if (!_watch_i2c_start_dma(addr, true, length, callback, context)) return false;
+    return watch_dma_start(WATCH_DMA_CHANNEL_SERCOM1_RX, &SERCOM1->I2CM.DATA.reg, false, buf, true, length,
+                           _watch_i2c_async_done, NULL);
+}
+
+bool watch_i2c_wait(void) {
+    watch_dma_wait(WATCH_DMA_CHANNEL_SERCOM1_TX);
+    watch_dma_wait(WATCH_DMA_CHANNEL_SERCOM1_RX);
+    // the TX channel finishes when the last byte is loaded, not sent; wait for the STOP to go out.
+    if (I2C_0_io == NULL) return false;
+    while ((SERCOM1->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) == SERCOM_I2CM_STATUS_BUSSTATE(2)) {
+        if (SERCOM1->I2CM.INTFLAG.reg & SERCOM_I2CM_INTFLAG_ERROR) break;
+    }
+    return !s_async_failed;
+}
+
+// Only enabled during an asynchronous transfer, for the NACKs and bus errors described above.
+void SERCOM1_Handler(void) {
+    uint8_t flags = SERCOM1->I2CM.INTFLAG.reg & SERCOM1->I2CM.INTENSET.reg;
+    if (!flags) return;
+
+    SERCOM1->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MASK;
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM1_TX);
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM1_RX);
+    // a read the device didn't acknowledge still holds the bus; let it go.
+    if ((SERCOM1->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) == SERCOM_I2CM_STATUS_BUSSTATE(2)) {
+        SERCOM1->I2CM.CTRLB.reg |= SERCOM_I2CM_CTRLB_CMD(3);
+        while (SERCOM1->I2CM.SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+    }
+    SERCOM1->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_MASK;
+    _watch_i2c_async_done(NULL, false);
+}
+
 void watch_i2c_write8(int16_t addr, uint8_t reg, uint8_t data) {
     uint8_t buf[2];
     buf[0] = reg;
@@ -26,6 +26,7 @@
 #include "watch_private_cdc.h"
 
 #include <stddef.h>
+#include <string.h>
 
 #include "watch_utility.h"
 #include "tusb.h"
@@ -45,6 +46,11 @@ static char s_write_buf[CDC_WRITE_BUF_SZ] = {0};
 static size_t s_write_buf_pos = 0;
 static size_t s_write_buf_len = 0;
 
+// How many times _write will let cdc_task run without freeing any space before it
+// gives up waiting and overwrites the oldest data instead (about 250 ms).
+#define CDC_WRITE_MAX_STALLED_TASKS (100)
+static volatile uint32_t s_cdc_task_count = 0;
+
 #define CDC_READ_BUF_SZ  (256)
 #define CDC_READ_BUF_IDX(x)  ((x) & (CDC_READ_BUF_SZ - 1))
 static char s_read_buf[CDC_READ_BUF_SZ] = {0};
@@ -61,6 +67,23 @@ static inline void prv_critical_section_exit(void) {
     NVIC_EnableIRQ(TC1_IRQn);
 }
 
+// Copy into the circular buffer in at most two spans. If there isn't enough
+// space, the oldest data is overwritten. Call with TC1 interrupts masked.
+static void prv_write_buf_push(const char *data, size_t len) {
+    if (len > CDC_WRITE_BUF_SZ) {
+        data += len - CDC_WRITE_BUF_SZ;
+        len = CDC_WRITE_BUF_SZ;
+    }
+    const size_t first = (len < CDC_WRITE_BUF_SZ - s_write_buf_pos) ? len : CDC_WRITE_BUF_SZ - s_write_buf_pos;
+    memcpy(&s_write_buf[s_write_buf_pos], data, first);
+    memcpy(s_write_buf, data + first, len - first);
+    s_write_buf_pos = CDC_WRITE_BUF_IDX(s_write_buf_pos + len);
+    s_write_buf_len += len;
+    if (s_write_buf_len > CDC_WRITE_BUF_SZ) {
+        s_write_buf_len = CDC_WRITE_BUF_SZ;
+    }
+}
+
 int _write(int file, char *ptr, int len) {
     (void) file;
 
@@ -68,20 +91,31 @@ int _write(int file, char *ptr, int len) {
         return -1;
     }
 
-    int bytes_written = 0;
+    size_t bytes_written = 0;
+    uint32_t last_progress = s_cdc_task_count;
 
-    prv_critical_section_enter();
+    while (bytes_written < (size_t) len) {
+        prv_critical_section_enter();
 
-    for (int i = 0; i < len; i++) {
-        s_write_buf[s_write_buf_pos] = ptr[i];
-        s_write_buf_pos = CDC_WRITE_BUF_IDX(s_write_buf_pos + 1);
-        if (s_write_buf_len < CDC_WRITE_BUF_SZ) {
-            s_write_buf_len++;
+        size_t chunk = len - bytes_written;
+        const size_t space = CDC_WRITE_BUF_SZ - s_write_buf_len;
+        if (space > 0) {
+            last_progress = s_cdc_task_count;
         }
-        bytes_written++;
-    }
+        // Wait for cdc_task to make room if a host is reading and we can
+        // be preempted by TC1. Otherwise nobody will drain the buffer, so
+        // keep the newest output and drop the oldest.
+        const bool can_wait = tud_cdc_connected() &&
+                              __get_IPSR() == 0 &&
+                              s_cdc_task_count - last_progress < CDC_WRITE_MAX_STALLED_TASKS;
+        if (can_wait && chunk > space) {
+            chunk = space;
+        }
+        prv_write_buf_push(ptr + bytes_written, chunk);
+        bytes_written += chunk;
 
-    prv_critical_section_exit();
+        prv_critical_section_exit();
+    }
 
     return bytes_written;
 }
@@ -134,27 +168,42 @@ static void prv_handle_reads(void) {
 
 static void prv_handle_writes(void) {
     if (s_write_buf_len > 0) {
-        const size_t start_pos =
-            CDC_WRITE_BUF_IDX(s_write_buf_pos - s_write_buf_len);
-        for (size_t i = 0; i < (size_t) s_write_buf_len; i++) {
-            const size_t idx = CDC_WRITE_BUF_IDX(start_pos + i);
+        // At most two passes: one up to the end of the circular buffer, and
+        // one for the part that wrapped around to the start.
+        while (s_write_buf_len > 0) {
             if (tud_cdc_available() > 0) {
                 // If we receive data while doing a large write, we need to
                 // fully service it before continuing to write, or the
                 // stack will crash.
                 prv_handle_reads();
             }
-            if (tud_cdc_write_available()) {
-                tud_cdc_write(&s_write_buf[idx], 1);
+            const size_t start_pos =
+                CDC_WRITE_BUF_IDX(s_write_buf_pos - s_write_buf_len);
+            size_t span = CDC_WRITE_BUF_SZ - start_pos;
+            if (span > s_write_buf_len) {
+                span = s_write_buf_len;
+            }
+            // Anything that doesn't fit in the TinyUSB FIFO stays in our
+            // buffer until the next call.
+            const size_t available = tud_cdc_write_available();
+            if (span > available) {
+                span = available;
+            }
+            if (span == 0) {
+                break;
+            }
+            const size_t written = tud_cdc_write(&s_write_buf[start_pos], span);
+            s_write_buf_len -= written;
+            if (written < span) {
+                break;
             }
-            s_write_buf[idx] = 0;
-            s_write_buf_len--;
         }
         tud_cdc_write_flush();
     }
 }
 
 void cdc_task(void) {
+    s_cdc_task_count++;
     prv_handle_reads();
     prv_handle_writes();
 }
@@ -185,3 +185,12 @@ void watch_rtc_freqcorr_write(int16_t value, int16_t sign)
     // We do not sycnronize. We are not in a hurry
 }
 
+int16_t watch_rtc_freqcorr_read(void)
+{
+    RTC_FREQCORR_Type data;
+
+    data.reg = RTC->MODE2.FREQCORR.reg;
+
+    return data.bit.SIGN ? -(int16_t)data.bit.VALUE : (int16_t)data.bit.VALUE;
+}
+
@@ -33,19 +33,55 @@ void watch_enable_spi(void) {
 }
 
 void watch_disable_spi(void) {
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM3_TX);
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM3_RX);
     spi_m_sync_disable(&SPI_0);
     spi_io = NULL;
 }
 
+// the DMA channels need somewhere to read filler bytes from and write discarded bytes to.
+static const uint8_t s_spi_dummy_out = 0xFF;
+static uint8_t s_spi_dummy_in;
+
+bool watch_spi_transfer_async(const uint8_t *data_out, uint8_t *data_in, uint16_t length, watch_dma_cb_t callback, void *context) {
+    if (spi_io == NULL || length == 0) return false;
+    if (watch_dma_busy(WATCH_DMA_CHANNEL_SERCOM3_TX) || watch_dma_busy(WATCH_DMA_CHANNEL_SERCOM3_RX)) return false;
+
+    // discard anything left in the receive buffer so the RX channel stays in step with the TX channel.
+    while (SERCOM3->SPI.INTFLAG.reg & SERCOM_SPI_INTFLAG_RXC) (void)SERCOM3->SPI.DATA.reg;
+    SERCOM3->SPI.STATUS.reg = SERCOM_SPI_STATUS_BUFOVF;
+
+    // every byte clocked out clocks one in, so the transfer is over when the RX channel finishes.
+    watch_dma_start(WATCH_DMA_CHANNEL_SERCOM3_RX, &SERCOM3->SPI.DATA.reg, false,
+                    data_in ? data_in : &s_spi_dummy_in, data_in != NULL, length, callback, context);
+    watch_dma_start(WATCH_DMA_CHANNEL_SERCOM3_TX, data_out ? data_out : &s_spi_dummy_out, data_out != NULL,
+                    &SERCOM3->SPI.DATA.reg, false, length, NULL, NULL);
+
+    return true;
+}
+
+void watch_spi_wait(void) {
+    watch_dma_wait(WATCH_DMA_CHANNEL_SERCOM3_RX);
+}
+
+static bool _watch_spi_transfer_dma(const uint8_t *data_out, uint8_t *data_in, uint16_t length) {
+    if (!watch_spi_transfer_async(data_out, data_in, length, NULL, NULL)) return false;
+    watch_spi_wait();
+    return true;
+}
+
 bool watch_spi_write(const uint8_t *buf, uint16_t length) {
+    if (length >= WATCH_SPI_DMA_THRESHOLD) return _watch_spi_transfer_dma(buf, NULL, length);
 	return !!io_write(spi_io, buf, length);
 }
 
 bool watch_spi_read(uint8_t *buf, uint16_t length) {
+    if (length >= WATCH_SPI_DMA_THRESHOLD) return _watch_spi_transfer_dma(NULL, buf, length);
 	return !!io_read(spi_io, buf, length);
 }
 
 bool watch_spi_transfer(const uint8_t *data_out, uint8_t *data_in, uint16_t length) {
+    if (length >= WATCH_SPI_DMA_THRESHOLD) return _watch_spi_transfer_dma(data_out, data_in, length);
     struct spi_xfer xfer;
     xfer.txbuf = (uint8_t *)data_out;
     xfer.rxbuf = data_in;
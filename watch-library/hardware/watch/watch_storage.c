@@ -92,3 +92,12 @@ bool watch_storage_sync(void) {
 
     return true;
 }
+
+const uint8_t *watch_storage_get_pointer(uint32_t row, uint32_t offset) {
+    uint32_t address = RWWEE_ADDR_START + row * NVMCTRL_ROW_SIZE + offset;
+    if (!_is_valid_address(address, 1)) return NULL;
+
+    watch_storage_sync();
+
+    return (const uint8_t *)address;
+}
@@ -28,7 +28,37 @@
 struct usart_sync_descriptor USART_0;
 struct io_descriptor *uart_io;
 
+// Single-producer, single-consumer rings between the main loop and the interrupt handlers. Each index
+// is only ever written by one side, so no locking is needed. Sizes must be powers of two.
+// Received bytes arrive one at a time in SERCOM3_Handler; queued bytes leave by DMA, one contiguous
+// span of the ring at a time.
+#define UART_RX_BUF_IDX(x) ((x) & (WATCH_UART_RX_BUF_SZ - 1))
+#define UART_TX_BUF_IDX(x) ((x) & (WATCH_UART_TX_BUF_SZ - 1))
+static uint8_t s_rx_buf[WATCH_UART_RX_BUF_SZ];
+static volatile uint16_t s_rx_head = 0; // written by the ISR
+static volatile uint16_t s_rx_tail = 0; // written by the main loop
+static uint8_t s_tx_buf[WATCH_UART_TX_BUF_SZ];
+static volatile uint16_t s_tx_head = 0; // written by the main loop
+static volatile uint16_t s_tx_tail = 0; // written by the DMA completion callback
+static uint16_t s_tx_dma_len = 0;
+static bool s_tx_sent = false;      // a DMA transfer was started since the last flush waited for TXC
+static uint32_t s_txc_spins = 0;    // polls of TXC that outlast two characters at the current baud rate
+static watch_uart_rx_cb_t s_rx_callback = NULL;
+static volatile uint32_t s_rx_dropped = 0;
+
+static uint8_t s_tx_pin = 0;
+static uint8_t s_rx_pin = 0;
+
 void watch_enable_uart(const uint8_t tx_pin, const uint8_t rx_pin, uint32_t baud) {
+    s_tx_pin = tx_pin;
+    s_rx_pin = rx_pin;
+    s_rx_head = s_rx_tail = 0;
+    s_tx_head = s_tx_tail = 0;
+    s_tx_dma_len = 0;
+    s_tx_sent = false;
+    s_rx_callback = NULL;
+    s_rx_dropped = 0;
+
     SERCOM_USART_CTRLA_Type ctrla;
     SERCOM_USART_CTRLB_Type ctrlb;
     ctrla.reg = SERCOM_USART_CTRLA_DORD | SERCOM_USART_CTRLA_MODE(1);
@@ -96,23 +126,165 @@ void watch_enable_uart(const uint8_t tx_pin, const uint8_t rx_pin, uint32_t baud
     if (hri_usbdevice_get_CTRLA_ENABLE_bit(USB)) {
         uint64_t br = 65536 - ((65536 * 16.0f * baud) / 8000000);
         SERCOM3->USART.BAUD.reg = (uint16_t)br;
+        s_txc_spins = 20 * 8000000 / baud + 64;
     } else {
         uint64_t br = 65536 - ((65536 * 16.0f * baud) / 4000000);
         SERCOM3->USART.BAUD.reg = (uint16_t)br;
+        s_txc_spins = 20 * 4000000 / baud + 64;
     }
 
     SERCOM3->USART.CTRLA.reg |= SERCOM_USART_CTRLA_ENABLE;
 
 	usart_sync_enable(&USART_0);
     usart_sync_get_io_descriptor(&USART_0, &uart_io);
+
+    // receive in the background; transmission is driven by the DMA channel.
+    if (rx_pin) SERCOM3->USART.INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+    NVIC_ClearPendingIRQ(SERCOM3_IRQn);
+    NVIC_EnableIRQ(SERCOM3_IRQn);
+}
+
+void watch_disable_uart(void) {
+    if (!(SERCOM3->USART.CTRLA.reg & SERCOM_USART_CTRLA_ENABLE)) return;
+
+    watch_uart_flush();
+
+    NVIC_DisableIRQ(SERCOM3_IRQn);
+    watch_dma_abort(WATCH_DMA_CHANNEL_SERCOM3_TX);
+    SERCOM3->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_MASK;
+
+    SERCOM3->USART.CTRLA.reg &= ~SERCOM_USART_CTRLA_ENABLE;
+    while (SERCOM3->USART.SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_ENABLE);
+    MCLK->APBCMASK.reg &= ~MCLK_APBCMASK_SERCOM3;
+
+    // return the pins to high-impedance inputs so they don't leak current.
+    if (s_tx_pin) gpio_set_pin_function(s_tx_pin, GPIO_PIN_FUNCTION_OFF);
+    if (s_rx_pin) gpio_set_pin_function(s_rx_pin, GPIO_PIN_FUNCTION_OFF);
+    s_tx_pin = s_rx_pin = 0;
+}
+
+void SERCOM3_Handler(void) {
+    uint8_t flags = SERCOM3->USART.INTFLAG.reg & SERCOM3->USART.INTENSET.reg;
+
+    if (flags & SERCOM_USART_INTFLAG_RXC) {
+        // the SERCOM holds two bytes; if a third arrived before we got here, it was lost.
+        if (SERCOM3->USART.STATUS.reg & SERCOM_USART_STATUS_BUFOVF) {
+            SERCOM3->USART.STATUS.reg = SERCOM_USART_STATUS_BUFOVF;
+            s_rx_dropped++;
+        }
+        uint8_t byte = SERCOM3->USART.DATA.reg;
+        if (s_rx_callback) {
+            s_rx_callback(byte);
+            return;
+        }
+        uint16_t next = UART_RX_BUF_IDX(s_rx_head + 1);
+        // if the ring is full, the byte is dropped.
+        if (next != s_rx_tail) {
+            s_rx_buf[s_rx_head] = byte;
+            s_rx_head = next;
+        } else {
+            s_rx_dropped++;
+        }
+    }
+}
+
+void watch_uart_set_rx_callback(watch_uart_rx_cb_t callback) {
+    s_rx_callback = callback;
+}
+
+uint32_t watch_uart_rx_dropped(void) {
+    return s_rx_dropped;
+}
+
+static void _watch_uart_tx_done(void *context, bool success);
+
+// starts sending the oldest contiguous span of the TX ring, unless a span is already on its way.
+static void _watch_uart_tx_kick(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!s_tx_dma_len && s_tx_tail != s_tx_head) {
+        uint16_t tail = s_tx_tail;
+        uint16_t head = s_tx_head;
+        uint16_t length = (head > tail ? head : WATCH_UART_TX_BUF_SZ) - tail;
+        // TXC is cleared here, so a flush never sees one left over from an earlier transfer.
+        SERCOM3->USART.INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+        // if the channel couldn't be started, the span stays queued for the next write or flush to retry.
+        if (watch_dma_start(WATCH_DMA_CHANNEL_SERCOM3_TX, &s_tx_buf[tail], true, &SERCOM3->USART.DATA.reg, false,
+                            length, _watch_uart_tx_done, NULL)) {
+            s_tx_dma_len = length;
+            s_tx_sent = true;
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+static void _watch_uart_tx_done(void *context, bool success) {
+    s_tx_tail = UART_TX_BUF_IDX(s_tx_tail + s_tx_dma_len);
+    s_tx_dma_len = 0;
+    _watch_uart_tx_kick();
+}
+
+size_t watch_uart_write(const uint8_t *data, size_t length) {
+    size_t queued = 0;
+    uint16_t head = s_tx_head;
+    while (queued < length) {
+        uint16_t next = UART_TX_BUF_IDX(head + 1);
+        if (next == s_tx_tail) break;
+        s_tx_buf[head] = data[queued++];
+        head = next;
+    }
+    // publish the whole batch at once, then hand it to the DMA channel.
+    s_tx_head = head;
+    if (queued && s_tx_pin) _watch_uart_tx_kick();
+    return queued;
+}
+
+size_t watch_uart_tx_free(void) {
+    // one slot stays empty, so a full ring can be told from an empty one.
+    return UART_TX_BUF_IDX(s_tx_tail - s_tx_head - 1);
+}
+
+size_t watch_uart_read(uint8_t *data, size_t length) {
+    size_t count = 0;
+    uint16_t tail = s_rx_tail;
+    while (count < length && tail != s_rx_head) {
+        data[count++] = s_rx_buf[tail];
+        tail = UART_RX_BUF_IDX(tail + 1);
+    }
+    s_rx_tail = tail;
+    return count;
+}
+
+size_t watch_uart_rx_available(void) {
+    return UART_RX_BUF_IDX(s_rx_head - s_rx_tail);
+}
+
+void watch_uart_flush(void) {
+    if (!(SERCOM3->USART.CTRLA.reg & SERCOM_USART_CTRLA_ENABLE)) return;
+    while (s_tx_pin && s_tx_tail != s_tx_head) {
+        _watch_uart_tx_kick();
+        watch_dma_wait(WATCH_DMA_CHANNEL_SERCOM3_TX);
+    }
+    // the last byte has been handed to the shift register; wait for it to leave, if anything was sent at all.
+    // the wait is bounded (each poll takes at least a cycle), in case TXC never comes.
+    if (s_tx_pin && s_tx_sent) {
+        uint32_t spins = s_txc_spins;
+        while (!(SERCOM3->USART.INTFLAG.reg & SERCOM_USART_INTFLAG_TXC) && --spins);
+        s_tx_sent = false;
+    }
 }
 
 void watch_uart_puts(char *s) {
-	io_write(uart_io, (uint8_t *)s, strlen(s));
+    size_t length = strlen(s);
+    while (length) {
+        size_t queued = watch_uart_write((uint8_t *)s, length);
+        s += queued;
+        length -= queued;
+    }
 }
 
 char watch_uart_getc(void) {
     uint8_t retval;
-    io_read(uart_io, &retval, 1);
+    while (!watch_uart_read(&retval, 1));
     return retval;
 }
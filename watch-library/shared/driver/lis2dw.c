@@ -195,6 +195,17 @@ bool lis2dw_read_fifo(lis2dw_fifo_t *fifo_data) {
     bool overrun = !!(temp & LIS2DW_FIFO_SAMPLE_OVERRUN);
 
     fifo_data->count = temp & LIS2DW_FIFO_SAMPLE_COUNT;
+    if (fifo_data->count == 0) return overrun;
+
+    // In FIFO mode the sensor rolls the register address back from OUT_Z_H to OUT_X_L, so the whole
+    // FIFO comes out in one burst, which the DMA channel takes while the CPU sleeps. The readings are
+    // little-endian int16s, just as the struct holds them.
+    uint8_t reg = LIS2DW_REG_OUT_X_L | 0x80;
+    watch_i2c_send(LIS2DW_ADDRESS, &reg, 1);
+    if (watch_i2c_receive_async(LIS2DW_ADDRESS, (uint8_t *)fifo_data->readings,
+                                fifo_data->count * sizeof(lis2dw_reading_t), NULL, NULL) && watch_i2c_wait()) {
+        return overrun;
+    }
 
     for(int i = 0; i < fifo_data->count; i++) {
         fifo_data->readings[i] = lis2dw_get_raw_reading();
@@ -39,6 +39,7 @@ static void flash_disable(void) {
 }
 
 static bool transfer(uint8_t *command, uint32_t command_length, uint8_t *data_in, uint8_t *data_out, uint32_t data_length) {
+    flash_enable();
     bool status = watch_spi_write(command, command_length);
     if (status) {
         if (data_in != NULL && data_out != NULL) {
@@ -113,6 +114,36 @@ bool spi_flash_read_data(uint32_t address, uint8_t *data, uint32_t data_length)
     return status;
 }
 
+bool spi_flash_wait_until_ready(void) {
+    uint8_t status = 0;
+    do {
+        if (!spi_flash_read_command(CMD_READ_STATUS, &status, 1)) return false;
+    } while (status & SPI_FLASH_STATUS_BUSY);
+    return true;
+}
+
+bool spi_flash_erase_sector(uint32_t address) {
+    if (!spi_flash_wait_until_ready()) return false;
+    if (!spi_flash_command(CMD_ENABLE_WRITE)) return false;
+    if (!spi_flash_sector_command(CMD_SECTOR_ERASE, address)) return false;
+    return spi_flash_wait_until_ready();
+}
+
+bool spi_flash_program(uint32_t address, uint8_t *data, uint32_t data_length) {
+    while (data_length) {
+        // a page program wraps around at the end of the page, so split writes that cross a boundary.
+        uint32_t chunk = SPI_FLASH_PAGE_SIZE - (address % SPI_FLASH_PAGE_SIZE);
+        if (chunk > data_length) chunk = data_length;
+        if (!spi_flash_wait_until_ready()) return false;
+        if (!spi_flash_command(CMD_ENABLE_WRITE)) return false;
+        if (!spi_flash_write_data(address, data, chunk)) return false;
+        address += chunk;
+        data += chunk;
+        data_length -= chunk;
+    }
+    return spi_flash_wait_until_ready();
+}
+
 void spi_flash_init(void) {
 	gpio_set_pin_level(A3, true);
 	gpio_set_pin_direction(A3, GPIO_DIRECTION_OUT);
@@ -49,10 +49,21 @@
 #define CMD_RESET 0x99
 #define CMD_WAKE 0xab
 
+#define SPI_FLASH_STATUS_BUSY 0x01
+#define SPI_FLASH_STATUS_WEL 0x02
+#define SPI_FLASH_PAGE_SIZE 256
+#define SPI_FLASH_SECTOR_SIZE 4096
+
 bool spi_flash_command(uint8_t command);
 bool spi_flash_read_command(uint8_t command, uint8_t *response, uint32_t length);
 bool spi_flash_write_command(uint8_t command, uint8_t *data, uint32_t length);
 bool spi_flash_sector_command(uint8_t command, uint32_t address);
 bool spi_flash_write_data(uint32_t address, uint8_t *data, uint32_t data_length);
 bool spi_flash_read_data(uint32_t address, uint8_t *data, uint32_t data_length);
+// Polls the status register until the current program or erase operation has finished.
+bool spi_flash_wait_until_ready(void);
+// Erases the 4 KB sector containing address, waiting for the erase to complete.
+bool spi_flash_erase_sector(uint32_t address);
+// Programs data_length bytes at address, splitting at page boundaries and waiting for each page to complete.
+bool spi_flash_program(uint32_t address, uint8_t *data, uint32_t data_length);
 void spi_flash_init(void);
@@ -68,6 +68,7 @@
 #include "watch_buzzer.h"
 #include "watch_adc.h"
 #include "watch_gpio.h"
+#include "watch_dma.h"
 #include "watch_i2c.h"
 #include "watch_spi.h"
 #include "watch_uart.h"
@@ -87,10 +88,25 @@ bool watch_is_buzzer_or_led_enabled(void);
   */
 bool watch_is_usb_enabled(void);
 
+/** @brief Returns true if a host has the USB serial port open, i.e. a terminal program has asserted DTR.
+  */
+bool watch_is_usb_serial_connected(void);
+
 /** @brief Resets in the UF2 bootloader mode
   */
 void watch_reset_to_bootloader(void);
 
+/** @brief Returns a free-running count of CPU cycles, for profiling short operations.
+  * @details The count is 24 bits wide; to measure an interval, subtract two readings and mask the result
+  *          with 0xFFFFFF. It keeps counting through delay_ms, but wraps every two to four seconds and
+  *          stops in standby, so only use it to time operations shorter than that which stay awake.
+  */
+uint32_t watch_get_cycle_count(void);
+
+/** @brief Returns the rate at which watch_get_cycle_count advances, in Hz.
+  */
+uint32_t watch_get_cpu_frequency(void);
+
 /** @brief Call periodically from app main loop to service CDC RX/TX.
   */
 void cdc_task(void);
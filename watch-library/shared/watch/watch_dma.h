@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WATCH_DMA_H_INCLUDED
+#define _WATCH_DMA_H_INCLUDED
+////< @file watch_dma.h
+
+// only the basic types: watch.h includes this ahead of the bus drivers that use watch_dma_cb_t.
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @addtogroup dma DMA Controller
+  * @brief This section covers functions related to the SAM L22's DMA controller, which moves data
+  *        between memory and the SERCOM peripherals while the CPU sleeps.
+  * @details Each SERCOM direction has its own channel, triggered by the peripheral's data register
+  *          empty (TX) or receive complete (RX) request. The SPI, I2C and UART drivers use these
+  *          channels for you; you only need this API to move data on a bus in some other way.
+  *          Completion callbacks run in the DMAC interrupt handler, so keep them short.
+  */
+/// @{
+
+/// Channels, one per SERCOM direction. SERCOM3 carries the SPI bus or the UART; SERCOM1 is the I2C bus.
+typedef enum {
+    WATCH_DMA_CHANNEL_SERCOM3_TX = 0,
+    WATCH_DMA_CHANNEL_SERCOM3_RX,
+    WATCH_DMA_CHANNEL_SERCOM1_TX,
+    WATCH_DMA_CHANNEL_SERCOM1_RX,
+    WATCH_DMA_NUM_CHANNELS
+} watch_dma_channel_t;
+
+/** @brief Called from the DMAC interrupt when a transfer ends.
+  * @param context The context pointer passed to watch_dma_start.
+  * @param success false if the controller reported a bus error.
+  */
+typedef void (*watch_dma_cb_t)(void *context, bool success);
+
+/** @brief Starts a byte-wide transfer on a channel.
+  * @param channel The channel to use; its peripheral trigger paces the transfer.
+  * @param src The address to read from.
+  * @param src_increment true to advance through src, false to read the same address (i.e. a peripheral register).
+  * @param dst The address to write to.
+  * @param dst_increment true to advance through dst, false to write the same address.
+  * @param count The number of bytes to move, from 1 to 65535.
+  * @param callback Called when the transfer completes, or NULL.
+  * @param context Passed to the callback.
+  * @return false if the channel is still busy with an earlier transfer.
+  */
+bool watch_dma_start(watch_dma_channel_t channel, const volatile void *src, bool src_increment,
+                     volatile void *dst, bool dst_increment, uint16_t count, watch_dma_cb_t callback, void *context);
+
+/** @brief Returns true while a transfer on the channel has not completed.
+  */
+bool watch_dma_busy(watch_dma_channel_t channel);
+
+/** @brief Sleeps in IDLE mode until the transfer on a channel completes.
+  * @details Other interrupts still wake the CPU and run as usual, even if the caller had masked them;
+  *          the mask is restored before returning. When called from an interrupt handler, this spins
+  *          instead of sleeping, polling the channel itself (and running its callback) since the DMAC
+  *          interrupt may not be able to preempt the caller.
+  */
+void watch_dma_wait(watch_dma_channel_t channel);
+
+/** @brief Stops a transfer on a channel. The callback is not called.
+  */
+void watch_dma_abort(watch_dma_channel_t channel);
+
+/// @}
+#endif
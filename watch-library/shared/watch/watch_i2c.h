@@ -55,6 +55,34 @@ void watch_i2c_send(int16_t addr, uint8_t *buf, uint16_t length);
   */
 void watch_i2c_receive(int16_t addr, uint8_t *buf, uint16_t length);
 
+/** @brief Starts sending a series of values to a device on the I2C bus by DMA, and returns immediately.
+  * @param addr The address of the device you wish to talk to.
+  * @param buf The bytes to send; must stay valid until the transfer ends.
+  * @param length The number of bytes to send, from 1 to 255.
+  * @param callback Called from the DMAC interrupt once the last byte has been handed to the bus, or NULL.
+  * @param context Passed to the callback.
+  * @return false if the bus is disabled or busy.
+  * @note The controller issues the STOP condition on its own. If the device doesn't acknowledge,
+  *       the transfer ends early and the callback is passed false.
+  */
+bool watch_i2c_send_async(int16_t addr, const uint8_t *buf, uint8_t length, watch_dma_cb_t callback, void *context);
+
+/** @brief Starts receiving a series of values from a device on the I2C bus by DMA, and returns immediately.
+  * @param addr The address of the device you wish to hear from.
+  * @param buf Storage for the incoming bytes; must stay valid until the transfer ends.
+  * @param length The number of bytes to receive, from 1 to 255.
+  * @param callback Called from the DMAC interrupt when the last byte has been received, or NULL. If the
+  *        device doesn't acknowledge its address, it is instead passed false from the SERCOM interrupt.
+  * @param context Passed to the callback.
+  * @return false if the bus is disabled or busy.
+  */
+bool watch_i2c_receive_async(int16_t addr, uint8_t *buf, uint8_t length, watch_dma_cb_t callback, void *context);
+
+/** @brief Sleeps until the current asynchronous I2C transfer, if any, has finished and the bus is idle again.
+  * @return false if the last asynchronous transfer failed, e.g. because the device didn't acknowledge.
+  */
+bool watch_i2c_wait(void);
+
 /** @brief Writes a byte to a register in an I2C device.
   * @param addr The address of the device you wish to address.
   * @param reg The register on the device that you wish to set.
@@ -157,5 +157,10 @@ void watch_rtc_enable(bool en);
   */
 void watch_rtc_freqcorr_write(int16_t value, int16_t sign);
 
+/** @brief Reads back the frequency correction.
+  * @return The correction as a signed value: VALUE, negated if SIGN is set.
+  */
+int16_t watch_rtc_freqcorr_read(void);
+
 /// @}
 #endif
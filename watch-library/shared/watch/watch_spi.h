@@ -33,6 +33,11 @@
   *        configuring the SPI bus and writing to / reading from devices.
   */
 /// @{
+
+#ifndef WATCH_SPI_DMA_THRESHOLD
+#define WATCH_SPI_DMA_THRESHOLD 16 ///< Blocking transfers of at least this many bytes use DMA and sleep until done.
+#endif
+
 /** @brief Enables the SPI peripheral. Call this before attempting to interface with SPI devices.
   */
 void watch_enable_spi(void);
@@ -45,6 +50,7 @@ void watch_disable_spi(void);
   * @param buf A series of unsigned bytes; the data you wish to transmit.
   * @param length The number of bytes in buf that you wish to send.
   * @note This function does not manage the chip select pin (usually A3).
+  * @note Writes of WATCH_SPI_DMA_THRESHOLD bytes or more go through DMA, and the CPU sleeps until they finish.
   */
 bool watch_spi_write(const uint8_t *buf, uint16_t length);
 
@@ -52,6 +58,7 @@ bool watch_spi_write(const uint8_t *buf, uint16_t length);
   * @param buf Storage for the incoming bytes; on return, it will contain the received data.
   * @param length The number of bytes that you wish to receive.
   * @note This function does not manage the chip select pin (usually A3).
+  * @note Reads of WATCH_SPI_DMA_THRESHOLD bytes or more go through DMA, and the CPU sleeps until they finish.
   */
 bool watch_spi_read(uint8_t *buf, uint16_t length);
 
@@ -60,8 +67,25 @@ bool watch_spi_read(uint8_t *buf, uint16_t length);
   * @param data_in Storage for incoming bytes.
   * @param length The number of bytes to transfer.
   * @note This function does not manage the chip select pin (usually A3).
+  * @note Transfers of WATCH_SPI_DMA_THRESHOLD bytes or more go through DMA, and the CPU sleeps until they finish.
   */
 bool watch_spi_transfer(const uint8_t *data_out, uint8_t *data_in, uint16_t length);
 
+/** @brief Starts a DMA transfer on the SPI bus and returns immediately.
+  * @param data_out The bytes to send, or NULL to send 0xFF.
+  * @param data_in Storage for the received bytes, or NULL to discard them.
+  * @param length The number of bytes to transfer.
+  * @param callback Called from the DMAC interrupt when the last byte has been received, or NULL.
+  * @param context Passed to the callback.
+  * @return false if the bus is disabled or an earlier transfer is still running.
+  * @note Both buffers must stay valid until the transfer ends. Call watch_spi_wait before
+  *       releasing the chip select pin.
+  */
+bool watch_spi_transfer_async(const uint8_t *data_out, uint8_t *data_in, uint16_t length, watch_dma_cb_t callback, void *context);
+
+/** @brief Sleeps until the current SPI transfer, if any, has finished.
+  */
+void watch_spi_wait(void);
+
 /// @}
 #endif
@@ -88,5 +88,14 @@ bool watch_storage_erase(uint32_t row);
 /** @brief Waits for any pending writes to complete.
   */
 bool watch_storage_sync(void);
+
+/** @brief Gets a pointer to data in the storage area, which is memory mapped and can be read in place.
+  * @details Waits for any pending write or erase to finish first. The pointer is only valid until
+  *          the row it points into is written or erased again.
+  * @param row The row you want to read.
+  * @param offset The offset from the beginning of the row; may run past the end of the row.
+  * @return A pointer to the data, or NULL if the address is outside the storage area.
+  */
+const uint8_t *watch_storage_get_pointer(uint32_t row, uint32_t offset);
 /// @}
 #endif
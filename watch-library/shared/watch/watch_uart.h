@@ -29,9 +29,19 @@
 
 /** @addtogroup uart UART
   * @brief This section covers functions related to the UART peripheral.
+  * @details Reception and transmission happen in the background: received bytes are collected in a
+  *          ring buffer by the SERCOM interrupt until you read them, and bytes you write are queued in a
+  *          ring buffer that the DMA controller drains to the UART.
   **/
 /// @{
 
+#ifndef WATCH_UART_RX_BUF_SZ
+#define WATCH_UART_RX_BUF_SZ 128 ///< Size of the receive ring buffer; must be a power of two.
+#endif
+#ifndef WATCH_UART_TX_BUF_SZ
+#define WATCH_UART_TX_BUF_SZ 128 ///< Size of the transmit ring buffer; must be a power of two.
+#endif
+
 /** @brief Initializes the debug UART.
   * @param tx_pin The pin the watch will use to transmit, or 0 for a receive-only UART.
   *               If specified, must be either A2 or A4.
@@ -41,8 +51,56 @@
   */
 void watch_enable_uart(const uint8_t tx_pin, const uint8_t rx_pin, uint32_t baud);
 
+/** @brief Waits for pending output to be sent, then turns off the UART and releases its pins.
+  */
+void watch_disable_uart(void);
+
+/** @brief Queues bytes for transmission without blocking.
+  * @param data The bytes you wish to transmit.
+  * @param length The number of bytes to transmit.
+  * @return The number of bytes queued, which is less than length if the transmit buffer filled up.
+  */
+size_t watch_uart_write(const uint8_t *data, size_t length);
+
+/** @brief Gets the number of bytes watch_uart_write can queue right now.
+  */
+size_t watch_uart_tx_free(void);
+
+/** @brief Reads received bytes without blocking.
+  * @param data A buffer of at least length bytes.
+  * @param length The maximum number of bytes to read.
+  * @return The number of bytes read, or 0 if nothing has been received.
+  * @note Bytes that arrive while the receive buffer is full are dropped.
+  */
+size_t watch_uart_read(uint8_t *data, size_t length);
+
+/** @brief Gets the number of received bytes waiting to be read.
+  */
+size_t watch_uart_rx_available(void);
+
+/** @brief A function that takes each received byte as it arrives. It runs in the UART interrupt, so keep it short.
+  */
+typedef void (*watch_uart_rx_cb_t)(uint8_t byte);
+
+/** @brief Hands received bytes to a callback instead of the receive buffer, so a protocol can be parsed as it
+  *        arrives rather than when the main loop gets around to it.
+  * @param callback The function to call with each byte, or NULL to go back to buffering them for
+  *                 watch_uart_read. watch_enable_uart resets this to NULL.
+  */
+void watch_uart_set_rx_callback(watch_uart_rx_cb_t callback);
+
+/** @brief Gets the number of received bytes lost since the UART was enabled, either because the receive buffer
+  *        was full or because the interrupt was held off for longer than two bytes take to arrive.
+  */
+uint32_t watch_uart_rx_dropped(void);
+
+/** @brief Blocks until all queued bytes have been transmitted. The CPU sleeps while it waits.
+  */
+void watch_uart_flush(void);
+
 /** @brief Transmits a string of bytes on the UART's TX pin.
   * @param s A null-terminated string containing the bytes you wish to transmit.
+  * @note This method only blocks while the transmit buffer is full.
   */
 void watch_uart_puts(char *s);
 
@@ -323,3 +323,13 @@ uint8_t days_in_month(uint8_t month, uint16_t year) {
         days += 1;
     return days;
 }
+
+uint16_t watch_utility_crc16(const uint8_t *data, size_t length, uint16_t crc) {
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
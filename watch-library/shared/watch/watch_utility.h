@@ -170,4 +170,12 @@ uint32_t watch_utility_offset_timestamp(uint32_t now, int8_t hours, int8_t minut
  */
 uint8_t days_in_month(uint8_t month, uint16_t year);
 
+/** @brief Computes a CRC-16/CCITT-FALSE (polynomial 0x1021, no reflection) over a buffer.
+ * @param data The bytes to checksum.
+ * @param length The number of bytes in data.
+ * @param crc 0xFFFF to start a new checksum, or the result of a previous call to continue one.
+ * @note Matches Python's binascii.crc_hqx(data, 0xFFFF).
+ */
+uint16_t watch_utility_crc16(const uint8_t *data, size_t length, uint16_t crc);
+
 #endif
@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Navaneeth Bhardwaj
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// RAM-backed stand-in for the SPI NOR flash driver, used by the simulator and host tests.
+// It mimics the chip rather than the bus: programming can only clear bits, erases work on 4 KB
+// sectors, and both require the write enable latch to be set first, like the real part.
+
+#include <string.h>
+#include "spiflash.h"
+
+#ifndef SPI_FLASH_EMULATED_SIZE
+#define SPI_FLASH_EMULATED_SIZE (2 * 1024 * 1024)
+#endif
+
+static uint8_t flash[SPI_FLASH_EMULATED_SIZE];
+static bool initialized = false;
+static bool write_enabled = false;
+
+bool spi_flash_command(uint8_t command) {
+    switch (command) {
+        case CMD_ENABLE_WRITE:
+            write_enabled = true;
+            break;
+        case CMD_DISABLE_WRITE:
+            write_enabled = false;
+            break;
+        case CMD_CHIP_ERASE:
+            if (!write_enabled) return true;
+            memset(flash, 0xFF, sizeof(flash));
+            write_enabled = false;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool spi_flash_read_command(uint8_t command, uint8_t *data, uint32_t data_length) {
+    memset(data, 0, data_length);
+    switch (command) {
+        case CMD_READ_STATUS:
+            // operations complete instantly, so the busy bit is never set.
+            if (data_length) data[0] = write_enabled ? SPI_FLASH_STATUS_WEL : 0;
+            break;
+        case CMD_READ_JEDEC_ID:
+            if (data_length >= 3) {
+                // GigaDevice 16 Mbit part
+                data[0] = 0xC8;
+                data[1] = 0x40;
+                data[2] = 0x15;
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool spi_flash_write_command(uint8_t command, uint8_t *data, uint32_t data_length) {
+    (void) command;
+    (void) data;
+    (void) data_length;
+    return true;
+}
+
+bool spi_flash_sector_command(uint8_t command, uint32_t address) {
+    if (command == CMD_SECTOR_ERASE && write_enabled) {
+        address = (address % sizeof(flash)) & ~(SPI_FLASH_SECTOR_SIZE - 1);
+        memset(flash + address, 0xFF, SPI_FLASH_SECTOR_SIZE);
+    }
+    write_enabled = false;
+    return true;
+}
+
+bool spi_flash_write_data(uint32_t address, uint8_t *data, uint32_t data_length) {
+    if (!write_enabled) return true;
+    address %= sizeof(flash);
+    uint32_t page = address & ~(SPI_FLASH_PAGE_SIZE - 1);
+    uint32_t offset = address - page;
+    for (uint32_t i = 0; i < data_length; i++) {
+        // like the real part, a page program wraps around within the page.
+        flash[page + offset] &= data[i];
+        offset = (offset + 1) % SPI_FLASH_PAGE_SIZE;
+    }
+    write_enabled = false;
+    return true;
+}
+
+bool spi_flash_read_data(uint32_t address, uint8_t *data, uint32_t data_length) {
+    for (uint32_t i = 0; i < data_length; i++) {
+        data[i] = flash[(address + i) % sizeof(flash)];
+    }
+    return true;
+}
+
+bool spi_flash_wait_until_ready(void) {
+    return true;
+}
+
+bool spi_flash_erase_sector(uint32_t address) {
+    spi_flash_command(CMD_ENABLE_WRITE);
+    return spi_flash_sector_command(CMD_SECTOR_ERASE, address);
+}
+
+bool spi_flash_program(uint32_t address, uint8_t *data, uint32_t data_length) {
+    while (data_length) {
+        uint32_t chunk = SPI_FLASH_PAGE_SIZE - (address % SPI_FLASH_PAGE_SIZE);
+        if (chunk > data_length) chunk = data_length;
+        spi_flash_command(CMD_ENABLE_WRITE);
+        spi_flash_write_data(address, data, chunk);
+        address += chunk;
+        data += chunk;
+        data_length -= chunk;
+    }
+    return true;
+}
+
+void spi_flash_init(void) {
+    // a new chip comes erased.
+    if (!initialized) {
+        memset(flash, 0xFF, sizeof(flash));
+        initialized = true;
+    }
+}
@@ -1,3 +1,4 @@
+#include <emscripten.h>
 #include "watch.h"
 
 bool watch_is_buzzer_or_led_enabled(void) {
@@ -8,6 +9,19 @@ bool watch_is_usb_enabled(void) {
     return true;
 }
 
+bool watch_is_usb_serial_connected(void) {
+    return true;
+}
+
 void watch_reset_to_bootloader(void) {
     // No bootloader in the simulator; nothing to do here
 }
+
+uint32_t watch_get_cycle_count(void) {
+    // count microseconds; the 24-bit mask matches the hardware SysTick counter.
+    return ((uint32_t)(emscripten_get_now() * 1000)) & 0xFFFFFF;
+}
+
+uint32_t watch_get_cpu_frequency(void) {
+    return 1000000;
+}
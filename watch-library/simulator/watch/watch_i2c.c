@@ -32,6 +32,12 @@ void watch_i2c_send(int16_t addr, uint8_t *buf, uint16_t length) {}
 
 void watch_i2c_receive(int16_t addr, uint8_t *buf, uint16_t length) {}
 
+bool watch_i2c_send_async(int16_t addr, const uint8_t *buf, uint8_t length, watch_dma_cb_t callback, void *context) { return false; }
+
+bool watch_i2c_receive_async(int16_t addr, uint8_t *buf, uint8_t length, watch_dma_cb_t callback, void *context) { return false; }
+
+bool watch_i2c_wait(void) { return true; }
+
 void watch_i2c_write8(int16_t addr, uint8_t reg, uint8_t data) {}
 
 uint8_t watch_i2c_read8(int16_t addr, uint8_t reg) {
@@ -34,6 +34,7 @@ static long tick_callbacks[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
 static long alarm_interval_id = -1;
 static long alarm_timeout_id = -1;
 static double alarm_interval;
+static int16_t freqcorr;
 ext_irq_cb_t alarm_callback;
 ext_irq_cb_t btn_alarm_callback;
 ext_irq_cb_t a2_callback;
@@ -204,5 +205,11 @@ void watch_rtc_enable(bool en)
 
 void watch_rtc_freqcorr_write(int16_t value, int16_t sign)
 {
-    //Not simulated
+    // Not simulated, only remembered
+    freqcorr = sign ? -value : value;
+}
+
+int16_t watch_rtc_freqcorr_read(void)
+{
+    return freqcorr;
 }
@@ -33,3 +33,7 @@ bool watch_spi_write(const uint8_t *buf, uint16_t length) { return false; }
 bool watch_spi_read(uint8_t *buf, uint16_t length) { return false; }
 
 bool watch_spi_transfer(const uint8_t *data_out, uint8_t *data_in, uint16_t length) { return false; }
+
+bool watch_spi_transfer_async(const uint8_t *data_out, uint8_t *data_in, uint16_t length, watch_dma_cb_t callback, void *context) { return false; }
+
+void watch_spi_wait(void) {}
@@ -30,3 +30,10 @@ bool watch_storage_sync(void) {
     // nothing to do here!
     return true;
 }
+
+const uint8_t *watch_storage_get_pointer(uint32_t row, uint32_t offset) {
+    uint32_t address = row * NVMCTRL_ROW_SIZE + offset;
+    if (address >= NVMCTRL_PAGE_SIZE * NVMCTRL_RWWEE_PAGES) return NULL;
+
+    return storage + address;
+}
@@ -45,3 +45,40 @@ char watch_uart_getc(void) {
     }
     return 0;
 }
+
+void watch_disable_uart(void) {
+    tx_enable = false;
+    rx_enable = false;
+}
+
+size_t watch_uart_write(const uint8_t *data, size_t length) {
+    (void) data;
+    // TODO: hook up to UI
+    return tx_enable ? length : 0;
+}
+
+size_t watch_uart_tx_free(void) {
+    // writes never back up here
+    return WATCH_UART_TX_BUF_SZ - 1;
+}
+
+size_t watch_uart_read(uint8_t *data, size_t length) {
+    (void) data;
+    (void) length;
+    return 0;
+}
+
+size_t watch_uart_rx_available(void) {
+    return 0;
+}
+
+void watch_uart_set_rx_callback(watch_uart_rx_cb_t callback) {
+    (void) callback;
+}
+
+uint32_t watch_uart_rx_dropped(void) {
+    return 0;
+}
+
+void watch_uart_flush(void) {
+}